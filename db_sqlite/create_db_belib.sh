@@ -2,3 +2,6 @@
 
 ## Script sh de creation de la base de donnees sqlite3
 sqlite3 belib_data.db < creation_db_belib.sql
+
+## Mise a jour du schema (index, colonnes epoch/hour) et passage en mode WAL
+./migrate_db_belib.sh belib_data.db
@@ -0,0 +1,41 @@
+#!/bin/sh
+
+# ===========================================================================
+# Script de migration du schema de la base de donnees sqlite3 belib.
+# La version du schema est stockee dans PRAGMA user_version. Chaque fichier
+# migrations/NNN_*.sql fait passer la bdd de la version NNN-1 a NNN ; seules
+# les migrations plus recentes que la bdd sont appliquees, chacune dans une
+# transaction (historique conserve, rejouable sans risque). La bdd est ensuite
+# passee en mode WAL.
+# Usage : ./migrate_db_belib.sh [chemin_bdd]
+# ===========================================================================
+
+PATH_DB=${1:-belib_data.db}
+DIR_MIGRATIONS=$(dirname "$0")/migrations
+
+if [ ! -f "${PATH_DB}" ]; then
+    echo "Erreur : bdd ${PATH_DB} introuvable."
+    exit 1
+fi
+
+version=$(sqlite3 "${PATH_DB}" "PRAGMA user_version;")
+
+for migration in "${DIR_MIGRATIONS}"/[0-9][0-9][0-9]_*.sql; do
+    [ -f "${migration}" ] || continue
+
+    num=$(basename "${migration}" | cut -c1-3 | sed 's/^0*//')
+    [ "${num}" -gt "${version}" ] || continue
+
+    echo "> Migration ${version} -> ${num} : $(basename "${migration}")"
+    { echo "BEGIN;"; cat "${migration}"; echo "COMMIT;"; } \
+        | sqlite3 -bail "${PATH_DB}" || { echo "Erreur : migration ${num} annulee."; exit 1; }
+
+    version=${num}
+done
+
+# Mode WAL (persistant dans le fichier) : la lecture des figures ne bloque pas
+# l'ecriture par les scripts de recuperation, et inversement
+sqlite3 "${PATH_DB}" "PRAGMA journal_mode=WAL;" > /dev/null \
+    || { echo "Erreur : passage en mode WAL impossible."; exit 1; }
+
+echo "> Bdd ${PATH_DB} a la version ${version}"
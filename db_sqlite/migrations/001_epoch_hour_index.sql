@@ -0,0 +1,70 @@
+-- Migration 1 : colonnes temporelles entieres et index couvrants
+-- epoch : secondes depuis le 01/01/70 de date_recolte (heure murale)
+-- hour  : heure de la journee de date_recolte (0-23)
+-- Evite l'appel a strftime sur chaque ligne lors des agregats horaires.
+
+-- Table General -------------------------------------------------------------
+ALTER TABLE "General" ADD COLUMN "epoch" INTEGER;
+ALTER TABLE "General" ADD COLUMN "hour" INTEGER;
+
+UPDATE "General" SET
+	"epoch" = CAST(strftime('%s', "date_recolte") AS INTEGER),
+	"hour" = CAST(strftime('%H', "date_recolte") AS INTEGER);
+
+CREATE TRIGGER "General_epoch_hour" AFTER INSERT ON "General"
+WHEN NEW."epoch" IS NULL
+BEGIN
+	UPDATE "General" SET
+		"epoch" = CAST(strftime('%s', NEW."date_recolte") AS INTEGER),
+		"hour" = CAST(strftime('%H', NEW."date_recolte") AS INTEGER)
+	WHERE "ID" = NEW."ID";
+END;
+
+CREATE INDEX "General_epoch" ON "General" ("epoch");
+
+-- Table Stations_fav --------------------------------------------------------
+ALTER TABLE "Stations_fav" ADD COLUMN "epoch" INTEGER;
+ALTER TABLE "Stations_fav" ADD COLUMN "hour" INTEGER;
+
+UPDATE "Stations_fav" SET
+	"epoch" = CAST(strftime('%s', "date_recolte") AS INTEGER),
+	"hour" = CAST(strftime('%H', "date_recolte") AS INTEGER);
+
+CREATE TRIGGER "Stations_fav_epoch_hour" AFTER INSERT ON "Stations_fav"
+WHEN NEW."epoch" IS NULL
+BEGIN
+	UPDATE "Stations_fav" SET
+		"epoch" = CAST(strftime('%s', NEW."date_recolte") AS INTEGER),
+		"hour" = CAST(strftime('%H', NEW."date_recolte") AS INTEGER)
+	WHERE "ID" = NEW."ID";
+END;
+
+-- Index couvrant les requetes des figures (aucun acces a la table)
+CREATE INDEX "Stations_fav_adresse_epoch" ON "Stations_fav" (
+	"adresse_station", "epoch", "hour", "date_recolte",
+	"disponible", "occupe", "en_maintenance", "inconnu");
+CREATE INDEX "Stations_fav_epoch" ON "Stations_fav" ("epoch");
+
+-- Table Stations_live -------------------------------------------------------
+ALTER TABLE "Stations_live" ADD COLUMN "epoch" INTEGER;
+ALTER TABLE "Stations_live" ADD COLUMN "hour" INTEGER;
+
+UPDATE "Stations_live" SET
+	"epoch" = CAST(strftime('%s', "date_recolte") AS INTEGER),
+	"hour" = CAST(strftime('%H', "date_recolte") AS INTEGER);
+
+CREATE TRIGGER "Stations_live_epoch_hour" AFTER INSERT ON "Stations_live"
+WHEN NEW."epoch" IS NULL
+BEGIN
+	UPDATE "Stations_live" SET
+		"epoch" = CAST(strftime('%s', NEW."date_recolte") AS INTEGER),
+		"hour" = CAST(strftime('%H', NEW."date_recolte") AS INTEGER)
+	WHERE "ID" = NEW."ID";
+END;
+
+CREATE INDEX "Stations_live_adresse_epoch" ON "Stations_live" (
+	"adresse_station", "epoch", "hour", "date_recolte",
+	"disponible", "occupe", "en_maintenance", "inconnu");
+CREATE INDEX "Stations_live_epoch" ON "Stations_live" ("epoch");
+
+PRAGMA user_version = 1;
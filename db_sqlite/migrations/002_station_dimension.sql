@@ -0,0 +1,154 @@
+-- Migration 2 : table de dimension Station
+-- Les tables de faits (Stations_fav, Stations_live, Bornes) ne stockent plus 
+-- l'adresse ni lon/lat de la station a chaque ligne, mais uniquement station_id.
+-- label : adresse sans " Paris" (labels des figures)
+-- arrondissement : numero d'arrondissement tire du code postal (75015 -> 15)
+
+CREATE TABLE "Station" (
+	"ID" INTEGER NOT NULL UNIQUE, 
+	"adresse_station" TEXT NOT NULL UNIQUE,
+	"label" TEXT,
+	"lon" REAL NOT NULL,
+	"lat" REAL NOT NULL,
+	"arrondissement" INTEGER,
+	PRIMARY KEY("ID" AUTOINCREMENT)
+);
+
+-- label et arrondissement calcules a l'insertion (scripts python inchanges)
+CREATE TRIGGER "Station_label" AFTER INSERT ON "Station"
+WHEN NEW."label" IS NULL
+BEGIN
+	UPDATE "Station" SET
+		"label" = CASE WHEN NEW."adresse_station" LIKE '% Paris'
+			THEN substr(NEW."adresse_station", 1, length(NEW."adresse_station") - 6)
+			ELSE NEW."adresse_station" END,
+		"arrondissement" = CASE WHEN NEW."adresse_station" LIKE '% 75___ Paris'
+			THEN CAST(substr(NEW."adresse_station", length(NEW."adresse_station") - 7, 2) AS INTEGER)
+			END
+	WHERE "ID" = NEW."ID";
+END;
+
+-- Stations deja recoltees, dans leur ordre d'apparition (les ID suivent 
+-- l'ordre d'arrivee des stations, utilise pour les couleurs des figures)
+INSERT INTO "Station" ("adresse_station", "lon", "lat")
+SELECT "adresse_station", "lon", "lat" FROM "Stations_fav"
+GROUP BY "adresse_station" ORDER BY MIN("ID");
+
+INSERT OR IGNORE INTO "Station" ("adresse_station", "lon", "lat")
+SELECT "adresse_station", "lon", "lat" FROM "Stations_live"
+GROUP BY "adresse_station" ORDER BY MIN("ID");
+
+INSERT OR IGNORE INTO "Station" ("adresse_station", "lon", "lat")
+SELECT "adresse_station", "lon", "lat" FROM "Bornes"
+GROUP BY "adresse_station" ORDER BY MIN("ID");
+
+-- Table Stations_fav --------------------------------------------------------
+CREATE TABLE "Stations_fav_v2" (
+	"ID" INTEGER NOT NULL UNIQUE, 
+	"date_recolte" TEXT NOT NULL, 
+	"station_id" INTEGER NOT NULL REFERENCES "Station" ("ID"),
+	"disponible" INTEGER NOT NULL, 
+	"occupe" INTEGER NOT NULL, 
+	"en_maintenance" INTEGER NOT NULL, 
+	"inconnu" INTEGER NOT NULL, 
+	"supprime" INTEGER NOT NULL, 
+	"reserve" INTEGER NOT NULL, 
+	"en_cours_mes" INTEGER NOT NULL, 
+	"mes_planifiee" INTEGER NOT NULL, 
+	"non_implemente" INTEGER NOT NULL, 
+	"epoch" INTEGER,
+	"hour" INTEGER,
+	PRIMARY KEY("ID" AUTOINCREMENT)
+);
+
+INSERT INTO "Stations_fav_v2" ("ID", "date_recolte", "station_id",
+	"disponible", "occupe", "en_maintenance", "inconnu", "supprime",
+	"reserve", "en_cours_mes", "mes_planifiee", "non_implemente",
+	"epoch", "hour")
+SELECT f."ID", f."date_recolte", s."ID",
+	f."disponible", f."occupe", f."en_maintenance", f."inconnu", f."supprime",
+	f."reserve", f."en_cours_mes", f."mes_planifiee", f."non_implemente",
+	f."epoch", f."hour"
+FROM "Stations_fav" f JOIN "Station" s ON s."adresse_station" = f."adresse_station";
+
+DROP TABLE "Stations_fav";
+ALTER TABLE "Stations_fav_v2" RENAME TO "Stations_fav";
+
+CREATE TRIGGER "Stations_fav_epoch_hour" AFTER INSERT ON "Stations_fav"
+WHEN NEW."epoch" IS NULL
+BEGIN
+	UPDATE "Stations_fav" SET
+		"epoch" = CAST(strftime('%s', NEW."date_recolte") AS INTEGER),
+		"hour" = CAST(strftime('%H', NEW."date_recolte") AS INTEGER)
+	WHERE "ID" = NEW."ID";
+END;
+
+CREATE INDEX "Stations_fav_station_epoch" ON "Stations_fav" (
+	"station_id", "epoch", "hour", "date_recolte",
+	"disponible", "occupe", "en_maintenance", "inconnu");
+CREATE INDEX "Stations_fav_epoch" ON "Stations_fav" ("epoch");
+
+-- Table Stations_live -------------------------------------------------------
+CREATE TABLE "Stations_live_v2" (
+	"ID" INTEGER NOT NULL UNIQUE, 
+	"date_recolte" TEXT NOT NULL, 
+	"station_id" INTEGER NOT NULL REFERENCES "Station" ("ID"),
+	"disponible" INTEGER NOT NULL, 
+	"occupe" INTEGER NOT NULL, 
+	"en_maintenance" INTEGER NOT NULL, 
+	"inconnu" INTEGER NOT NULL, 
+	"supprime" INTEGER NOT NULL, 
+	"reserve" INTEGER NOT NULL, 
+	"en_cours_mes" INTEGER NOT NULL, 
+	"mes_planifiee" INTEGER NOT NULL, 
+	"non_implemente" INTEGER NOT NULL, 
+	"epoch" INTEGER,
+	"hour" INTEGER,
+	PRIMARY KEY("ID" AUTOINCREMENT)
+);
+
+INSERT INTO "Stations_live_v2" ("ID", "date_recolte", "station_id",
+	"disponible", "occupe", "en_maintenance", "inconnu", "supprime",
+	"reserve", "en_cours_mes", "mes_planifiee", "non_implemente",
+	"epoch", "hour")
+SELECT f."ID", f."date_recolte", s."ID",
+	f."disponible", f."occupe", f."en_maintenance", f."inconnu", f."supprime",
+	f."reserve", f."en_cours_mes", f."mes_planifiee", f."non_implemente",
+	f."epoch", f."hour"
+FROM "Stations_live" f JOIN "Station" s ON s."adresse_station" = f."adresse_station";
+
+DROP TABLE "Stations_live";
+ALTER TABLE "Stations_live_v2" RENAME TO "Stations_live";
+
+CREATE TRIGGER "Stations_live_epoch_hour" AFTER INSERT ON "Stations_live"
+WHEN NEW."epoch" IS NULL
+BEGIN
+	UPDATE "Stations_live" SET
+		"epoch" = CAST(strftime('%s', NEW."date_recolte") AS INTEGER),
+		"hour" = CAST(strftime('%H', NEW."date_recolte") AS INTEGER)
+	WHERE "ID" = NEW."ID";
+END;
+
+CREATE INDEX "Stations_live_station_epoch" ON "Stations_live" (
+	"station_id", "epoch", "hour", "date_recolte",
+	"disponible", "occupe", "en_maintenance", "inconnu");
+CREATE INDEX "Stations_live_epoch" ON "Stations_live" ("epoch");
+
+-- Table Bornes -------------------------------------------------------------
+CREATE TABLE "Bornes_v2" (
+	"ID" INTEGER NOT NULL UNIQUE, 
+	"last_updated" TEXT NOT NULL, 
+	"id_pdc" TEXT NOT NULL, 
+	"statut_pdc" TEXT NOT NULL, 
+	"station_id" INTEGER NOT NULL REFERENCES "Station" ("ID"),
+	PRIMARY KEY("ID" AUTOINCREMENT)
+);
+
+INSERT INTO "Bornes_v2" ("ID", "last_updated", "id_pdc", "statut_pdc", "station_id")
+SELECT b."ID", b."last_updated", b."id_pdc", b."statut_pdc", s."ID"
+FROM "Bornes" b JOIN "Station" s ON s."adresse_station" = b."adresse_station";
+
+DROP TABLE "Bornes";
+ALTER TABLE "Bornes_v2" RENAME TO "Bornes";
+
+PRAGMA user_version = 2;
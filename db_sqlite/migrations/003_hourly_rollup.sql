@@ -0,0 +1,70 @@
+-- Migration 3 : agregat horaire de la disponibilite des stations favorites
+-- Stations_fav_hourly contient, pour chaque station et chaque heure de la 
+-- journee, la somme des bornes disponibles et le nombre de recoltes. La moyenne
+-- horaire (fig3) se lit alors sur au plus 24 lignes par station, quelle que 
+-- soit la taille de l'historique.
+-- Mise a jour par triggers a chaque insertion/suppression/correction dans
+-- Stations_fav.
+-- Recalcul complet depuis les donnees brutes : rebuild_hourly_belib.sh
+
+CREATE TABLE "Stations_fav_hourly" (
+	"station_id" INTEGER NOT NULL REFERENCES "Station" ("ID"),
+	"hour" INTEGER NOT NULL,
+	"somme_dispo" INTEGER NOT NULL,
+	"nb" INTEGER NOT NULL,
+	PRIMARY KEY("station_id", "hour")
+) WITHOUT ROWID;
+
+INSERT INTO "Stations_fav_hourly" ("station_id", "hour", "somme_dispo", "nb")
+SELECT "station_id", "hour", SUM("disponible"), COUNT(*) FROM "Stations_fav"
+GROUP BY "station_id", "hour";
+
+-- hour peut ne pas encore etre rempli (trigger Stations_fav_epoch_hour)
+CREATE TRIGGER "Stations_fav_hourly_insert" AFTER INSERT ON "Stations_fav"
+BEGIN
+	INSERT INTO "Stations_fav_hourly" ("station_id", "hour", "somme_dispo", "nb")
+	VALUES (NEW."station_id",
+		COALESCE(NEW."hour", CAST(strftime('%H', NEW."date_recolte") AS INTEGER)),
+		NEW."disponible", 1)
+	ON CONFLICT ("station_id", "hour") DO UPDATE SET
+		"somme_dispo" = "somme_dispo" + excluded."somme_dispo",
+		"nb" = "nb" + 1;
+END;
+
+CREATE TRIGGER "Stations_fav_hourly_delete" AFTER DELETE ON "Stations_fav"
+BEGIN
+	UPDATE "Stations_fav_hourly" SET
+		"somme_dispo" = "somme_dispo" - OLD."disponible",
+		"nb" = "nb" - 1
+	WHERE "station_id" = OLD."station_id" AND "hour" = OLD."hour";
+
+	DELETE FROM "Stations_fav_hourly" 
+	WHERE "station_id" = OLD."station_id" AND "hour" = OLD."hour" AND "nb" <= 0;
+END;
+
+-- Correction d'une ligne (disponible, station ou heure) : ancienne valeur 
+-- retiree, nouvelle ajoutee. Le remplissage de hour par Stations_fav_epoch_hour
+-- (hour NULL a l'insertion, deja compte par Stations_fav_hourly_insert) est 
+-- ignore.
+CREATE TRIGGER "Stations_fav_hourly_update"
+AFTER UPDATE OF "disponible", "station_id", "hour" ON "Stations_fav"
+WHEN OLD."hour" IS NOT NULL
+BEGIN
+	UPDATE "Stations_fav_hourly" SET
+		"somme_dispo" = "somme_dispo" - OLD."disponible",
+		"nb" = "nb" - 1
+	WHERE "station_id" = OLD."station_id" AND "hour" = OLD."hour";
+
+	DELETE FROM "Stations_fav_hourly" 
+	WHERE "station_id" = OLD."station_id" AND "hour" = OLD."hour" AND "nb" <= 0;
+
+	INSERT INTO "Stations_fav_hourly" ("station_id", "hour", "somme_dispo", "nb")
+	VALUES (NEW."station_id",
+		COALESCE(NEW."hour", CAST(strftime('%H', NEW."date_recolte") AS INTEGER)),
+		NEW."disponible", 1)
+	ON CONFLICT ("station_id", "hour") DO UPDATE SET
+		"somme_dispo" = "somme_dispo" + excluded."somme_dispo",
+		"nb" = "nb" + 1;
+END;
+
+PRAGMA user_version = 3;
@@ -0,0 +1,49 @@
+#!/bin/sh
+
+# ===========================================================================
+# Script de recalcul complet de l'agregat horaire Stations_fav_hourly depuis 
+# les donnees brutes de Stations_fav (apres correction manuelle de donnees, 
+# ou en cas de doute sur la coherence de l'agregat). Cree aussi le trigger 
+# Stations_fav_hourly_update s'il manque (bdd passees en version 3 avant son 
+# ajout a la migration 3 : les corrections n'etaient pas reportees).
+# Usage : ./rebuild_hourly_belib.sh [chemin_bdd]
+# ===========================================================================
+
+PATH_DB=${1:-belib_data.db}
+
+if [ ! -f "${PATH_DB}" ]; then
+    echo "Erreur : bdd ${PATH_DB} introuvable."
+    exit 1
+fi
+
+sqlite3 -bail "${PATH_DB}" <<SQL || { echo "Erreur : recalcul annule."; exit 1; }
+BEGIN;
+CREATE TRIGGER IF NOT EXISTS "Stations_fav_hourly_update"
+AFTER UPDATE OF "disponible", "station_id", "hour" ON "Stations_fav"
+WHEN OLD."hour" IS NOT NULL
+BEGIN
+	UPDATE "Stations_fav_hourly" SET
+		"somme_dispo" = "somme_dispo" - OLD."disponible",
+		"nb" = "nb" - 1
+	WHERE "station_id" = OLD."station_id" AND "hour" = OLD."hour";
+
+	DELETE FROM "Stations_fav_hourly" 
+	WHERE "station_id" = OLD."station_id" AND "hour" = OLD."hour" AND "nb" <= 0;
+
+	INSERT INTO "Stations_fav_hourly" ("station_id", "hour", "somme_dispo", "nb")
+	VALUES (NEW."station_id",
+		COALESCE(NEW."hour", CAST(strftime('%H', NEW."date_recolte") AS INTEGER)),
+		NEW."disponible", 1)
+	ON CONFLICT ("station_id", "hour") DO UPDATE SET
+		"somme_dispo" = "somme_dispo" + excluded."somme_dispo",
+		"nb" = "nb" + 1;
+END;
+
+DELETE FROM "Stations_fav_hourly";
+INSERT INTO "Stations_fav_hourly" ("station_id", "hour", "somme_dispo", "nb")
+SELECT "station_id", "hour", SUM("disponible"), COUNT(*) FROM "Stations_fav"
+GROUP BY "station_id", "hour";
+COMMIT;
+SQL
+
+echo "> Agregat horaire Stations_fav_hourly recalcule"
@@ -0,0 +1,195 @@
+/* ----------------------------------------------------------------------------
+*  Bibliotheque definissant une arène mémoire : allocations successives dans
+*  des blocs alloués d'avance, libérées toutes en une fois. Utilisée par les
+*  figures (plotter.h) pour les tableaux de séries, les coordonnées pixels et
+*  les buffers des programmes principaux propres à une figure.
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+#ifndef ARENE_H
+#define ARENE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * @brief Taille (octets) d'un bloc de l'arène. Une allocation plus grande
+ * obtient un bloc à elle seule.
+ *
+ */
+#define ARENE_TAILLE_BLOC (64 * 1024)
+
+/**
+ * @brief Alignement (octets) de chaque allocation dans l'arène
+ *
+ */
+#define ARENE_ALIGNEMENT 16
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Bloc mémoire d'une arène. Les blocs sont chainés, le plus récent en
+ * tête : seul celui-ci reçoit les nouvelles allocations.
+ *
+ */
+typedef struct BlocArene_s {
+    struct BlocArene_s *precedent; /**< Bloc alloué avant celui-ci (NULL : premier) */
+    size_t taille;        /**< Taille utile du bloc (octets) */
+    size_t utilise;       /**< Nombre d'octets déjà distribués */
+    _Alignas(ARENE_ALIGNEMENT) unsigned char mem[]; /**< Mémoire du bloc */
+} BlocArene;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Arène mémoire : pas de libération individuelle, tout est rendu au
+ * système par Free_arene. Le pic mémoire est la somme des blocs alloués.
+ *
+ */
+typedef struct Arene_s {
+    BlocArene *bloc;      /**< Bloc courant (NULL : arène vide) */
+    size_t taille_totale; /**< Somme des tailles des blocs (octets) */
+} Arene;
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Initialise une arène avec un premier bloc de taille_initiale octets
+ * (ARENE_TAILLE_BLOC si 0)
+ *
+ * @param arene Pointeur vers un objet de type Arene
+ * @param taille_initiale Taille du premier bloc (octets)
+ */
+void Init_arene(Arene *arene, size_t taille_initiale);
+
+/**
+ * @brief Renvoie taille octets alignés sur ARENE_ALIGNEMENT, pris dans le
+ * bloc courant ou dans un nouveau bloc s'il est plein. Sort en erreur si la
+ * mémoire manque.
+ *
+ * @param arene Pointeur vers un objet de type Arene
+ * @param taille Nombre d'octets demandés
+ * @return void* Pointeur vers la zone allouée (valide jusqu'à Free_arene)
+ */
+void *Alloc_arene(Arene *arene, size_t taille);
+
+/**
+ * @brief Agrandit un tableau alloué dans l'arène : une nouvelle zone est prise
+ * et l'ancien contenu y est recopié (l'ancienne zone reste perdue jusqu'à
+ * Free_arene, d'où une croissance par doublement côté appelant).
+ *
+ * @param arene Pointeur vers un objet de type Arene
+ * @param ptr Tableau actuel (NULL possible)
+ * @param taille_old Taille actuelle du tableau (octets)
+ * @param taille_new Nouvelle taille (octets)
+ * @return void* Pointeur vers le nouveau tableau
+ */
+void *Realloc_arene(Arene *arene, void *ptr, size_t taille_old, size_t taille_new);
+
+/**
+ * @brief Libère tous les blocs de l'arène. L'arène peut être réinitialisée
+ * ensuite avec Init_arene.
+ *
+ * @param arene Pointeur vers un objet de type Arene
+ */
+void Free_arene(Arene *arene);
+
+/**
+ * @brief Fonction interne : alloue un bloc de taille octets et le place en
+ * tête de l'arène. Sort en erreur si la mémoire manque.
+ *
+ * @param arene Pointeur vers un objet de type Arene
+ * @param taille Taille utile du bloc (octets)
+ * @return BlocArene* Bloc alloué
+ */
+BlocArene *Nouveau_bloc_arene(Arene *arene, size_t taille);
+
+
+/* --------------------------------------------------------------------------- */
+// Définition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+BlocArene *Nouveau_bloc_arene(Arene *arene, size_t taille)
+{
+    BlocArene *bloc = malloc(sizeof(BlocArene) + taille);
+
+    if (bloc == NULL) {
+        printf("Erreur : Pas assez de memoire (arene, %zu octets).\n", taille);
+        exit(EXIT_FAILURE);
+    }
+
+    bloc->precedent = arene->bloc;
+    bloc->taille = taille;
+    bloc->utilise = 0;
+
+    arene->bloc = bloc;
+    arene->taille_totale += taille;
+
+    return bloc;
+}
+
+/* --------------------------------------------------------------------------- */
+void Init_arene(Arene *arene, size_t taille_initiale)
+{
+    arene->bloc = NULL;
+    arene->taille_totale = 0;
+    Nouveau_bloc_arene(arene, taille_initiale ? taille_initiale : ARENE_TAILLE_BLOC);
+}
+
+/* --------------------------------------------------------------------------- */
+void *Alloc_arene(Arene *arene, size_t taille)
+{
+    // Arrondi au multiple de l'alignement : les blocs commencent alignés
+    taille = (taille + ARENE_ALIGNEMENT-1) & ~(size_t)(ARENE_ALIGNEMENT-1);
+
+    BlocArene *bloc = arene->bloc;
+    if (bloc == NULL || bloc->taille - bloc->utilise < taille) {
+        if (taille > ARENE_TAILLE_BLOC / 4) {
+            // Grosse allocation : bloc dédié, glissé sous le bloc courant
+            // pour ne pas abandonner la place qui y reste
+            bloc = Nouveau_bloc_arene(arene, taille);
+            if (bloc->precedent != NULL) {
+                arene->bloc = bloc->precedent;
+                bloc->precedent = arene->bloc->precedent;
+                arene->bloc->precedent = bloc;
+            }
+        } else {
+            bloc = Nouveau_bloc_arene(arene, ARENE_TAILLE_BLOC);
+        }
+    }
+
+    void *ptr = bloc->mem + bloc->utilise;
+    bloc->utilise += taille;
+
+    return ptr;
+}
+
+/* --------------------------------------------------------------------------- */
+void *Realloc_arene(Arene *arene, void *ptr, size_t taille_old, size_t taille_new)
+{
+    void *nouveau = Alloc_arene(arene, taille_new);
+
+    if (ptr != NULL && taille_old > 0)
+        memcpy(nouveau, ptr, taille_old < taille_new ? taille_old : taille_new);
+
+    return nouveau;
+}
+
+/* --------------------------------------------------------------------------- */
+void Free_arene(Arene *arene)
+{
+    BlocArene *bloc = arene->bloc;
+
+    while (bloc != NULL) {
+        BlocArene *precedent = bloc->precedent;
+        free(bloc);
+        bloc = precedent;
+    }
+
+    arene->bloc = NULL;
+    arene->taille_totale = 0;
+}
+
+#endif
@@ -28,7 +28,8 @@ int violet_fonce[3] = {152,  78, 163};
  * @brief Liste des couleurs utilisees pour les lines plots
  * 
  */
-int color_lines[10][3] = {\
+#define NB_COULEURS_LIGNES 10
+int color_lines[NB_COULEURS_LIGNES][3] = {\
                     { 51, 160,  44},
                     {255, 127,   0},
                     { 31, 120, 180},
@@ -44,7 +45,8 @@ int color_lines[10][3] = {\
  * @brief Liste des couleurs utilisees pour les bar plots. Couleur par catégorie.
  * 
  */
-int color_ctg[6][3] = {\
+#define NB_COULEURS_CTG 6
+int color_ctg[NB_COULEURS_CTG][3] = {\
             {102,194,165},\
             {252,141, 98},\
             {231,138,195},\
@@ -0,0 +1,713 @@
+/* ----------------------------------------------------------------------------
+*  Bibliotheque gerant le cache de la couche statique d'une figure : fond,
+*  canvas, ylabel, titre, legende et annotations ne changent pas d'une
+*  execution à l'autre. Ils sont dessinés une fois puis sauvegardés en pixels
+*  truecolor compressés par zlib dans un fichier, avec une clé calculée sur
+*  tout ce qui les détermine. Aux executions suivantes, la couche est relue et seules les
+*  données (ticks, grilles, courbes, barres, sous-titre) sont dessinées dessus.
+*  Un process résident (serveur live) garde en plus les dernieres couches
+*  en mémoire (CacheCouches) : copiées dans l'image sans relire le fichier.
+*  Gère aussi l'empreinte des entrées de chaque figure, sauvegardée à côté du
+*  png (fichier .etag) : si elle n'a pas changé, la figure n'est ni dessinée
+*  ni réécrite, et httpd peut la servir comme ETag fort.
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+#ifndef COUCHE_H
+#define COUCHE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <gd.h>
+#include "plotter.h"
+
+/**
+ * @brief Signature en tete du fichier de couche (change si le format change)
+ *
+ */
+#define COUCHE_MAGIC "BELIBCS2"
+
+/**
+ * @brief Taille du tampon de lecture/écriture du flux zlib de la couche
+ *
+ */
+#define COUCHE_TAILLE_TAMPON 16384
+
+/**
+ * @brief Nombre d'entiers annexes sauvegardés avec la couche (ex : bbox du
+ * titre, nécessaire au placement du sous-titre)
+ *
+ */
+#define COUCHE_NB_META 8
+
+/**
+ * @brief Extension du fichier contenant l'empreinte d'une figure, à côté du
+ * png (ex : fig1_disponible.png.etag). Contenu : l'ETag entre guillemets.
+ *
+ */
+#define FIGURE_ETAG_EXT ".etag"
+
+/**
+ * @brief Nombre de couches gardées en mémoire par un CacheCouches (la clé
+ * dépend du nombre de séries : une couche par taille de figure rencontrée)
+ *
+ */
+#define COUCHE_NB_MEMOIRE 4
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief En tete du fichier de couche, suivi du flux zlib (niveau 1) des sy
+ * lignes de sx pixels truecolor de l'image. Le fond uni domine : 2,2 Mo de
+ * pixels pour une figure 800x700 tiennent en quelques dizaines de ko.
+ *
+ */
+typedef struct EnteteCouche_s {
+    char magic[8];                  /**< COUCHE_MAGIC */
+    uint64_t cle;                   /**< Clé de la couche (Cle_couche_statique) */
+    int32_t sx;                     /**< Largeur de l'image */
+    int32_t sy;                     /**< Hauteur de l'image */
+    int32_t meta[COUCHE_NB_META];   /**< Entiers annexes */
+} EnteteCouche;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Couche statique gardée en mémoire : pixels truecolor de l'image
+ * (sy lignes de sx pixels) et entiers annexes
+ *
+ */
+typedef struct CoucheMemoire_s {
+    uint64_t cle;                   /**< Clé de la couche (Cle_couche_statique) */
+    int sx;                         /**< Largeur de l'image */
+    int sy;                         /**< Hauteur de l'image */
+    int meta[COUCHE_NB_META];       /**< Entiers annexes */
+    int *pixels;                    /**< Pixels (NULL : case libre) */
+} CoucheMemoire;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Dernieres couches statiques en mémoire, partagées entre threads :
+ * copies en lecture simultanées, remplacement de la plus ancienne en écriture
+ *
+ */
+typedef struct CacheCouches_s {
+    CoucheMemoire couches[COUCHE_NB_MEMOIRE];   /**< Couches en mémoire */
+    int prochaine;                              /**< Case du prochain ajout */
+    pthread_rwlock_t verrou;                    /**< Protège les couches */
+} CacheCouches;
+
+
+/* --------------------------------------------------------------------------- */
+// Declaration fonctions
+/* --------------------------------------------------------------------------- */
+
+/**
+ * @brief Calcule la clé de la couche statique d'une figure : hash FNV-1a de la
+ * date de compilation (positions et décalages sont dans le code), des
+ * dimensions, pads et marges, de la table des couleurs, des polices (chemin,
+ * taille, taille et date du fichier), des labels et styles des séries
+ * (légende) et des textes passés par l'appelant. A appeler une fois les
+ * séries ajoutées et les polices de la couche réglées.
+ *
+ * @param fig Pointeur vers un objet de type Figure
+ * @param nb_textes Nombre de textes de la couche
+ * @param textes Textes dessinés dans la couche (titre, ylabel, annotations...)
+ * @return uint64_t Clé de la couche
+ */
+uint64_t Cle_couche_statique(Figure *fig, size_t nb_textes, char *textes[nb_textes]);
+
+/**
+ * @brief Charge la couche statique dans l'image de la figure si le fichier
+ * existe et correspond à la clé et aux dimensions de l'image. Backend gd 
+ * seulement (une figure svg est toujours entièrement tracée).
+ *
+ * @param fig Pointeur vers un objet de type Figure
+ * @param fichier_couche Chemin du fichier de couche
+ * @param cle Clé attendue
+ * @param meta Entiers annexes lus (COUCHE_NB_META), non modifiés si échec
+ * @return int 1 si la couche a été chargée, 0 sinon (l'image est alors
+ * inchangée ou à redessiner entièrement)
+ */
+int Charger_couche_statique(Figure *fig, const char *fichier_couche, uint64_t cle,\
+                            int meta[COUCHE_NB_META]);
+
+/**
+ * @brief Sauvegarde l'image de la figure comme couche statique (fichier
+ * temporaire puis renommage). Un échec n'est pas bloquant : la couche sera
+ * redessinée à la prochaine execution.
+ *
+ * @param fig Pointeur vers un objet de type Figure
+ * @param fichier_couche Chemin du fichier de couche
+ * @param cle Clé de la couche
+ * @param meta Entiers annexes à sauvegarder (COUCHE_NB_META)
+ * @return int 0 si ok, -1 sinon
+ */
+int Sauver_couche_statique(Figure *fig, const char *fichier_couche, uint64_t cle,\
+                            const int meta[COUCHE_NB_META]);
+
+/**
+ * @brief Initialise un cache de couches en mémoire vide
+ *
+ * @param cache Pointeur vers un objet de type CacheCouches
+ */
+void Init_cache_couches(CacheCouches *cache);
+
+/**
+ * @brief Libère les couches d'un cache
+ *
+ * @param cache Pointeur vers un objet de type CacheCouches
+ */
+void Free_cache_couches(CacheCouches *cache);
+
+/**
+ * @brief Copie dans l'image de la figure la couche du cache de même clé et
+ * de mêmes dimensions, s'il y en a une. Backend gd seulement.
+ *
+ * @param fig Pointeur vers un objet de type Figure
+ * @param cache Pointeur vers un objet de type CacheCouches
+ * @param cle Clé attendue
+ * @param meta Entiers annexes lus (COUCHE_NB_META), non modifiés si échec
+ * @return int 1 si la couche a été copiée, 0 sinon (image inchangée)
+ */
+int Charger_couche_memoire(Figure *fig, CacheCouches *cache, uint64_t cle,\
+                            int meta[COUCHE_NB_META]);
+
+/**
+ * @brief Garde l'image de la figure comme couche en mémoire (à la place de
+ * la plus ancienne couche du cache). Sans effet si la clé y est déjà.
+ *
+ * @param fig Pointeur vers un objet de type Figure
+ * @param cache Pointeur vers un objet de type CacheCouches
+ * @param cle Clé de la couche
+ * @param meta Entiers annexes à garder (COUCHE_NB_META)
+ */
+void Garder_couche_memoire(Figure *fig, CacheCouches *cache, uint64_t cle,\
+                            const int meta[COUCHE_NB_META]);
+
+/**
+ * @brief Calcule l'empreinte des entrées d'une figure : clé de sa couche
+ * statique (code, géométrie, couleurs, polices, légende), sous-échantillonnage,
+ * backend et format du png, données de toutes les séries (X, Y, effectifs des
+ * barplots et leurs labels) et textes dynamiques passés par l'appelant 
+ * (sous-titre, dates des ticks...).
+ * A appeler une fois les séries ajoutées, avant tout dessin.
+ *
+ * @param fig Pointeur vers un objet de type Figure
+ * @param cle_couche Clé de la couche statique (Cle_couche_statique)
+ * @param nb_textes Nombre de textes dynamiques
+ * @param textes Textes dynamiques de la figure
+ * @return uint64_t Empreinte de la figure
+ */
+uint64_t Hash_figure(Figure *fig, uint64_t cle_couche, size_t nb_textes,\
+                        char *textes[nb_textes]);
+
+/**
+ * @brief Teste si le png d'une figure existe et a été produit à partir des
+ * mêmes entrées (empreinte identique à celle de son fichier .etag)
+ *
+ * @param dir_figures Dossier des figures
+ * @param filename_fig Nom du fichier png
+ * @param hash Empreinte de la figure (Hash_figure)
+ * @return int 1 si le png est à jour (rien à dessiner), 0 sinon
+ */
+int Png_a_jour(const char *dir_figures, const char *filename_fig, uint64_t hash);
+
+/**
+ * @brief Ecrit l'empreinte d'une figure dans le fichier .etag de son png
+ * (fichier temporaire puis renommage). A appeler après Save_figure.
+ *
+ * @param dir_figures Dossier des figures
+ * @param filename_fig Nom du fichier png
+ * @param hash Empreinte de la figure (Hash_figure)
+ * @return int 0 si ok, -1 sinon
+ */
+int Sauver_etag_figure(const char *dir_figures, const char *filename_fig, uint64_t hash);
+
+/**
+ * @brief Fonction interne : ajoute n octets au hash FNV-1a h
+ *
+ * @param h Hash en cours
+ * @param data Octets à ajouter
+ * @param n Nombre d'octets
+ * @return uint64_t Nouveau hash
+ */
+uint64_t Hash_couche(uint64_t h, const void *data, size_t n);
+
+/**
+ * @brief Fonction interne : ajoute une chaine (et sa fin) au hash h. NULL est
+ * accepté (chaine vide).
+ *
+ * @param h Hash en cours
+ * @param str Chaine à ajouter
+ * @return uint64_t Nouveau hash
+ */
+uint64_t Hash_couche_str(uint64_t h, const char *str);
+
+/**
+ * @brief Fonction interne : ajoute le style d'une série (légende) au hash h
+ *
+ * @param h Hash en cours
+ * @param label Label de la série
+ * @param linestyle LineStyle de la série
+ * @return uint64_t Nouveau hash
+ */
+uint64_t Hash_couche_serie(uint64_t h, const char *label, const LineStyle *linestyle);
+
+/**
+ * @brief Fonction interne : ouvre en écriture un fichier temporaire unique 
+ * à coté de fichier (fichier.XXXXXX, voir mkstemp), à renommer une fois
+ * écrit. Plusieurs threads ou process peuvent ainsi écrire le même fichier.
+ *
+ * @param fichier Chemin du fichier final
+ * @param fichier_tmp Chemin du fichier temporaire (sortie, strlen(fichier)+8)
+ * @return FILE* Flux ouvert, NULL si échec
+ */
+FILE *Ouvrir_tmp_couche(const char *fichier, char *fichier_tmp);
+
+
+/* --------------------------------------------------------------------------- */
+// Définition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+uint64_t Hash_couche(uint64_t h, const void *data, size_t n)
+{
+    const unsigned char *octets = data;
+
+    for (size_t i = 0; i < n; i++) {
+        h ^= octets[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+/* --------------------------------------------------------------------------- */
+uint64_t Hash_couche_str(uint64_t h, const char *str)
+{
+    if (str == NULL) str = "";
+    return Hash_couche(h, str, strlen(str) + 1);
+}
+
+/* --------------------------------------------------------------------------- */
+uint64_t Hash_couche_serie(uint64_t h, const char *label, const LineStyle *linestyle)
+{
+    h = Hash_couche_str(h, label);
+    h = Hash_couche(h, &linestyle->style, sizeof(linestyle->style));
+    h = Hash_couche(h, &linestyle->w, sizeof(linestyle->w));
+    h = Hash_couche(h, &linestyle->couleur, sizeof(linestyle->couleur));
+
+    return h;
+}
+
+/* --------------------------------------------------------------------------- */
+FILE *Ouvrir_tmp_couche(const char *fichier, char *fichier_tmp)
+{
+    sprintf(fichier_tmp, "%s.XXXXXX", fichier);
+
+    int fd = mkstemp(fichier_tmp);
+    if (fd < 0) return NULL;
+
+    // mkstemp crée le fichier en 0600 : mêmes droits qu'un fopen
+    fchmod(fd, 0644);
+
+    FILE *f = fdopen(fd, "wb");
+    if (f == NULL) {
+        close(fd);
+        remove(fichier_tmp);
+    }
+
+    return f;
+}
+
+/* --------------------------------------------------------------------------- */
+uint64_t Cle_couche_statique(Figure *fig, size_t nb_textes, char *textes[nb_textes])
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    // Code : toute recompilation invalide les couches
+    h = Hash_couche_str(h, COUCHE_MAGIC);
+    h = Hash_couche_str(h, __DATE__ " " __TIME__);
+
+    // Géométrie et couleurs
+    h = Hash_couche(h, &fig->img->sx, sizeof(fig->img->sx));
+    h = Hash_couche(h, &fig->img->sy, sizeof(fig->img->sy));
+    h = Hash_couche(h, fig->padX, sizeof(fig->padX));
+    h = Hash_couche(h, fig->padY, sizeof(fig->padY));
+    h = Hash_couche(h, fig->orig, sizeof(fig->orig));
+    h = Hash_couche(h, fig->margin, sizeof(fig->margin));
+    h = Hash_couche(h, fig->couleurs, sizeof(fig->couleurs));
+
+    // Polices : le fichier peut changer sous le même chemin (mise à jour)
+    for (int f = 0; f < nb_fonts; f++) {
+        struct stat st_police;
+        int64_t id_police[2] = {-1, -1};
+        if (fig->fonts[f].path != NULL && stat(fig->fonts[f].path, &st_police) == 0) {
+            id_police[0] = st_police.st_size;
+            id_police[1] = st_police.st_mtime;
+        }
+
+        h = Hash_couche_str(h, fig->fonts[f].path);
+        h = Hash_couche(h, &fig->fonts[f].size, sizeof(fig->fonts[f].size));
+        h = Hash_couche(h, id_police, sizeof(id_police));
+    }
+
+    // Séries : labels et styles de la légende
+    h = Hash_couche(h, &fig->nb_linedata, sizeof(fig->nb_linedata));
+    for (size_t i = 0; i < fig->nb_linedata; i++)
+        h = Hash_couche_serie(h, fig->linedata[i]->label, fig->linedata[i]->linestyle);
+
+    h = Hash_couche(h, &fig->nb_flinedata, sizeof(fig->nb_flinedata));
+    for (size_t i = 0; i < fig->nb_flinedata; i++)
+        h = Hash_couche_serie(h, fig->flinedata[i]->label, fig->flinedata[i]->linestyle);
+
+    h = Hash_couche(h, &fig->nb_bardata, sizeof(fig->nb_bardata));
+    if (fig->nb_bardata != 0) {
+        BarData *bardata = fig->bardata[0];
+        h = Hash_couche(h, &bardata->nb_ctg, sizeof(bardata->nb_ctg));
+        for (size_t c = 0; c < bardata->nb_ctg; c++) {
+            h = Hash_couche_str(h, bardata->ctg_names[c]);
+            h = Hash_couche(h, &bardata->couleurs[c], sizeof(bardata->couleurs[c]));
+        }
+    }
+
+    // Textes de l'appelant
+    h = Hash_couche(h, &nb_textes, sizeof(nb_textes));
+    for (size_t i = 0; i < nb_textes; i++)
+        h = Hash_couche_str(h, textes[i]);
+
+    return h;
+}
+
+/* --------------------------------------------------------------------------- */
+uint64_t Hash_figure(Figure *fig, uint64_t cle_couche, size_t nb_textes,\
+                        char *textes[nb_textes])
+{
+    uint64_t h = Hash_couche(0xcbf29ce484222325ULL, &cle_couche, sizeof(cle_couche));
+    h = Hash_couche(h, &fig->pts_par_pixel, sizeof(fig->pts_par_pixel));
+
+    // Backend et format du png
+    h = Hash_couche_str(h, fig->backend->nom);
+    h = Hash_couche(h, &fig->palette_png, sizeof(fig->palette_png));
+    h = Hash_couche(h, &fig->niveau_png, sizeof(fig->niveau_png));
+    h = Hash_couche(h, &fig->strategie_png, sizeof(fig->strategie_png));
+    h = Hash_couche(h, &fig->nb_blocs_png, sizeof(fig->nb_blocs_png));
+
+    // Données des séries
+    for (size_t i = 0; i < fig->nb_linedata; i++) {
+        LineData *linedata = fig->linedata[i];
+        h = Hash_couche(h, &linedata->len_data, sizeof(linedata->len_data));
+        h = Hash_couche(h, linedata->x, linedata->len_data*sizeof(*linedata->x));
+        h = Hash_couche(h, linedata->y, linedata->len_data*sizeof(*linedata->y));
+    }
+
+    for (size_t i = 0; i < fig->nb_flinedata; i++) {
+        fLineData *flinedata = fig->flinedata[i];
+        h = Hash_couche(h, &flinedata->len_data, sizeof(flinedata->len_data));
+        h = Hash_couche(h, flinedata->x, flinedata->len_data*sizeof(*flinedata->x));
+        h = Hash_couche(h, flinedata->y, flinedata->len_data*sizeof(*flinedata->y));
+    }
+
+    for (size_t i = 0; i < fig->nb_bardata; i++) {
+        BarData *bardata = fig->bardata[i];
+        h = Hash_couche_str(h, bardata->label);
+        h = Hash_couche(h, &bardata->nb_tot, sizeof(bardata->nb_tot));
+        h = Hash_couche(h, &bardata->nb_ctg, sizeof(bardata->nb_ctg));
+        h = Hash_couche(h, bardata->nb_in_ctg, bardata->nb_ctg*sizeof(*bardata->nb_in_ctg));
+    }
+
+    // Textes dynamiques de l'appelant
+    h = Hash_couche(h, &nb_textes, sizeof(nb_textes));
+    for (size_t i = 0; i < nb_textes; i++)
+        h = Hash_couche_str(h, textes[i]);
+
+    return h;
+}
+
+/* --------------------------------------------------------------------------- */
+int Png_a_jour(const char *dir_figures, const char *filename_fig, uint64_t hash)
+{
+    char path_outputFig[400] = {""};
+    strcat(path_outputFig, dir_figures);
+    strcat(path_outputFig, filename_fig);
+
+    struct stat st_png;
+    if (stat(path_outputFig, &st_png) != 0 || st_png.st_size == 0)
+        return 0;
+
+    strcat(path_outputFig, FIGURE_ETAG_EXT);
+    FILE *f = fopen(path_outputFig, "r");
+    if (f == NULL) return 0;
+
+    char etag[24] = {""};
+    char etag_attendu[24];
+    sprintf(etag_attendu, "\"%016llx\"", (unsigned long long)hash);
+
+    int ok = fgets(etag, sizeof(etag), f) != NULL \
+        && strncmp(etag, etag_attendu, strlen(etag_attendu)) == 0;
+
+    fclose(f);
+
+    return ok;
+}
+
+/* --------------------------------------------------------------------------- */
+int Sauver_etag_figure(const char *dir_figures, const char *filename_fig, uint64_t hash)
+{
+    char path_etag[400] = {""};
+    strcat(path_etag, dir_figures);
+    strcat(path_etag, filename_fig);
+    strcat(path_etag, FIGURE_ETAG_EXT);
+
+    char fichier_tmp[strlen(path_etag)+8];
+    FILE *f = Ouvrir_tmp_couche(path_etag, fichier_tmp);
+    if (f == NULL) {
+        printf("Info : impossible d'ecrire l'empreinte %s.\n", path_etag);
+        return -1;
+    }
+
+    int ok = fprintf(f, "\"%016llx\"\n", (unsigned long long)hash) > 0;
+
+    if (fclose(f) != 0) ok = 0;
+
+    if (!ok || rename(fichier_tmp, path_etag) != 0) {
+        printf("Info : echec de l'ecriture de l'empreinte %s.\n", path_etag);
+        remove(fichier_tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------- */
+int Charger_couche_statique(Figure *fig, const char *fichier_couche, uint64_t cle,\
+                            int meta[COUCHE_NB_META])
+{
+    // Couche en pixels : seulement pour le backend gd (le svg redessine tout)
+    if (fig->backend != &backend_gd || !gdImageTrueColor(fig->img)) return 0;
+
+    FILE *f = fopen(fichier_couche, "rb");
+    if (f == NULL) return 0;
+
+    EnteteCouche entete;
+    int ok = fread(&entete, sizeof(entete), 1, f) == 1 \
+        && memcmp(entete.magic, COUCHE_MAGIC, sizeof(entete.magic)) == 0 \
+        && entete.cle == cle \
+        && entete.sx == fig->img->sx \
+        && entete.sy == fig->img->sy;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    ok = ok && inflateInit(&zs) == Z_OK;
+    if (!ok) {
+        fclose(f);
+        return 0;
+    }
+
+    // Pixels décompressés directement dans les lignes de l'image
+    unsigned char tampon[COUCHE_TAILLE_TAMPON];
+    int res = Z_OK;
+
+    for (int y = 0; ok && y < fig->img->sy; y++) {
+        zs.next_out = (unsigned char *)fig->img->tpixels[y];
+        zs.avail_out = fig->img->sx * sizeof(int);
+
+        while (ok && zs.avail_out > 0) {
+            if (zs.avail_in == 0) {
+                zs.next_in = tampon;
+                zs.avail_in = fread(tampon, 1, sizeof(tampon), f);
+            }
+            res = inflate(&zs, Z_NO_FLUSH);
+            ok = (res == Z_OK || (res == Z_STREAM_END && zs.avail_out == 0));
+        }
+    }
+
+    // Fin du flux atteinte (adler32 vérifié) : un octet de sortie de trop ou
+    // une fin manquante signale un fichier tronqué ou corrompu
+    while (ok && res != Z_STREAM_END) {
+        unsigned char reste;
+        zs.next_out = &reste;
+        zs.avail_out = 1;
+        if (zs.avail_in == 0) {
+            zs.next_in = tampon;
+            zs.avail_in = fread(tampon, 1, sizeof(tampon), f);
+        }
+        res = inflate(&zs, Z_NO_FLUSH);
+        ok = (res == Z_OK || res == Z_STREAM_END) && zs.avail_out == 1 \
+                && (res == Z_STREAM_END || zs.avail_in > 0 || !feof(f));
+    }
+
+    inflateEnd(&zs);
+    fclose(f);
+
+    if (!ok) {
+        // Lecture partielle : on repart du fond
+        Make_background(fig, fig->color_bg, fig->color_cvs_bg);
+        return 0;
+    }
+
+    for (int i = 0; i < COUCHE_NB_META; i++)
+        meta[i] = entete.meta[i];
+
+    return 1;
+}
+
+/* --------------------------------------------------------------------------- */
+int Sauver_couche_statique(Figure *fig, const char *fichier_couche, uint64_t cle,\
+                            const int meta[COUCHE_NB_META])
+{
+    if (fig->backend != &backend_gd || !gdImageTrueColor(fig->img)) return -1;
+
+    char fichier_tmp[strlen(fichier_couche)+8];
+    FILE *f = Ouvrir_tmp_couche(fichier_couche, fichier_tmp);
+    if (f == NULL) {
+        printf("Info : impossible d'ecrire la couche statique %s.\n", fichier_couche);
+        return -1;
+    }
+
+    EnteteCouche entete;
+    memset(&entete, 0, sizeof(entete));
+    memcpy(entete.magic, COUCHE_MAGIC, sizeof(entete.magic));
+    entete.cle = cle;
+    entete.sx = fig->img->sx;
+    entete.sy = fig->img->sy;
+    for (int i = 0; i < COUCHE_NB_META; i++)
+        entete.meta[i] = meta[i];
+
+    int ok = fwrite(&entete, sizeof(entete), 1, f) == 1;
+
+    // Niveau 1 : les longues plages de fond uni se compressent aussi bien
+    // qu'aux niveaux élevés, pour bien moins de temps
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    ok = ok && deflateInit(&zs, Z_BEST_SPEED) == Z_OK;
+
+    unsigned char tampon[COUCHE_TAILLE_TAMPON];
+    int res = Z_OK;
+
+    for (int y = 0; ok && y < fig->img->sy; y++) {
+        int flush = (y == fig->img->sy - 1) ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = (unsigned char *)fig->img->tpixels[y];
+        zs.avail_in = fig->img->sx * sizeof(int);
+
+        // Sortie vidée tant que deflate remplit tout le tampon (et jusqu'à la
+        // fin du flux pour la derniere ligne)
+        do {
+            zs.next_out = tampon;
+            zs.avail_out = sizeof(tampon);
+            res = deflate(&zs, flush);
+            size_t n = sizeof(tampon) - zs.avail_out;
+            ok = res != Z_STREAM_ERROR && fwrite(tampon, 1, n, f) == n;
+        } while (ok && (zs.avail_out == 0 || (flush == Z_FINISH && res != Z_STREAM_END)));
+    }
+
+    deflateEnd(&zs);
+
+    if (fclose(f) != 0) ok = 0;
+
+    if (!ok || rename(fichier_tmp, fichier_couche) != 0) {
+        printf("Info : echec de l'ecriture de la couche statique %s.\n", fichier_couche);
+        remove(fichier_tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------- */
+void Init_cache_couches(CacheCouches *cache)
+{
+    memset(cache->couches, 0, sizeof(cache->couches));
+    cache->prochaine = 0;
+    pthread_rwlock_init(&cache->verrou, NULL);
+}
+
+/* --------------------------------------------------------------------------- */
+void Free_cache_couches(CacheCouches *cache)
+{
+    for (int c = 0; c < COUCHE_NB_MEMOIRE; c++) {
+        free(cache->couches[c].pixels);
+        cache->couches[c].pixels = NULL;
+    }
+    pthread_rwlock_destroy(&cache->verrou);
+}
+
+/* --------------------------------------------------------------------------- */
+int Charger_couche_memoire(Figure *fig, CacheCouches *cache, uint64_t cle,\
+                            int meta[COUCHE_NB_META])
+{
+    if (fig->backend != &backend_gd || !gdImageTrueColor(fig->img)) return 0;
+
+    int ok = 0;
+    pthread_rwlock_rdlock(&cache->verrou);
+
+    for (int c = 0; !ok && c < COUCHE_NB_MEMOIRE; c++) {
+        CoucheMemoire *couche = &cache->couches[c];
+        if (couche->pixels == NULL || couche->cle != cle \
+                || couche->sx != fig->img->sx || couche->sy != fig->img->sy)
+            continue;
+
+        for (int y = 0; y < couche->sy; y++)
+            memcpy(fig->img->tpixels[y], couche->pixels + (size_t)y*couche->sx,\
+                    couche->sx*sizeof(int));
+        memcpy(meta, couche->meta, sizeof(couche->meta));
+        ok = 1;
+    }
+
+    pthread_rwlock_unlock(&cache->verrou);
+
+    return ok;
+}
+
+/* --------------------------------------------------------------------------- */
+void Garder_couche_memoire(Figure *fig, CacheCouches *cache, uint64_t cle,\
+                            const int meta[COUCHE_NB_META])
+{
+    if (fig->backend != &backend_gd || !gdImageTrueColor(fig->img)) return;
+
+    int sx = fig->img->sx, sy = fig->img->sy;
+
+    // Copie faite hors verrou : les lectures ne sont pas bloquées
+    int *pixels = malloc((size_t)sx*sy*sizeof(int));
+    if (pixels == NULL) {
+        printf("Info : pas assez de memoire pour garder la couche statique.\n");
+        return;
+    }
+    for (int y = 0; y < sy; y++)
+        memcpy(pixels + (size_t)y*sx, fig->img->tpixels[y], sx*sizeof(int));
+
+    pthread_rwlock_wrlock(&cache->verrou);
+
+    // Couche déjà gardée par une autre requete
+    for (int c = 0; c < COUCHE_NB_MEMOIRE; c++) {
+        CoucheMemoire *couche = &cache->couches[c];
+        if (couche->pixels != NULL && couche->cle == cle \
+                && couche->sx == sx && couche->sy == sy) {
+            pthread_rwlock_unlock(&cache->verrou);
+            free(pixels);
+            return;
+        }
+    }
+
+    CoucheMemoire *couche = &cache->couches[cache->prochaine];
+    cache->prochaine = (cache->prochaine + 1) % COUCHE_NB_MEMOIRE;
+
+    int *anciens_pixels = couche->pixels;
+    couche->cle = cle;
+    couche->sx = sx;
+    couche->sy = sy;
+    memcpy(couche->meta, meta, sizeof(couche->meta));
+    couche->pixels = pixels;
+
+    pthread_rwlock_unlock(&cache->verrou);
+    free(anciens_pixels);
+}
+
+#endif
@@ -0,0 +1,337 @@
+/* ----------------------------------------------------------------------------
+*  Bibliotheque definissant le cube des statuts des stations (statut x station
+*  x date de récolte), stocké sur le tas, en mmap anonyme ou directement dans
+*  le fichier d'etat mappé (voir etat.h).
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+#ifndef CUBE_H
+#define CUBE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+/**
+ * @brief Taille (octets) à partir de laquelle le cube est alloué en mmap
+ * anonyme plutot que sur le tas
+ *
+ */
+#define CUBE_SEUIL_MMAP (1 << 20)
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Cube des statuts, rangé en struct of arrays : une colonne des epoch
+ * des dates de récolte, puis pour chaque statut et chaque station une colonne
+ * contiguë des valeurs (uint16) au cours du temps. Les deux sont dans un meme
+ * bloc [epoch : cap_rows int64][statuts : nb_statuts*nb_stations*cap_rows
+ * uint16], identique à celui du fichier d'etat.
+ * La colonne (statut, station) commence à l'index
+ * (statut*nb_stations + station)*cap_rows. cap_rows >= nb_rows permet
+ * d'ajouter des dates de récolte sans déplacer les colonnes.
+ *
+ */
+typedef struct StatusCube_s {
+    int nb_statuts;       /**< Nombre de statuts */
+    int nb_stations;      /**< Nombre de stations */
+    int nb_rows;          /**< Nombre de dates de récolte utilisées */
+    size_t cap_rows;      /**< Pas entre deux colonnes (capacité en dates) */
+    size_t taille;        /**< Taille du bloc (epoch + statuts) en octets */
+    char backing;         /**< 'h' : tas (calloc), 'm' : mmap anonyme,
+                               'f' : fichier d'etat mappé */
+    int64_t *epoch;       /**< epoch de chaque date de récolte [cap_rows] */
+    uint16_t *data;       /**< Valeurs [statut][station][cap_rows] */
+    void *map;            /**< 'f' : début du fichier mappé */
+    size_t taille_map;    /**< 'f' : taille du fichier mappé */
+} StatusCube;
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Initialise un cube de statuts rempli de 0. Le cube est alloué sur le
+ * tas, ou en mmap anonyme au dela de CUBE_SEUIL_MMAP octets.
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ * @param nb_statuts Nombre de statuts
+ * @param nb_stations Nombre de stations
+ * @param nb_rows Nombre de dates de récolte
+ * @param cap_rows Capacité en dates de récolte (ramenée à nb_rows si inférieure)
+ * @warning Desallocation via Free_cube
+ */
+void Init_cube(StatusCube *cube, int nb_statuts, int nb_stations, int nb_rows,\
+                size_t cap_rows);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Initialise un cube de statuts sur un bloc d'un fichier mappé (en
+ * MAP_SHARED) : les valeurs ajoutées dans la capacité du bloc sont écrites
+ * directement dans le fichier.
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ * @param map Début du fichier mappé
+ * @param taille_map Taille du fichier mappé
+ * @param offset Position du bloc (epoch + statuts) dans le fichier (multiple de 8)
+ * @param nb_statuts Nombre de statuts
+ * @param nb_stations Nombre de stations
+ * @param nb_rows Nombre de dates de récolte
+ * @param cap_rows Capacité en dates de récolte du bloc
+ * @warning Desallocation (munmap du fichier) via Free_cube
+ */
+void Init_cube_map(StatusCube *cube, void *map, size_t taille_map, size_t offset,\
+                    int nb_statuts, int nb_stations, int nb_rows, size_t cap_rows);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Taille en octets du bloc (epoch + statuts) d'un cube
+ *
+ * @param nb_statuts Nombre de statuts
+ * @param nb_stations Nombre de stations
+ * @param cap_rows Capacité en dates de récolte
+ * @return size_t Taille du bloc en octets
+ */
+size_t Cube_taille_bloc(int nb_statuts, int nb_stations, size_t cap_rows);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Agrandit le cube (nouvelles stations et/ou capacité en dates de
+ * récolte), en conservant les données existantes. Les nouvelles cases sont à 0.
+ * Un cube sur fichier mappé est recopié sur le tas (ou en mmap anonyme).
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ * @param nb_stations Nouveau nombre de stations (>= cube->nb_stations)
+ * @param cap_rows Nouvelle capacité en dates de récolte
+ */
+void Cube_reserve(StatusCube *cube, int nb_stations, size_t cap_rows);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Renvoie la colonne contiguë des valeurs d'un statut pour une station
+ * (nb_rows valeurs, sans copie)
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ * @param statut Index du statut
+ * @param station Index de la station
+ * @return uint16_t* Pointeur vers la 1ere valeur de la colonne
+ */
+static inline uint16_t *Cube_col(const StatusCube *cube, int statut, int station)
+{
+    return cube->data + ((size_t)statut*cube->nb_stations + station)*cube->cap_rows;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Renvoie la valeur d'un statut pour une station et une date de récolte
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ * @param statut Index du statut
+ * @param station Index de la station
+ * @param t Index de la date de récolte
+ * @return int Valeur du statut
+ */
+static inline int Cube_get(const StatusCube *cube, int statut, int station, int t)
+{
+    return Cube_col(cube, statut, station)[t];
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Modifie la valeur d'un statut pour une station et une date de récolte
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ * @param statut Index du statut
+ * @param station Index de la station
+ * @param t Index de la date de récolte
+ * @param valeur Nouvelle valeur (0 à 65535)
+ */
+static inline void Cube_set(StatusCube *cube, int statut, int station, int t,\
+                            int valeur)
+{
+    Cube_col(cube, statut, station)[t] = (uint16_t)valeur;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Copie l'ensemble des statuts d'une station pour une date de récolte
+ * dans un vecteur (utile pour les barplots)
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ * @param station Index de la station
+ * @param t Index de la date de récolte
+ * @param vect_statuts Vecteur de nb_statuts valeurs rempli par la fonction
+ */
+void Cube_get_statuts(const StatusCube *cube, int station, int t,\
+                        uint16_t vect_statuts[]);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Libère la mémoire d'un cube de statuts
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ */
+void Free_cube(StatusCube *cube);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Alloue un bloc initialisé à 0 (tas ou mmap anonyme)
+ *
+ * @param taille Taille du bloc en octets
+ * @param backing Type d'allocation choisi ('h' ou 'm'), rempli par la fonction
+ * @return void* Pointeur vers le bloc alloué
+ */
+void *Cube_alloc(size_t taille, char *backing);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Libère le bloc d'un cube (free, munmap du bloc ou du fichier mappé)
+ *
+ * @param cube Pointeur vers un objet de type StatusCube
+ */
+void Cube_free_data(StatusCube *cube);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Place les colonnes epoch et statuts d'un cube dans un bloc
+ *
+ * @param cube Pointeur vers un objet de type StatusCube (cap_rows renseigné)
+ * @param bloc Début du bloc
+ */
+void Cube_set_bloc(StatusCube *cube, void *bloc);
+
+
+/* --------------------------------------------------------------------------- */
+// Definition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+void *Cube_alloc(size_t taille, char *backing)
+{
+    void *data = NULL;
+
+    if (taille >= CUBE_SEUIL_MMAP) {
+        // Pages anonymes : remplies de 0, rendues au système au munmap
+        data = mmap(NULL, taille, PROT_READ | PROT_WRITE,\
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) data = NULL;
+        *backing = 'm';
+    } else {
+        data = calloc(1, taille);
+        *backing = 'h';
+    }
+
+    if (data == NULL) {
+        printf("Erreur : Pas assez de memoire.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return data;
+}
+
+/* --------------------------------------------------------------------------- */
+void Cube_free_data(StatusCube *cube)
+{
+    if (cube->backing == 'f')
+        munmap(cube->map, cube->taille_map);
+    else if (cube->backing == 'm')
+        munmap(cube->epoch, cube->taille);
+    else
+        free(cube->epoch);
+
+    cube->map = NULL;
+    cube->taille_map = 0;
+}
+
+/* --------------------------------------------------------------------------- */
+size_t Cube_taille_bloc(int nb_statuts, int nb_stations, size_t cap_rows)
+{
+    return cap_rows*sizeof(int64_t) \
+            + (size_t)nb_statuts*nb_stations*cap_rows*sizeof(uint16_t);
+}
+
+/* --------------------------------------------------------------------------- */
+void Cube_set_bloc(StatusCube *cube, void *bloc)
+{
+    cube->epoch = bloc;
+    cube->data = (uint16_t *)(cube->epoch + cube->cap_rows);
+}
+
+/* --------------------------------------------------------------------------- */
+void Init_cube(StatusCube *cube, int nb_statuts, int nb_stations, int nb_rows,\
+                size_t cap_rows)
+{
+    if (cap_rows < (size_t)nb_rows) cap_rows = nb_rows;
+    if (cap_rows == 0) cap_rows = 1;
+
+    cube->nb_statuts = nb_statuts;
+    cube->nb_stations = nb_stations;
+    cube->nb_rows = nb_rows;
+    cube->cap_rows = cap_rows;
+    cube->taille = Cube_taille_bloc(nb_statuts, nb_stations, cap_rows);
+    cube->map = NULL;
+    cube->taille_map = 0;
+
+    Cube_set_bloc(cube, Cube_alloc(cube->taille, &(cube->backing)));
+}
+
+/* --------------------------------------------------------------------------- */
+void Init_cube_map(StatusCube *cube, void *map, size_t taille_map, size_t offset,\
+                    int nb_statuts, int nb_stations, int nb_rows, size_t cap_rows)
+{
+    cube->nb_statuts = nb_statuts;
+    cube->nb_stations = nb_stations;
+    cube->nb_rows = nb_rows;
+    cube->cap_rows = cap_rows;
+    cube->taille = Cube_taille_bloc(nb_statuts, nb_stations, cap_rows);
+    cube->backing = 'f';
+    cube->map = map;
+    cube->taille_map = taille_map;
+
+    Cube_set_bloc(cube, (char *)map + offset);
+}
+
+/* --------------------------------------------------------------------------- */
+void Cube_reserve(StatusCube *cube, int nb_stations, size_t cap_rows)
+{
+    if (cap_rows < cube->cap_rows) cap_rows = cube->cap_rows;
+    if (nb_stations < cube->nb_stations) nb_stations = cube->nb_stations;
+    if (cap_rows == cube->cap_rows && nb_stations == cube->nb_stations) return;
+
+    StatusCube nouveau = *cube;
+    nouveau.nb_stations = nb_stations;
+    nouveau.cap_rows = cap_rows;
+    nouveau.taille = Cube_taille_bloc(cube->nb_statuts, nb_stations, cap_rows);
+    nouveau.map = NULL;
+    nouveau.taille_map = 0;
+    Cube_set_bloc(&nouveau, Cube_alloc(nouveau.taille, &(nouveau.backing)));
+
+    // Recopie colonne par colonne (le pas et l'origine des colonnes changent)
+    memcpy(nouveau.epoch, cube->epoch, cube->nb_rows*sizeof(int64_t));
+    for (int statut = 0; statut < cube->nb_statuts; statut++)
+        for (int station = 0; station < cube->nb_stations; station++)
+            memcpy(Cube_col(&nouveau, statut, station),\
+                    Cube_col(cube, statut, station), cube->nb_rows*sizeof(uint16_t));
+
+    Cube_free_data(cube);
+    *cube = nouveau;
+}
+
+/* --------------------------------------------------------------------------- */
+void Cube_get_statuts(const StatusCube *cube, int station, int t,\
+                        uint16_t vect_statuts[])
+{
+    for (int statut = 0; statut < cube->nb_statuts; statut++)
+        vect_statuts[statut] = Cube_col(cube, statut, station)[t];
+}
+
+/* --------------------------------------------------------------------------- */
+void Free_cube(StatusCube *cube)
+{
+    Cube_free_data(cube);
+    cube->epoch = NULL;
+    cube->data = NULL;
+    cube->taille = 0;
+}
+
+#endif  /* CUBE_H */
@@ -0,0 +1,799 @@
+/* ----------------------------------------------------------------------------
+*  Bibliotheque definissant un encodeur PNG par blocs, alternative à
+*  gdImagePngEx pour les images truecolor : les lignes de l'image sont
+*  découpées en blocs, chaque bloc est filtré (filtre choisi ligne par ligne)
+*  puis compressé par zlib indépendamment des autres, sur un pool de threads.
+*  Les blocs se terminent sur une frontière d'octet (Z_SYNC_FLUSH) et sont
+*  mis bout à bout dans un seul flux IDAT, comme le fait pigz.
+*  Les figures n'ayant que peu de couleurs peuvent aussi être écrites en
+*  PNG à palette (8 bits par pixel au lieu de 24) : palette exacte si
+*  l'image a au plus 256 couleurs, sinon couleurs de la figure et teintes
+*  d'anti-aliasing choisies pour minimiser l'erreur, les autres couleurs
+*  étant ramenées à la plus proche.
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+#ifndef ENCODEUR_PNG_H
+#define ENCODEUR_PNG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <zlib.h>
+#include <gd.h>
+#include "pool.h"
+
+/**
+ * @brief Nombre max de blocs d'une image
+ *
+ */
+#define PNG_NB_BLOCS_MAX 16
+
+/**
+ * @brief Nombre max de couleurs d'une palette PNG (8 bits)
+ *
+ */
+#define PNG_NB_COULEURS_MAX 256
+
+/**
+ * @brief Clé d'une case libre de la table des couleurs d'une palette (jamais
+ * une couleur : les couleurs sont sur 24 bits)
+ *
+ */
+#define PNG_CLE_VIDE 0xFFFFFFFFu
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Palette d'une image : couleurs de la palette et table de hachage 
+ * (adressage ouvert) de toutes les couleurs de l'image, avec leur nombre de 
+ * pixels et leur index dans la palette
+ *
+ */
+typedef struct PalettePng_s {
+    int nb_couleurs;                    /**< Nombre de couleurs de la palette */
+    int couleurs[PNG_NB_COULEURS_MAX];  /**< Couleurs de la palette (0xRRGGBB) */
+    int exacte;                         /**< 1 si toutes les couleurs de l'image sont dans la palette */
+    uint32_t *cles;                     /**< Couleurs de l'image (PNG_CLE_VIDE : case libre) */
+    uint32_t *comptes;                  /**< Nombre de pixels de chaque couleur */
+    unsigned char *index;               /**< Index dans la palette de chaque couleur */
+    size_t nb_cles;                     /**< Nombre de couleurs distinctes de l'image */
+    int log2_capacite;                  /**< Taille de la table : 2^log2_capacite cases */
+} PalettePng;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Bloc de lignes d'une image à encoder : entrée (lignes, paramètres
+ * zlib) et sortie (flux deflate brut, adler32 des données filtrées)
+ *
+ */
+typedef struct BlocPng_s {
+    gdImagePtr img;           /**< Image à encoder (truecolor) */
+    const PalettePng *palette; /**< Palette (PNG à palette), NULL pour du RGB */
+    int ligne_debut;          /**< Première ligne du bloc */
+    int ligne_fin;            /**< Ligne suivant la dernière ligne du bloc */
+    int niveau;               /**< Niveau de compression zlib (0-9) */
+    int strategie;            /**< Stratégie zlib (Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE...) */
+    int dernier;              /**< 1 pour le dernier bloc (Z_FINISH) */
+    unsigned char *sortie;    /**< Flux deflate brut du bloc (malloc) */
+    size_t taille_sortie;     /**< Taille du flux deflate */
+    uLong adler;              /**< Adler-32 des données filtrées du bloc */
+    size_t taille_filtree;    /**< Taille des données filtrées du bloc */
+    int erreur;               /**< 1 si l'encodage du bloc a échoué */
+} BlocPng;
+
+
+/* --------------------------------------------------------------------------- */
+// Declaration fonctions
+/* --------------------------------------------------------------------------- */
+
+/**
+ * @brief Ecrit une image truecolor au format PNG (RGB 8 bits) en encodant
+ * ses lignes par blocs en parallèle. Les palettes sont confiées à
+ * gdImagePngEx.
+ *
+ * @param img Image à écrire
+ * @param fichier Fichier de sortie (ouvert en écriture binaire)
+ * @param niveau Niveau de compression zlib (0-9)
+ * @param strategie Stratégie zlib (Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE...)
+ * @param nb_blocs Nombre de blocs (1 à PNG_NB_BLOCS_MAX), indépendant du
+ * nombre de threads : le fichier produit ne dépend que de ce nombre
+ * @return int 0 si ok, -1 sinon
+ */
+int Ecrire_png_blocs(gdImagePtr img, FILE *fichier, int niveau, int strategie, int nb_blocs);
+
+/**
+ * @brief Ecrit une image truecolor au format PNG à palette (8 bits par 
+ * pixel), encodée par blocs comme Ecrire_png_blocs. Les couleurs fixes (table
+ * des couleurs de la figure) sont toujours gardées exactes dans la palette.
+ * Si la palette ne peut être construite, l'image est écrite en RGB.
+ *
+ * @param img Image à écrire
+ * @param fichier Fichier de sortie (ouvert en écriture binaire)
+ * @param couleurs_fixes Couleurs truecolor à garder exactes
+ * @param nb_fixes Nombre de couleurs fixes
+ * @param niveau Niveau de compression zlib (0-9)
+ * @param strategie Stratégie zlib (Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE...)
+ * @param nb_blocs Nombre de blocs (1 à PNG_NB_BLOCS_MAX)
+ * @return int 0 si ok, -1 sinon
+ */
+int Ecrire_png_palette(gdImagePtr img, FILE *fichier, const int *couleurs_fixes, int nb_fixes,\
+                        int niveau, int strategie, int nb_blocs);
+
+/**
+ * @brief Construit la palette d'une image : compte les pixels de chaque 
+ * couleur, puis garde toutes les couleurs si elles sont au plus 256. Sinon 
+ * la palette contient les couleurs fixes présentes dans l'image puis, une à
+ * une, la couleur de l'image qui réduit le plus l'erreur (nombre de pixels x
+ * distance à la palette). Chaque couleur reçoit l'index de la couleur la plus
+ * proche (distance RGB).
+ *
+ * @param pal Pointeur vers un objet de type PalettePng
+ * @param img Image truecolor
+ * @param couleurs_fixes Couleurs truecolor à garder exactes
+ * @param nb_fixes Nombre de couleurs fixes
+ * @return int 0 si ok, -1 si échec d'allocation
+ */
+int Init_palette_png(PalettePng *pal, gdImagePtr img, const int *couleurs_fixes, int nb_fixes);
+
+/**
+ * @brief Libère la table des couleurs d'une palette
+ *
+ * @param pal Pointeur vers un objet de type PalettePng
+ */
+void Free_palette_png(PalettePng *pal);
+
+/**
+ * @brief Fonction interne : écrit un entier 32 bits en big endian (ordre PNG)
+ *
+ * @param p Destination (4 octets)
+ * @param v Valeur
+ */
+static inline void Ecrire_u32_png(unsigned char *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+/**
+ * @brief Fonction interne : convertit la ligne y de l'image en RGB
+ *
+ * @param img Image truecolor
+ * @param y Index de la ligne
+ * @param rgb Ligne de sortie (3*sx octets)
+ */
+void Ligne_rgb_png(gdImagePtr img, int y, unsigned char *rgb);
+
+/**
+ * @brief Fonction interne : convertit la ligne y de l'image en index de 
+ * palette
+ *
+ * @param img Image truecolor
+ * @param pal Palette de l'image (Init_palette_png)
+ * @param y Index de la ligne
+ * @param ligne Ligne de sortie (sx octets)
+ */
+void Ligne_palette_png(gdImagePtr img, const PalettePng *pal, int y, unsigned char *ligne);
+
+/**
+ * @brief Fonction interne : case d'une couleur dans la table de la palette 
+ * (case de la couleur si présente, case libre où l'insérer sinon)
+ *
+ * @param pal Pointeur vers un objet de type PalettePng
+ * @param couleur Couleur 24 bits (0xRRGGBB)
+ * @return size_t Index de la case
+ */
+size_t Case_palette_png(const PalettePng *pal, uint32_t couleur);
+
+/**
+ * @brief Fonction interne : double la taille de la table des couleurs d'une
+ * palette
+ *
+ * @param pal Pointeur vers un objet de type PalettePng
+ * @return int 0 si ok, -1 si échec d'allocation
+ */
+int Agrandir_palette_png(PalettePng *pal);
+
+/**
+ * @brief Fonction interne : carré de la distance RGB entre deux couleurs
+ *
+ * @param a Couleur 24 bits (0xRRGGBB)
+ * @param b Couleur 24 bits (0xRRGGBB)
+ * @return int Carré de la distance
+ */
+static inline int Distance_couleurs_png(uint32_t a, uint32_t b)
+{
+    int dr = (int)(a >> 16) - (int)(b >> 16);
+    int dg = (int)((a >> 8) & 0xFF) - (int)((b >> 8) & 0xFF);
+    int db = (int)(a & 0xFF) - (int)(b & 0xFF);
+    return dr*dr + dg*dg + db*db;
+}
+
+/**
+ * @brief Fonction interne : ajoute une couleur à la palette (si absente) et 
+ * met à jour la distance de chaque couleur de l'image à la palette
+ *
+ * @param pal Pointeur vers un objet de type PalettePng
+ * @param couleur Couleur 24 bits à ajouter
+ * @param cases Cases de la table des couleurs de l'image
+ * @param distances Carré de la distance de chaque couleur à la palette
+ * @param nb_cases Nombre de couleurs de l'image
+ */
+void Ajout_couleur_palette_png(PalettePng *pal, uint32_t couleur, const size_t *cases,\
+                                int *distances, size_t nb_cases);
+
+/**
+ * @brief Fonction interne : encode l'image par blocs (RGB, ou index de la 
+ * palette si palette non NULL) et écrit le fichier PNG
+ *
+ * @param img Image truecolor
+ * @param fichier Fichier de sortie
+ * @param palette Palette de l'image, NULL pour du RGB
+ * @param niveau Niveau de compression zlib (0-9)
+ * @param strategie Stratégie zlib
+ * @param nb_blocs Nombre de blocs
+ * @return int 0 si ok, -1 sinon
+ */
+int Encoder_png_blocs(gdImagePtr img, FILE *fichier, const PalettePng *palette,\
+                        int niveau, int strategie, int nb_blocs);
+
+/**
+ * @brief Fonction interne : filtre une ligne RGB avec les 5 filtres PNG et
+ * garde celui dont la somme des valeurs absolues (octets signés) est minimale
+ * (heuristique de libpng)
+ *
+ * @param ligne Ligne courante (n octets)
+ * @param prec Ligne précédente (n octets, zéros pour la première ligne)
+ * @param n Nombre d'octets de la ligne
+ * @param sortie Ligne filtrée : type de filtre puis n octets
+ * @param essai Tampon de travail (n octets)
+ */
+void Filtre_ligne_png(const unsigned char *ligne, const unsigned char *prec, size_t n,\
+                        unsigned char *sortie, unsigned char *essai);
+
+/**
+ * @brief Fonction interne : tache d'encodage d'un bloc (filtrage, adler32 et
+ * deflate brut). Les lignes d'index de palette ne sont pas filtrées (filtre 
+ * 0, recommandé par la norme PNG pour les palettes).
+ *
+ * @param arg Pointeur vers un BlocPng
+ */
+void Tache_bloc_png(void *arg);
+
+/**
+ * @brief Fonction interne : écrit un chunk PNG (longueur, type, données, crc)
+ *
+ * @param fichier Fichier de sortie
+ * @param type Type du chunk (4 caractères)
+ * @param data Données du chunk
+ * @param len Taille des données
+ * @return int 1 si ok, 0 sinon
+ */
+int Ecrire_chunk_png(FILE *fichier, const char *type, const unsigned char *data, uint32_t len);
+
+
+/* --------------------------------------------------------------------------- */
+// Définition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+void Ligne_rgb_png(gdImagePtr img, int y, unsigned char *rgb)
+{
+    const int *px = img->tpixels[y];
+
+    for (int x = 0; x < img->sx; x++) {
+        rgb[3*x]   = gdTrueColorGetRed(px[x]);
+        rgb[3*x+1] = gdTrueColorGetGreen(px[x]);
+        rgb[3*x+2] = gdTrueColorGetBlue(px[x]);
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+size_t Case_palette_png(const PalettePng *pal, uint32_t couleur)
+{
+    size_t masque = ((size_t)1 << pal->log2_capacite) - 1;
+    size_t i = (uint32_t)(couleur * 0x9E3779B1u) >> (32 - pal->log2_capacite);
+
+    while (pal->cles[i] != PNG_CLE_VIDE && pal->cles[i] != couleur)
+        i = (i + 1) & masque;
+
+    return i;
+}
+
+/* --------------------------------------------------------------------------- */
+int Agrandir_palette_png(PalettePng *pal)
+{
+    size_t ancienne_capacite = (size_t)1 << pal->log2_capacite;
+    uint32_t *anciennes_cles = pal->cles, *anciens_comptes = pal->comptes;
+
+    size_t capacite = 2 * ancienne_capacite;
+    uint32_t *cles = malloc(capacite * sizeof(*cles));
+    uint32_t *comptes = malloc(capacite * sizeof(*comptes));
+    unsigned char *index = malloc(capacite);
+    if (cles == NULL || comptes == NULL || index == NULL) {
+        free(cles);
+        free(comptes);
+        free(index);
+        return -1;
+    }
+    memset(cles, 0xff, capacite * sizeof(*cles));
+
+    free(pal->index);
+    pal->cles = cles;
+    pal->comptes = comptes;
+    pal->index = index;
+    pal->log2_capacite++;
+
+    for (size_t i = 0; i < ancienne_capacite; i++) {
+        if (anciennes_cles[i] == PNG_CLE_VIDE) continue;
+        size_t c = Case_palette_png(pal, anciennes_cles[i]);
+        pal->cles[c] = anciennes_cles[i];
+        pal->comptes[c] = anciens_comptes[i];
+    }
+
+    free(anciennes_cles);
+    free(anciens_comptes);
+    return 0;
+}
+
+/* --------------------------------------------------------------------------- */
+void Ajout_couleur_palette_png(PalettePng *pal, uint32_t couleur, const size_t *cases,\
+                                int *distances, size_t nb_cases)
+{
+    for (int k = 0; k < pal->nb_couleurs; k++)
+        if ((uint32_t)pal->couleurs[k] == couleur) return;
+
+    pal->couleurs[pal->nb_couleurs++] = couleur;
+
+    for (size_t k = 0; k < nb_cases; k++) {
+        int d = Distance_couleurs_png(pal->cles[cases[k]], couleur);
+        if (d < distances[k]) distances[k] = d;
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+int Init_palette_png(PalettePng *pal, gdImagePtr img, const int *couleurs_fixes, int nb_fixes)
+{
+    pal->nb_couleurs = 0;
+    pal->exacte = 1;
+    pal->nb_cles = 0;
+    pal->log2_capacite = 10;
+    pal->cles = malloc(((size_t)1 << pal->log2_capacite) * sizeof(*pal->cles));
+    pal->comptes = malloc(((size_t)1 << pal->log2_capacite) * sizeof(*pal->comptes));
+    pal->index = malloc((size_t)1 << pal->log2_capacite);
+    if (pal->cles == NULL || pal->comptes == NULL || pal->index == NULL) {
+        Free_palette_png(pal);
+        return -1;
+    }
+    memset(pal->cles, 0xff, ((size_t)1 << pal->log2_capacite) * sizeof(*pal->cles));
+
+    // Histogramme des couleurs (les pixels voisins ont souvent la même)
+    uint32_t prec = PNG_CLE_VIDE;
+    size_t c = 0;
+    for (int y = 0; y < img->sy; y++) {
+        const int *px = img->tpixels[y];
+        for (int x = 0; x < img->sx; x++) {
+            uint32_t couleur = px[x] & 0xFFFFFF;
+            if (couleur != prec) {
+                if (2 * (pal->nb_cles + 1) > ((size_t)1 << pal->log2_capacite) \
+                    && Agrandir_palette_png(pal) != 0) {
+                    Free_palette_png(pal);
+                    return -1;
+                }
+                c = Case_palette_png(pal, couleur);
+                if (pal->cles[c] == PNG_CLE_VIDE) {
+                    pal->cles[c] = couleur;
+                    pal->comptes[c] = 0;
+                    pal->nb_cles++;
+                }
+                prec = couleur;
+            }
+            pal->comptes[c]++;
+        }
+    }
+
+    size_t capacite = (size_t)1 << pal->log2_capacite;
+
+    // Au plus 256 couleurs : palette exacte
+    if (pal->nb_cles <= PNG_NB_COULEURS_MAX) {
+        for (size_t i = 0; i < capacite; i++) {
+            if (pal->cles[i] == PNG_CLE_VIDE) continue;
+            pal->index[i] = pal->nb_couleurs;
+            pal->couleurs[pal->nb_couleurs++] = pal->cles[i];
+        }
+        return 0;
+    }
+
+    // Sinon : couleurs fixes présentes dans l'image, puis ajout une à une de 
+    // la couleur qui réduit le plus l'erreur (nombre de pixels x distance à 
+    // la palette) : les teintes d'anti-aliasing sont réparties entre les 
+    // couleurs de la figure au lieu de s'accumuler autour des plus fréquentes
+    pal->exacte = 0;
+    size_t *cases = malloc(pal->nb_cles * sizeof(*cases));
+    int *distances = malloc(pal->nb_cles * sizeof(*distances));
+    if (cases == NULL || distances == NULL) {
+        free(cases);
+        free(distances);
+        Free_palette_png(pal);
+        return -1;
+    }
+
+    size_t nb_cases = 0;
+    for (size_t i = 0; i < capacite; i++) {
+        if (pal->cles[i] == PNG_CLE_VIDE) continue;
+        distances[nb_cases] = INT_MAX;
+        cases[nb_cases++] = i;
+    }
+
+    for (int f = 0; f < nb_fixes && pal->nb_couleurs < PNG_NB_COULEURS_MAX; f++) {
+        uint32_t couleur = couleurs_fixes[f] & 0xFFFFFF;
+        if (pal->cles[Case_palette_png(pal, couleur)] != PNG_CLE_VIDE)
+            Ajout_couleur_palette_png(pal, couleur, cases, distances, nb_cases);
+    }
+
+    while (pal->nb_couleurs < PNG_NB_COULEURS_MAX) {
+        uint64_t erreur_max = 0;
+        size_t choix = 0;
+        for (size_t k = 0; k < nb_cases; k++) {
+            uint64_t erreur = (uint64_t)pal->comptes[cases[k]] * (uint32_t)distances[k];
+            if (erreur > erreur_max) {
+                erreur_max = erreur;
+                choix = k;
+            }
+        }
+        if (erreur_max == 0) break;
+        Ajout_couleur_palette_png(pal, pal->cles[cases[choix]], cases, distances, nb_cases);
+    }
+    free(cases);
+    free(distances);
+
+    // Index de chaque couleur de l'image : couleur la plus proche de la palette
+    for (size_t i = 0; i < capacite; i++) {
+        if (pal->cles[i] == PNG_CLE_VIDE) continue;
+        int meilleur = 0, d_min = INT_MAX;
+        for (int k = 0; k < pal->nb_couleurs && d_min > 0; k++) {
+            int d = Distance_couleurs_png(pal->cles[i], pal->couleurs[k]);
+            if (d < d_min) {
+                d_min = d;
+                meilleur = k;
+            }
+        }
+        pal->index[i] = meilleur;
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------- */
+void Free_palette_png(PalettePng *pal)
+{
+    free(pal->cles);
+    free(pal->comptes);
+    free(pal->index);
+    pal->cles = pal->comptes = NULL;
+    pal->index = NULL;
+    pal->nb_cles = 0;
+}
+
+/* --------------------------------------------------------------------------- */
+void Ligne_palette_png(gdImagePtr img, const PalettePng *pal, int y, unsigned char *ligne)
+{
+    const int *px = img->tpixels[y];
+    uint32_t prec = PNG_CLE_VIDE;
+    unsigned char index = 0;
+
+    for (int x = 0; x < img->sx; x++) {
+        uint32_t couleur = px[x] & 0xFFFFFF;
+        if (couleur != prec) {
+            index = pal->index[Case_palette_png(pal, couleur)];
+            prec = couleur;
+        }
+        ligne[x] = index;
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+void Filtre_ligne_png(const unsigned char *ligne, const unsigned char *prec, size_t n,\
+                        unsigned char *sortie, unsigned char *essai)
+{
+    const size_t bpp = 3;   /**< Octets par pixel (RGB) */
+    unsigned long meilleur = ULONG_MAX;
+
+    for (int filtre = 0; filtre < 5; filtre++) {
+        // a : gauche, b : haut, c : haut gauche (0 hors de l'image). Le
+        // premier pixel est traité à part pour garder des boucles sans test
+        switch (filtre) {
+            case 0:
+                memcpy(essai, ligne, n);
+                break;
+            case 1:
+                memcpy(essai, ligne, bpp);
+                for (size_t i = bpp; i < n; i++)
+                    essai[i] = ligne[i] - ligne[i-bpp];
+                break;
+            case 2:
+                for (size_t i = 0; i < n; i++)
+                    essai[i] = ligne[i] - prec[i];
+                break;
+            case 3:
+                for (size_t i = 0; i < bpp; i++)
+                    essai[i] = ligne[i] - (prec[i] >> 1);
+                for (size_t i = bpp; i < n; i++)
+                    essai[i] = ligne[i] - ((ligne[i-bpp] + prec[i]) >> 1);
+                break;
+            default:
+                // Paeth avec a = c = 0 : le prédicteur vaut b
+                for (size_t i = 0; i < bpp; i++)
+                    essai[i] = ligne[i] - prec[i];
+                for (size_t i = bpp; i < n; i++) {
+                    int a = ligne[i-bpp];
+                    int b = prec[i];
+                    int c = prec[i-bpp];
+                    int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2*c);
+                    essai[i] = ligne[i] - ((pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c));
+                }
+        }
+
+        // Somme des valeurs absolues des octets vus comme signés
+        unsigned long somme = 0;
+        for (size_t i = 0; i < n; i++)
+            somme += abs((signed char)essai[i]);
+
+        if (somme < meilleur) {
+            meilleur = somme;
+            sortie[0] = filtre;
+            memcpy(sortie + 1, essai, n);
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+void Tache_bloc_png(void *arg)
+{
+    BlocPng *bloc = arg;
+    gdImagePtr img = bloc->img;
+    const size_t n = (bloc->palette != NULL ? 1 : 3) * (size_t)img->sx;
+    const int nb_lignes = bloc->ligne_fin - bloc->ligne_debut;
+
+    bloc->taille_filtree = (n + 1) * nb_lignes;
+    bloc->sortie = NULL;
+    bloc->erreur = 1;
+
+    unsigned char *filtre = malloc(bloc->taille_filtree);
+    unsigned char *tampons = calloc(3, n);
+    if (filtre == NULL || tampons == NULL) {
+        free(filtre);
+        free(tampons);
+        return;
+    }
+
+    // Lignes courante et précédente (la ligne avant le bloc sert de
+    // référence au filtrage de sa première ligne)
+    unsigned char *ligne = tampons, *prec = tampons + n, *essai = tampons + 2*n;
+    if (bloc->palette == NULL && bloc->ligne_debut > 0)
+        Ligne_rgb_png(img, bloc->ligne_debut - 1, prec);
+
+    for (int y = bloc->ligne_debut; y < bloc->ligne_fin; y++) {
+        unsigned char *sortie = filtre + (size_t)(y - bloc->ligne_debut)*(n + 1);
+        if (bloc->palette != NULL) {
+            sortie[0] = 0;
+            Ligne_palette_png(img, bloc->palette, y, sortie + 1);
+            continue;
+        }
+
+        Ligne_rgb_png(img, y, ligne);
+        Filtre_ligne_png(ligne, prec, n, sortie, essai);
+
+        unsigned char *tmp = prec;
+        prec = ligne;
+        ligne = tmp;
+    }
+    free(tampons);
+
+    bloc->adler = adler32(adler32(0L, Z_NULL, 0), filtre, bloc->taille_filtree);
+
+    // Deflate brut (sans en-tete zlib), terminé par Z_SYNC_FLUSH sauf pour le
+    // dernier bloc : les flux se concatènent en un seul flux valide
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, bloc->niveau, Z_DEFLATED, -15, 8, bloc->strategie) != Z_OK) {
+        free(filtre);
+        return;
+    }
+
+    size_t capacite = deflateBound(&zs, bloc->taille_filtree) + 64;
+    bloc->sortie = malloc(capacite);
+    if (bloc->sortie == NULL) {
+        deflateEnd(&zs);
+        free(filtre);
+        return;
+    }
+
+    zs.next_in = filtre;
+    zs.avail_in = bloc->taille_filtree;
+    zs.next_out = bloc->sortie;
+    zs.avail_out = capacite;
+
+    int ret = deflate(&zs, bloc->dernier ? Z_FINISH : Z_SYNC_FLUSH);
+    int ok = bloc->dernier ? (ret == Z_STREAM_END) : (ret == Z_OK && zs.avail_in == 0\
+                                                        && zs.avail_out > 0);
+    bloc->taille_sortie = capacite - zs.avail_out;
+
+    deflateEnd(&zs);
+    free(filtre);
+
+    if (!ok) {
+        free(bloc->sortie);
+        bloc->sortie = NULL;
+        return;
+    }
+
+    bloc->erreur = 0;
+}
+
+/* --------------------------------------------------------------------------- */
+int Ecrire_chunk_png(FILE *fichier, const char *type, const unsigned char *data, uint32_t len)
+{
+    unsigned char entete[8];
+    Ecrire_u32_png(entete, len);
+    memcpy(entete + 4, type, 4);
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, entete + 4, 4);
+    if (len > 0) crc = crc32(crc, data, len);
+
+    unsigned char fin[4];
+    Ecrire_u32_png(fin, crc);
+
+    return fwrite(entete, 1, 8, fichier) == 8 \
+        && (len == 0 || fwrite(data, 1, len, fichier) == len) \
+        && fwrite(fin, 1, 4, fichier) == 4;
+}
+
+/* --------------------------------------------------------------------------- */
+int Ecrire_png_blocs(gdImagePtr img, FILE *fichier, int niveau, int strategie, int nb_blocs)
+{
+    if (fichier == NULL) return -1;
+
+    if (!gdImageTrueColor(img)) {
+        gdImagePngEx(img, fichier, niveau);
+        return 0;
+    }
+
+    return Encoder_png_blocs(img, fichier, NULL, niveau, strategie, nb_blocs);
+}
+
+/* --------------------------------------------------------------------------- */
+int Ecrire_png_palette(gdImagePtr img, FILE *fichier, const int *couleurs_fixes, int nb_fixes,\
+                        int niveau, int strategie, int nb_blocs)
+{
+    if (fichier == NULL) return -1;
+
+    if (!gdImageTrueColor(img)) {
+        gdImagePngEx(img, fichier, niveau);
+        return 0;
+    }
+
+    PalettePng palette;
+    if (Init_palette_png(&palette, img, couleurs_fixes, nb_fixes) != 0) {
+        printf("Info : palette png impossible a construire, encodage en RGB.\n");
+        return Encoder_png_blocs(img, fichier, NULL, niveau, strategie, nb_blocs);
+    }
+
+    int ret = Encoder_png_blocs(img, fichier, &palette, niveau, strategie, nb_blocs);
+    Free_palette_png(&palette);
+
+    return ret;
+}
+
+/* --------------------------------------------------------------------------- */
+int Encoder_png_blocs(gdImagePtr img, FILE *fichier, const PalettePng *palette,\
+                        int niveau, int strategie, int nb_blocs)
+{
+    if (niveau < 0 || niveau > 9) niveau = Z_DEFAULT_COMPRESSION;
+    if (nb_blocs < 1) nb_blocs = 1;
+    if (nb_blocs > PNG_NB_BLOCS_MAX) nb_blocs = PNG_NB_BLOCS_MAX;
+    if (nb_blocs > img->sy) nb_blocs = img->sy;
+
+    // Découpage en blocs de lignes de même taille (à une ligne près)
+    BlocPng blocs[PNG_NB_BLOCS_MAX];
+    for (int b = 0; b < nb_blocs; b++) {
+        blocs[b].img = img;
+        blocs[b].palette = palette;
+        blocs[b].ligne_debut = (int)((long)img->sy * b / nb_blocs);
+        blocs[b].ligne_fin = (int)((long)img->sy * (b+1) / nb_blocs);
+        blocs[b].niveau = niveau;
+        blocs[b].strategie = strategie;
+        blocs[b].dernier = (b == nb_blocs - 1);
+    }
+
+    // Un seul bloc : encodé directement dans le thread appelant
+    PoolTaches pool;
+    Init_pool_taches(&pool, nb_blocs > 1 ? Nb_threads_pool(nb_blocs) : 0);
+    for (int b = 0; b < nb_blocs; b++)
+        Ajout_tache(&pool, Tache_bloc_png, &blocs[b]);
+    Free_pool_taches(&pool);
+
+    // Flux IDAT : en-tete zlib, blocs bout à bout, adler32 combiné
+    int ok = 1;
+    size_t taille_idat = 2 + 4;
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (int b = 0; b < nb_blocs; b++) {
+        if (blocs[b].erreur) {
+            ok = 0;
+            continue;
+        }
+        taille_idat += blocs[b].taille_sortie;
+        adler = adler32_combine(adler, blocs[b].adler, blocs[b].taille_filtree);
+    }
+
+    unsigned char *idat = ok ? malloc(taille_idat) : NULL;
+    if (idat != NULL) {
+        // FLEVEL comme zlib : 0 (rapide) à 3 (maximal)
+        int flevel = niveau == Z_DEFAULT_COMPRESSION ? 2 :\
+                     niveau < 2 ? 0 : niveau < 6 ? 1 : niveau == 6 ? 2 : 3;
+        int entete_zlib = (0x78 << 8) | (flevel << 6);
+        entete_zlib += 31 - entete_zlib % 31;
+
+        size_t pos = 0;
+        idat[pos++] = entete_zlib >> 8;
+        idat[pos++] = entete_zlib & 0xff;
+        for (int b = 0; b < nb_blocs; b++) {
+            memcpy(idat + pos, blocs[b].sortie, blocs[b].taille_sortie);
+            pos += blocs[b].taille_sortie;
+        }
+        Ecrire_u32_png(idat + pos, adler);
+    }
+
+    for (int b = 0; b < nb_blocs; b++)
+        free(blocs[b].sortie);
+
+    if (idat == NULL) {
+        printf("Info : echec de l'encodage png par blocs, encodage par libgd.\n");
+        gdImagePngEx(img, fichier, niveau);
+        return 0;
+    }
+
+    // Signature, IHDR (RGB ou palette 8 bits, sans entrelacement), PLTE, 
+    // pHYs (résolution de l'image, comme libgd), IDAT et IEND
+    static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+
+    unsigned char ihdr[13];
+    Ecrire_u32_png(ihdr, img->sx);
+    Ecrire_u32_png(ihdr + 4, img->sy);
+    ihdr[8] = 8;    // bits par composante
+    ihdr[9] = palette != NULL ? 3 : 2;    // palette ou RGB
+    ihdr[10] = 0;   // deflate
+    ihdr[11] = 0;   // filtrage adaptatif
+    ihdr[12] = 0;   // pas d'entrelacement
+
+    unsigned char phys[9];
+    Ecrire_u32_png(phys, (uint32_t)(img->res_x * 100.0 / 2.54 + 0.5));
+    Ecrire_u32_png(phys + 4, (uint32_t)(img->res_y * 100.0 / 2.54 + 0.5));
+    phys[8] = 1;    // pixels par mètre
+
+    unsigned char plte[3 * PNG_NB_COULEURS_MAX];
+    int nb_couleurs = palette != NULL ? palette->nb_couleurs : 0;
+    for (int k = 0; k < nb_couleurs; k++) {
+        plte[3*k]   = palette->couleurs[k] >> 16;
+        plte[3*k+1] = palette->couleurs[k] >> 8;
+        plte[3*k+2] = palette->couleurs[k];
+    }
+
+    ok = fwrite(signature, 1, 8, fichier) == 8 \
+        && Ecrire_chunk_png(fichier, "IHDR", ihdr, sizeof(ihdr)) \
+        && (nb_couleurs == 0 || Ecrire_chunk_png(fichier, "PLTE", plte, 3 * nb_couleurs)) \
+        && Ecrire_chunk_png(fichier, "pHYs", phys, sizeof(phys)) \
+        && Ecrire_chunk_png(fichier, "IDAT", idat, taille_idat) \
+        && Ecrire_chunk_png(fichier, "IEND", NULL, 0);
+
+    free(idat);
+
+    return ok ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,414 @@
+/* ----------------------------------------------------------------------------
+*  Bibliotheque gerant le fichier d'etat des donnees stations : cliché
+*  binaire en colonnes (stations, colonne des epoch, une colonne uint16 par
+*  statut et par station) et watermark (epoch de la derniere recolte traitee).
+*  Le fichier est mappé en memoire et sert directement de cube des statuts ;
+*  seules les nouvelles recoltes sont lues dans la bdd et ajoutées en place.
+*  Les accès au fichier sont sérialisés par un verrou exclusif (flock) sur
+*  <fichier d'etat>.lock, tenu du chargement à la sauvegarde.
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+#ifndef ETAT_H
+#define ETAT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sqlite3.h>
+#include "getter.h"
+#include "cube.h"
+
+/**
+ * @brief Signature en tete du fichier d'etat (change si le format change)
+ *
+ */
+#define ETAT_MAGIC "BELIBET4"
+
+/**
+ * @brief Taille max du nom de table stocké dans le fichier d'etat
+ *
+ */
+#define ETAT_LEN_TABLE 32
+
+/**
+ * @brief Capacité en dates de récolte réservée en plus dans le fichier, pour
+ * ajouter les nouvelles récoltes en place sans réécrire le fichier
+ *
+ */
+#define ETAT_MARGE_ROWS 64
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief En tete du fichier d'etat. Suivi de la table des stations (ID,
+ * adresse, label) puis, à offset_cube, du bloc du cube des statuts : colonne
+ * des epoch (cap_rows int64) et colonnes des statuts (cap_rows uint16 chacune).
+ *
+ */
+typedef struct EnteteEtat_s {
+    char magic[8];                  /**< ETAT_MAGIC */
+    int32_t version_bdd;            /**< VERSION_BDD à la sauvegarde */
+    int32_t nb_statuts;             /**< Nombre de statuts */
+    int32_t nb_stations;            /**< Nombre de stations */
+    int32_t nb_rows;                /**< Nombre de dates de récolte */
+    int64_t cap_rows;               /**< Capacité en dates de récolte du bloc */
+    int64_t epoch_debut;            /**< epoch de la 1ere date de récolte */
+    int64_t watermark;              /**< epoch de la derniere date de récolte */
+    int32_t fenetre_jours;          /**< Fenetre : nombre de jours (0 : tout) */
+    int32_t resolution;             /**< Fenetre : résolution en minutes */
+    int64_t epoch_fenetre;          /**< Fenetre : borne basse en epoch */
+    int64_t somme_controle[3];      /**< Bdd : nb lignes, somme des epoch et des statuts */
+    int64_t offset_cube;            /**< Position du bloc du cube (octets) */
+    char table[ETAT_LEN_TABLE];     /**< Table de la bdd d'origine */
+} EnteteEtat;
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Prend le verrou exclusif du fichier d'etat (flock sur 
+ * <fichier_etat>.lock, attente si un autre process le tient). Le verrou est
+ * posé sur un fichier à part : le fichier d'etat lui-meme peut etre remplacé
+ * par renommage pendant qu'un autre process attend.
+ *
+ * @param fichier_etat Chemin du fichier d'etat
+ * @return int Descripteur du verrou, -1 si le verrou n'a pas pu etre pris
+ * (fichier d'etat à ne pas utiliser)
+ */
+int Lock_etat(char *fichier_etat);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Libère le verrou pris par Lock_etat
+ *
+ * @param fd_verrou Descripteur renvoyé par Lock_etat (ignoré si < 0)
+ */
+void Unlock_etat(int fd_verrou);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Sauvegarde un objet StationsData dans le fichier d'etat. Si le cube
+ * est encore celui du fichier mappé (pas de nouvelle station ni de
+ * dépassement de capacité), les nouvelles récoltes y sont déjà écrites : seul
+ * l'en tete est mis à jour, après synchronisation des données. Sinon le
+ * fichier est réécrit (fichier temporaire puis renommage). A appeler avec le
+ * verrou de Lock_etat.
+ *
+ * @param db_belib Pointeur type sqlite3 vers la base de donnée (somme de contrôle)
+ * @param data Pointeur vers un objet de type StationsData
+ * @param table Nom de la table dans la bdd d'où viennent les données
+ * @param fichier_etat Chemin du fichier d'etat
+ * @return int 0 si la sauvegarde a réussi, -1 sinon
+ */
+int Save_etat(sqlite3 *db_belib, StationsData *data, char *table, char *fichier_etat);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Charge un objet StationsData depuis le fichier d'etat, mappé en
+ * MAP_SHARED : le cube des statuts pointe directement dans le fichier. L'etat
+ * est vérifié avant usage (version du schema, table, nombre de statuts,
+ * fenetre temporelle, 1ere date de récolte de la fenetre et somme de contrôle
+ * des lignes de la bdd jusqu'au watermark). La borne basse de la fenetre
+ * avance une fois par jour : l'etat est alors refusé et la fenetre rechargée.
+ * A appeler avec le verrou de Lock_etat, gardé jusqu'à Save_etat : les
+ * récoltes sont ajoutées en place dans le fichier mappé.
+ *
+ * @param db_belib Pointeur type sqlite3 vers la base de donnée
+ * @param table Nom de la table dans la bdd
+ * @param nb_statuts Nombre de statuts attendus
+ * @param fenetre Fenetre temporelle demandée (NULL : tout l'historique)
+ * @param fichier_etat Chemin du fichier d'etat
+ * @param data Pointeur vers un objet de type StationsData rempli par la fonction
+ * @return int 0 si l'etat a été chargé, -1 sinon (data non alloué)
+ * @warning Malloc et mmap faits si succès, desallocation via Free_stations_data
+ */
+int Load_etat(sqlite3 *db_belib, char *table, int nb_statuts, Fenetre *fenetre,\
+                char *fichier_etat, StationsData *data);
+
+
+/* --------------------------------------------------------------------------- */
+// Definition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+int Lock_etat(char *fichier_etat)
+{
+    char fichier_verrou[strlen(fichier_etat)+6];
+    sprintf(fichier_verrou, "%s.lock", fichier_etat);
+
+    int fd_verrou = open(fichier_verrou, O_RDWR | O_CREAT, 0644);
+    if (fd_verrou < 0) {
+        printf("Info : impossible d'ouvrir le verrou %s.\n", fichier_verrou);
+        return -1;
+    }
+
+    // Attente si un autre process tient le verrou (relance sur signal)
+    int res;
+    while ((res = flock(fd_verrou, LOCK_EX)) != 0 && errno == EINTR);
+
+    if (res != 0) {
+        printf("Info : impossible de verrouiller %s.\n", fichier_verrou);
+        close(fd_verrou);
+        return -1;
+    }
+
+    return fd_verrou;
+}
+
+/* --------------------------------------------------------------------------- */
+void Unlock_etat(int fd_verrou)
+{
+    if (fd_verrou < 0) return;
+
+    flock(fd_verrou, LOCK_UN);
+    close(fd_verrou);
+}
+
+/* --------------------------------------------------------------------------- */
+int Save_etat(sqlite3 *db_belib, StationsData *data, char *table, char *fichier_etat)
+{
+    StatusCube *cube = &(data->statuts);
+
+    sqlite3_int64 somme_controle[3];
+
+    // Cube toujours dans le fichier mappé : mise à jour en place
+    if (cube->backing == 'f') {
+        EnteteEtat *entete = cube->map;
+
+        // Lignes jusqu'à l'ancien watermark vérifiées par Load_etat : seules
+        // les nouvelles récoltes sont ajoutées à la somme de contrôle
+        Get_somme_controle(db_belib, table, entete->watermark + 1, data->watermark,\
+                            somme_controle);
+        for (int i = 0; i < 3; i++)
+            somme_controle[i] += entete->somme_controle[i];
+
+        // Données d'abord, en tete ensuite : un arret entre les deux laisse un
+        // etat cohérent (anciennes récoltes seulement)
+        if (msync(cube->map, cube->taille_map, MS_SYNC) != 0) return -1;
+
+        entete->nb_rows = data->nb_rows_par_station;
+        entete->epoch_debut = data->epoch_debut;
+        entete->watermark = data->watermark;
+        for (int i = 0; i < 3; i++)
+            entete->somme_controle[i] = somme_controle[i];
+
+        return msync(cube->map, sizeof(EnteteEtat), MS_SYNC) == 0 ? 0 : -1;
+    }
+
+    // Sinon : réécriture complète du fichier
+    Get_somme_controle(db_belib, table, data->fenetre.epoch_debut, data->watermark,\
+                        somme_controle);
+
+    char fichier_tmp[strlen(fichier_etat)+5];
+    sprintf(fichier_tmp, "%s.tmp", fichier_etat);
+
+    FILE *f = fopen(fichier_tmp, "wb");
+    if (f == NULL) {
+        printf("Info : impossible d'ecrire le fichier d'etat %s.\n", fichier_tmp);
+        return -1;
+    }
+
+    int nb_rows = data->nb_rows_par_station;
+    size_t cap_rows = cube->cap_rows;
+    if (cap_rows < (size_t)nb_rows + ETAT_MARGE_ROWS) cap_rows = nb_rows + ETAT_MARGE_ROWS;
+
+    EnteteEtat entete;
+    memset(&entete, 0, sizeof(entete));
+    memcpy(entete.magic, ETAT_MAGIC, sizeof(entete.magic));
+    entete.version_bdd = VERSION_BDD;
+    entete.nb_statuts = data->nb_statuts;
+    entete.nb_stations = data->nb_stations;
+    entete.nb_rows = nb_rows;
+    entete.cap_rows = cap_rows;
+    entete.epoch_debut = data->epoch_debut;
+    entete.watermark = data->watermark;
+    entete.fenetre_jours = data->fenetre.nb_jours;
+    entete.resolution = data->fenetre.resolution;
+    entete.epoch_fenetre = data->fenetre.epoch_debut;
+    for (int i = 0; i < 3; i++)
+        entete.somme_controle[i] = somme_controle[i];
+    strncpy(entete.table, table, ETAT_LEN_TABLE-1);
+
+    // Position du bloc du cube : après la table des stations, alignée sur 8
+    size_t offset = sizeof(entete);
+    for (int st = 0; st < data->nb_stations; st++)
+        offset += 3*sizeof(int32_t) + strlen(data->tableau_adresses[st]) \
+                    + strlen(data->tableau_labels[st]);
+    offset = (offset + 7) & ~(size_t)7;
+    entete.offset_cube = offset;
+
+    int ok = (fwrite(&entete, sizeof(entete), 1, f) == 1);
+
+    // Stations : ID, adresse et label (longueur puis caractères)
+    for (int st = 0; ok && st < data->nb_stations; st++) {
+        int32_t id = data->tableau_ids[st];
+        int32_t len_adresse = strlen(data->tableau_adresses[st]);
+        int32_t len_label = strlen(data->tableau_labels[st]);
+
+        ok = fwrite(&id, sizeof(id), 1, f) == 1 \
+          && fwrite(&len_adresse, sizeof(len_adresse), 1, f) == 1 \
+          && fwrite(data->tableau_adresses[st], 1, len_adresse, f) == (size_t)len_adresse \
+          && fwrite(&len_label, sizeof(len_label), 1, f) == 1 \
+          && fwrite(data->tableau_labels[st], 1, len_label, f) == (size_t)len_label;
+    }
+
+    // Colonne des epoch, puis colonnes des statuts, au pas cap_rows (la
+    // capacité restante est laissée à 0 par ftruncate)
+    ok = ok && fseek(f, offset, SEEK_SET) == 0 \
+            && fwrite(cube->epoch, sizeof(int64_t), nb_rows, f) == (size_t)nb_rows;
+
+    size_t offset_col = offset + cap_rows*sizeof(int64_t);
+    for (int statut = 0; ok && statut < data->nb_statuts; statut++)
+        for (int st = 0; ok && st < data->nb_stations; st++) {
+            ok = fseek(f, offset_col, SEEK_SET) == 0 \
+              && fwrite(Cube_col(cube, statut, st), sizeof(uint16_t), nb_rows, f) \
+                    == (size_t)nb_rows;
+            offset_col += cap_rows*sizeof(uint16_t);
+        }
+
+    ok = ok && fflush(f) == 0 \
+            && ftruncate(fileno(f), offset_col) == 0;
+
+    if (fclose(f) != 0) ok = 0;
+
+    if (!ok || rename(fichier_tmp, fichier_etat) != 0) {
+        printf("Info : echec de l'ecriture du fichier d'etat %s.\n", fichier_etat);
+        remove(fichier_tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------- */
+int Load_etat(sqlite3 *db_belib, char *table, int nb_statuts, Fenetre *fenetre,\
+                char *fichier_etat, StationsData *data)
+{
+    int fd = open(fichier_etat, O_RDWR);
+    if (fd < 0) return -1;
+
+    struct stat st_fichier;
+    if (fstat(fd, &st_fichier) != 0 || (size_t)st_fichier.st_size < sizeof(EnteteEtat)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t taille_map = st_fichier.st_size;
+    char *map = mmap(NULL, taille_map, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    Fenetre fenetre_bdd = {0, 0, -1};
+    if (fenetre != NULL) {
+        fenetre_bdd = *fenetre;
+        fenetre_bdd.epoch_debut = Get_debut_fenetre(db_belib, table, fenetre->nb_jours);
+    }
+
+    // Test de compatibilite de l'etat avec la bdd
+    EnteteEtat *entete = (EnteteEtat *)map;
+    int ok = memcmp(entete->magic, ETAT_MAGIC, sizeof(entete->magic)) == 0 \
+        && entete->version_bdd == VERSION_BDD \
+        && entete->nb_statuts == nb_statuts \
+        && entete->nb_stations >= 0 && entete->nb_rows >= 0 \
+        && entete->cap_rows >= entete->nb_rows \
+        && entete->offset_cube >= (int64_t)sizeof(EnteteEtat) \
+        && entete->offset_cube % 8 == 0 \
+        && entete->offset_cube + Cube_taille_bloc(nb_statuts, entete->nb_stations,\
+                                    entete->cap_rows) <= taille_map \
+        && strncmp(entete->table, table, ETAT_LEN_TABLE) == 0 \
+        && entete->fenetre_jours == fenetre_bdd.nb_jours \
+        && entete->resolution == fenetre_bdd.resolution \
+        && entete->epoch_fenetre == fenetre_bdd.epoch_debut \
+        && entete->epoch_debut == Get_epoch_min(db_belib, table, fenetre_bdd.epoch_debut);
+
+    // Somme de contrôle : lignes de la bdd couvertes par l'etat inchangées
+    if (ok) {
+        sqlite3_int64 somme_controle[3];
+        Get_somme_controle(db_belib, table, fenetre_bdd.epoch_debut,\
+                            entete->watermark, somme_controle);
+        for (int i = 0; i < 3; i++)
+            ok = ok && somme_controle[i] == entete->somme_controle[i];
+    }
+
+    if (!ok) {
+        printf("Info : fichier d'etat %s incompatible, rechargement complet.\n",\
+                    fichier_etat);
+        munmap(map, taille_map);
+        return -1;
+    }
+
+    Init_stations_data(data, nb_statuts);
+    data->nb_stations = entete->nb_stations;
+    data->nb_rows_par_station = entete->nb_rows;
+    data->epoch_debut = entete->epoch_debut;
+    data->watermark = entete->watermark;
+    data->fenetre = fenetre_bdd;
+
+    data->tableau_ids = calloc(entete->nb_stations+1, sizeof(int));
+    data->tableau_adresses = calloc(entete->nb_stations+1, sizeof(char *));
+    data->tableau_labels = calloc(entete->nb_stations+1, sizeof(char *));
+    data->tableau_date_recolte = realloc(data->tableau_date_recolte,\
+                                    (entete->cap_rows+1)*sizeof(Date));
+
+    if (data->tableau_ids == NULL || data->tableau_adresses == NULL \
+            || data->tableau_labels == NULL || data->tableau_date_recolte == NULL) {
+        printf("Erreur : Pas assez de memoire.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Stations (copiées : elles sont libérées comme celles lues dans la bdd)
+    const char *pos = map + sizeof(EnteteEtat);
+    const char *fin = map + entete->offset_cube;
+
+    for (int st = 0; ok && st < entete->nb_stations; st++) {
+        int32_t id, len_adresse, len_label;
+
+        ok = pos + 2*sizeof(int32_t) <= fin;
+        if (!ok) break;
+        memcpy(&id, pos, sizeof(id));
+        memcpy(&len_adresse, pos + sizeof(id), sizeof(len_adresse));
+        pos += 2*sizeof(int32_t);
+
+        ok = len_adresse >= 0 && pos + len_adresse + sizeof(int32_t) <= fin;
+        if (!ok) break;
+        data->tableau_ids[st] = id;
+        data->tableau_adresses[st] = strndup(pos, len_adresse);
+        pos += len_adresse;
+
+        memcpy(&len_label, pos, sizeof(len_label));
+        pos += sizeof(len_label);
+        ok = len_label >= 0 && pos + len_label <= fin;
+        if (!ok) break;
+        data->tableau_labels[st] = strndup(pos, len_label);
+        pos += len_label;
+    }
+
+    if (!ok) {
+        printf("Info : fichier d'etat %s corrompu, rechargement complet.\n",\
+                    fichier_etat);
+        munmap(map, taille_map);
+        Free_stations_data(data);
+        return -1;
+    }
+
+    // Cube des statuts : directement dans le fichier mappé
+    Free_cube(&(data->statuts));
+    Init_cube_map(&(data->statuts), map, taille_map, entete->offset_cube,\
+                    nb_statuts, entete->nb_stations, entete->nb_rows, entete->cap_rows);
+
+    // Dates de récolte reconstruites depuis la colonne des epoch
+    Init_Dates_epoch(entete->nb_rows, data->tableau_date_recolte, data->statuts.epoch);
+
+    return 0;
+}
+
+#endif  /* ETAT_H */
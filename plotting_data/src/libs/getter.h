@@ -12,6 +12,7 @@
 #include <string.h>
 #include <sqlite3.h>
 #include "traitement.h"
+#include "cube.h"
 
 /* --------------------------------------------------------------------------- */
 /**
@@ -21,6 +22,154 @@
 typedef enum {disponible, occupe, en_maintenance, inconnu} statuts;
 
 
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Fenetre temporelle des donnees chargées : derniers jours de récolte et
+ * pas minimal entre deux dates de récolte. Appliquée directement dans la 
+ * requete SQL (bornes sur la colonne indexée epoch).
+ * 
+ */
+typedef struct Fenetre_s {
+    int nb_jours;               /**< Nombre de derniers jours chargés (0 : tout l'historique) */
+    int resolution;             /**< Pas minimal entre deux récoltes en minutes (0 : toutes) */
+    sqlite3_int64 epoch_debut;  /**< Borne basse de la fenetre en epoch (-1 : aucune) */
+} Fenetre;
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Structure regroupant les donnees d'une table de stations (Fav ou Live)
+ * récupérées par Get_stations_data, puis complétées par Update_stations_data.
+ * 
+ */
+typedef struct StationsData_s {
+    int nb_stations;            /**< Nombre de stations (adresses uniques) */
+    int nb_rows_par_station;    /**< Nombre de dates de récolte distinctes */
+    int nb_statuts;             /**< Nombre de statuts récupérés */
+    int *tableau_ids;           /**< ID des stations dans la table Station */
+    char **tableau_adresses;    /**< Adresses des stations (ordre d'arrivée) */
+    char **tableau_labels;      /**< Labels des stations (adresse sans " Paris") */
+    Date *tableau_date_recolte; /**< Dates de récolte, triées */
+    StatusCube statuts;         /**< Cube des statuts (statut x station x date) */
+    sqlite3_int64 epoch_debut;  /**< epoch de la 1ere date de récolte */
+    sqlite3_int64 watermark;    /**< epoch de la derniere date de récolte chargée */
+    Fenetre fenetre;            /**< Fenetre temporelle des donnees chargées */
+} StationsData;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Enumeration des requetes SQL de la bibliotheque. Chaque requete est 
+ * préparée une seule fois par connexion et par table (voir Get_stmt).
+ * 
+ */
+typedef enum {req_stations, req_stations_data, req_epoch_min, req_epoch_max,\
+              req_somme_controle, req_nb_avg_hours, req_avg_hours,\
+              req_avg_dispo_station, req_positions, req_version_bdd,\
+              nb_requetes} requetes;
+
+/**
+ * @brief Requetes SQL associées à l'enum requetes. Le nom de table (%s) ne peut
+ * pas etre lié comme paramètre : il est inséré à la préparation, après 
+ * vérification dans la liste des tables autorisées. Les moyennes horaires sont
+ * lues dans l'agregat %s_hourly (migration 3). Les autres paramètres 
+ * (adresse, bornes de la fenetre, ...) sont liés via sqlite3_bind_*.
+ * Pour req_stations_data : ?1 watermark, ?2 début de la fenetre, ?3 résolution
+ * en secondes (seule la 1ere récolte de chaque tranche de ?3 secondes est 
+ * gardée, tranches alignées sur l'epoch 0 donc indépendantes du watermark). 
+ * Le modulo est écrit %% car la requete passe par snprintf).
+ * req_version_bdd ne dépend pas de la table (PRAGMA de la connexion).
+ * 
+ */
+const char *sql_requetes[nb_requetes] = {\
+    "SELECT ID, adresse_station, label FROM Station "\
+        "WHERE ID IN (SELECT DISTINCT station_id FROM %s) ORDER BY ID;",
+    "SELECT station_id, date_recolte, epoch, disponible, occupe, en_maintenance, inconnu "\
+        "FROM %s AS d WHERE epoch > ?1 AND epoch >= ?2 "\
+        "AND (?3 <= 0 OR NOT EXISTS (SELECT 1 FROM %s AS p "\
+            "WHERE p.epoch >= MAX(?2, d.epoch - d.epoch %% ?3) AND p.epoch < d.epoch)) "\
+        "ORDER BY epoch, station_id;",
+    "SELECT MIN(epoch) FROM %s WHERE epoch >= ?1;",
+    "SELECT MAX(epoch) FROM %s;",
+    "SELECT COUNT(*), SUM(epoch), "\
+        "SUM((((epoch %% 2147483647) * 7919 + station_id) %% 2147483647) "\
+            "* ((disponible + 101*occupe + 10201*en_maintenance + 1030301*inconnu) "\
+                "%% 2147483647) %% 2147483647) "\
+        "FROM %s WHERE epoch >= ?1 AND epoch <= ?2;",
+    "SELECT COUNT(DISTINCT hour) FROM %s_hourly;",
+    "SELECT hour FROM %s_hourly GROUP BY hour;",
+    "SELECT hour, CAST(somme_dispo AS REAL) / nb as Avg_dispo FROM %s_hourly "\
+        "WHERE station_id = ?1 ORDER BY hour;",
+    "SELECT ID, lon, lat FROM Station "\
+        "WHERE ID IN (SELECT DISTINCT station_id FROM %s) ORDER BY ID;",
+    "PRAGMA data_version;"};
+
+/**
+ * @brief Version du schema de la bdd attendue (PRAGMA user_version), voir 
+ * db_sqlite/migrate_db_belib.sh. Les requetes utilisent les colonnes epoch et 
+ * hour (migration 1), la table de dimension Station (migration 2) et 
+ * l'agregat horaire Stations_fav_hourly (migration 3).
+ * 
+ */
+#define VERSION_BDD 3
+
+/**
+ * @brief Tables de la bdd pouvant etre utilisées dans les requetes
+ * 
+ */
+#define NB_TABLES_REQ 2
+const char *tables_req[NB_TABLES_REQ] = {"Stations_fav", "Stations_live"};
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Registre des statements préparés pour une connexion à la bdd
+ * 
+ */
+typedef struct RegistreStmt_s {
+    sqlite3 *db;                                        /**< Connexion associée */
+    sqlite3_stmt *stmt[NB_TABLES_REQ][nb_requetes];     /**< Statements préparés */
+} RegistreStmt;
+
+RegistreStmt registre_stmt = {NULL, {{NULL}}};
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Profil des pragmas appliqués à l'ouverture de la bdd (lecture seule)
+ * 
+ */
+typedef struct ProfilPragmas_s {
+    sqlite3_int64 mmap_size;    /**< PRAGMA mmap_size en octets (0 : pas de mmap) */
+    int cache_size;             /**< PRAGMA cache_size (< 0 : en Kio) */
+    const char *temp_store;     /**< PRAGMA temp_store (MEMORY, FILE ou DEFAULT) */
+} ProfilPragmas;
+
+/**
+ * @brief Profil carte embarquée (carte SD, peu de RAM) : mmap et cache 
+ * modérés, pour limiter les lectures sur la carte sans saturer la mémoire
+ * 
+ */
+const ProfilPragmas profil_carte_sd = {32LL << 20, -4096, "MEMORY"};
+
+/**
+ * @brief Profil poste de travail (SSD) : toute la bdd en mmap
+ * 
+ */
+const ProfilPragmas profil_ssd = {256LL << 20, -16384, "MEMORY"};
+
+/**
+ * @brief Profil utilisé par Sqlite_open_check, choisi comme le reste de la 
+ * configuration (QEMU : carte embarquée). Peut etre forcé en définissant 
+ * PROFIL_BDD avant l'inclusion de getter.h.
+ * 
+ */
+#ifndef PROFIL_BDD
+    #if defined(QEMU)
+        #define PROFIL_BDD profil_carte_sd
+    #else
+        #define PROFIL_BDD profil_ssd
+    #endif
+#endif
+
+
 /* --------------------------------------------------------------------------- */
 /**
  * @brief Liberation de la memoire allouée pour un tableau de strings
@@ -34,165 +183,215 @@ void free_tab_char1(char **tableau_str, int len_tab);
 
 /* --------------------------------------------------------------------------- */
 /**
- * @brief Fonction ouvrant la bdd et vérifiant si tout se passe bien à 
- * l'ouverture (notamment l'existence du fichier)
+ * @brief Fonction ouvrant la bdd en lecture seule et vérifiant si tout se passe
+ * bien à l'ouverture (notamment l'existence du fichier et la version du 
+ * schema), puis appliquant le profil de pragmas PROFIL_BDD. La bdd est en mode
+ * WAL (create_db_belib.sh, migrate_db_belib.sh) : la lecture des figures ne 
+ * bloque pas l'écriture par les scripts de récupération, et inversement.
  * 
  * @param bdd_filename Chemin vers la base de données 
  * @param db_belib Pointeur de pointeur type sqlite3 vers la bdd
  */
 void Sqlite_open_check(char *bdd_filename, sqlite3 **db_belib);
 
-
-
 /* --------------------------------------------------------------------------- */
 /**
- * @brief Recupere le nombre de lignes de données par station. Cette fonction 
- * compte le nombre de date_recolte distinctes. 
+ * @brief Applique un profil de pragmas (mmap_size, cache_size, temp_store) à 
+ * une connexion
  * 
  * @param db_belib Pointeur type sqlite3 vers la base de donnée
- * @note La bdd est construite de maniere a ce que l'on ait le meme nombre de 
- * date de récolte pour chaque station, et donc le meme nombre de lignes de 
- * données.
- * @return int Nombre de lignes de données par station
+ * @param profil Profil de pragmas à appliquer
  */
+void Sqlite_pragmas(sqlite3 *db_belib, const ProfilPragmas *profil);
 
+/* --------------------------------------------------------------------------- */
 /**
- * @brief Recupere le nombre de lignes de données par station. Cette fonction 
- * compte le nombre de date_recolte distinctes. 
+ * @brief Fermeture de la bdd : finalisation des statements du registre puis 
+ * fermeture de la connexion
  * 
  * @param db_belib Pointeur type sqlite3 vers la base de donnée
- * @note La bdd est construite de maniere a ce que l'on ait le meme nombre de 
- * date de récolte pour chaque station, et donc le meme nombre de lignes de 
- * données.
- * @param table Nom de la table dans la bdd
- * @return int int Nombre de lignes de données par station
  */
-int Get_nb_rows_par_station(sqlite3 *db_belib, char *table);
+void Sqlite_close(sqlite3 *db_belib);
 
 /* --------------------------------------------------------------------------- */
-
-
 /**
- * @brief Recupere les adresses uniques dans la table spécifiée
+ * @brief Renvoie le statement préparé associé à une requete et une table. La 
+ * requete est préparée au premier appel, puis simplement remise à zéro (reset 
+ * et suppression des paramètres liés) aux appels suivants.
  * 
  * @param db_belib Pointeur type sqlite3 vers la base de donnée
- * @param table Nom de la table dans la bdd
- * @param tableau_adresses Tableau des adresses uniques
- * @param nb_stations Nombre de stations associées
+ * @param requete Index de la requete dans l'enum requetes
+ * @param table Nom de la table dans la bdd (doit appartenir à tables_req)
+ * @return sqlite3_stmt* Statement pret à etre lié puis exécuté
  */
-void Get_adresses(sqlite3 *db_belib, char *table, char **tableau_adresses, int nb_stations);
-
+sqlite3_stmt *Get_stmt(sqlite3 *db_belib, int requete, char *table);
 
 /* --------------------------------------------------------------------------- */
+/**
+ * @brief Finalise l'ensemble des statements du registre
+ * 
+ */
+void Finalize_stmts(void);
 
+/* --------------------------------------------------------------------------- */
 /**
- * @brief Récupère les dates de récolte pour l'ensemble des stations de la table spécifiée
+ * @brief Remet à zéro les statements du registre. Un statement resté sur une
+ * ligne garde la transaction de lecture ouverte : un process résident doit 
+ * l'appeler après ses lectures pour voir les récoltes suivantes (et ne pas 
+ * bloquer les écritures hors mode WAL).
  * 
- * @param db_belib Pointeur type sqlite3 vers la base de donnée
- * @param table Nom de la table dans la bdd
- * @param tableau_date_recolte Tablea des dates de récolte
- * @param nb_rows_par_station Nombre de lignes de date par station
  */
-void Get_date_recolte(sqlite3 *db_belib, char *table, Date *tableau_date_recolte, int nb_rows_par_station);
+void Reset_stmts(void);
 
 
 /* --------------------------------------------------------------------------- */
+/**
+ * @brief Initialise un objet StationsData vide (aucune station, aucune date)
+ * 
+ * @param data Pointeur vers un objet de type StationsData
+ * @param nb_statuts Nombre de statuts récupérés (colonnes disponible a inconnu)
+ * @warning Malloc fait, desallocation via Free_stations_data
+ */
+void Init_stations_data(StationsData *data, int nb_statuts);
 
+/* --------------------------------------------------------------------------- */
 /**
- * @brief Construit le tableau contenant l'ensemble des informations qui concernent les stations Belib
+ * @brief Complète un objet StationsData avec les lignes de la table plus 
+ * récentes que son watermark (epoch > watermark) et comprises dans sa fenetre
+ * temporelle, en une seule requete. 
+ * Les nouvelles dates de récolte sont ajoutées en fin de tableau, les 
+ * nouvelles stations en fin de liste, et leurs statuts rangés directement dans
+ * le cube via un tableau indexé par ID de station.
  * 
  * @param db_belib Pointeur type sqlite3 vers la base de donnée
  * @param table Nom de la table dans la bdd (Fav ou Live)
- * @param tableau_adresses Tableau des adresses uniques
- * @param nb_stations Nombre de stations
- * @param nb_rows_par_station Nombre de date de recolte par station (data par station)
- * @param nb_statuts Nombre de statuts récupérés.
- * @warning Enum "statuts devant etre mis à jour si on veut plus de statuts"
- * @param tableau_statuts Tableau contenant l'ensemble des informations souhaitées, de dim : nb_station x nb_rows_par_station x nb_statuts
+ * @param data Pointeur vers un objet de type StationsData (vide ou déjà chargé)
+ * @return int Nombre de lignes ajoutées
+ * @note Les lignes sont lues par date puis par ID : les stations sont donc 
+ * rangées par date de première récolte puis par ID (ordre d'arrivée). Les 
+ * stations arrivées en cours de récolte sont complétées par des 0 avant leur 
+ * première date de récolte.
  */
-void Get_statuts_station(sqlite3 *db_belib, char *table, char **tableau_adresses, int nb_stations,int nb_rows_par_station, int nb_statuts, int tableau_statuts[nb_stations][nb_rows_par_station][nb_statuts]);
-
+int Update_stations_data(sqlite3 *db_belib, char *table, StationsData *data);
 
 /* --------------------------------------------------------------------------- */
 /**
- * @brief Fonction renvoyant la requete sql permettant de récupérer les nombres 
- * de bornes au statut disponible, occupe, en_maintenance ou inconnu pour une 
- * station donnée, en se basant sur l'unicité de son adresse.
+ * @brief Charge l'ensemble des donnees d'une table de stations : stations 
+ * (ID, adresse, label), dates de récolte et cube des statuts 
+ * (Init_stations_data puis Update_stations_data sur toute la table).
  * 
- * @param table Nom de la table
- * @param station Index de la station favorite dans le tableau des adresses des 
- * stations 
- * @param tableau_adresses Tableau des adresses des stations
- * @return char* Requete SQLite
+ * @param db_belib Pointeur type sqlite3 vers la base de donnée
+ * @param table Nom de la table dans la bdd (Fav ou Live)
+ * @param nb_statuts Nombre de statuts récupérés (colonnes disponible a inconnu)
+ * @param fenetre Fenetre temporelle (nb_jours, resolution), NULL pour tout 
+ * l'historique. Sa borne basse epoch_debut est calculée par la fonction.
+ * @param data Pointeur vers un objet de type StationsData rempli par la fonction
+ * @warning Malloc fait, desallocation via Free_stations_data
  */
-char *Construct_req_station_statuts(char* table, int station, char **tableau_adresses);
+void Get_stations_data(sqlite3 *db_belib, char *table, int nb_statuts,\
+                        Fenetre *fenetre, StationsData *data);
 
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Recupere la plus petite epoch (1ere date de récolte) d'une table, 
+ * à partir d'une borne basse
+ * 
+ * @param db_belib Pointeur type sqlite3 vers la base de donnée
+ * @param table Nom de la table dans la bdd
+ * @param epoch_borne Borne basse (-1 : toute la table)
+ * @return sqlite3_int64 epoch min, -1 si aucune ligne
+ */
+sqlite3_int64 Get_epoch_min(sqlite3 *db_belib, char *table, sqlite3_int64 epoch_borne);
 
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Recupere la plus grande epoch (derniere date de récolte) d'une table
+ * 
+ * @param db_belib Pointeur type sqlite3 vers la base de donnée
+ * @param table Nom de la table dans la bdd
+ * @return sqlite3_int64 epoch max, -1 si la table est vide
+ */
+sqlite3_int64 Get_epoch_max(sqlite3 *db_belib, char *table);
 
 /* --------------------------------------------------------------------------- */
 /**
- * @brief Fonction renvoyant la requete sql permettant de récupérer la moyenne 
- * horaire des bornes disponibles pour une station donnée, en se basant sur 
- * l'unicité de son adresse.
+ * @brief Recupere la version des données de la bdd vue par la connexion 
+ * (PRAGMA data_version) : elle change à chaque transaction validée par une 
+ * autre connexion, y compris une table vidée puis remplie à la même date de
+ * récolte (epoch max inchangé).
  * 
- * @param station Index de la station favorite dans le tableau des adresses des 
- * stations favorites
- * @param tableau_adresses_fav Tableau des adresses des stations favorites
- * @warning Utilisé que pour la table Fav
- * @return char* Requete SQLite
+ * @param db_belib Pointeur type sqlite3 vers la base de donnée
+ * @param table Nom de la table (registre des statements seulement)
+ * @return sqlite3_int64 Version des données, -1 si échec
  */
-char *Construct_req_station_avg_dispo(int station, char **tableau_adresses_fav);
-           
+sqlite3_int64 Get_version_bdd(sqlite3 *db_belib, char *table);
 
 /* --------------------------------------------------------------------------- */
 /**
- * @brief Construction d'un vecteur 1D contenant le nombre de bornes ayant un 
- * statut spécifié, pour une station donnée
+ * @brief Somme de contrôle des lignes d'une table entre deux epoch : nombre de 
+ * lignes, somme des epoch et somme des statuts pondérés par leur position 
+ * (statut, station, epoch ; chaque terme réduit modulo 2^31-1 pour rester 
+ * dans un int64). Permet de vérifier qu'une copie des données (fichier 
+ * d'etat) correspond toujours à la bdd, y compris si des statuts ont été 
+ * réécrits à un epoch déjà présent.
  * 
- * @param nb_stations Nombre de stations favorites
- * @param nb_rows Nombre de lignes de données pour chaque station
- * @param nb_statuts Nombre de statuts récupérés
- * @param vect_statut Vecteur qui contiendra le nombre de bornes ayant un statut 
- * particulier pour une station donnée
- * @param tableau_statuts_fav Tableau contenant l'ensemble des données récupérées
- *  de la base de données
- * @param station Station prise en compte dans la construction du vecteur 
- * vect_statut
- * @param statut Les bornes ayant ce statut seront comptabilisées
- * @warning Fonction différente de Get_statuts_station. Permet de récupérer l'info sur une station dans le tableau complet rempli par Get_statuts_station. Peut porter à confusion
+ * @param db_belib Pointeur type sqlite3 vers la base de donnée
+ * @param table Nom de la table dans la bdd
+ * @param epoch_debut Borne basse (incluse)
+ * @param epoch_fin Borne haute (incluse)
+ * @param somme_controle Tableau rempli par la fonction : {nb lignes, somme 
+ * epoch, somme des statuts}
  */
-void Get_statut_station(int nb_stations, int nb_rows, int nb_statuts,int vect_statut[nb_rows],int tableau_statuts_fav[nb_stations][nb_rows][nb_statuts],int station, int statut);
+void Get_somme_controle(sqlite3 *db_belib, char *table, sqlite3_int64 epoch_debut,\
+                        sqlite3_int64 epoch_fin, sqlite3_int64 somme_controle[3]);
 
+/* --------------------------------------------------------------------------- */
 /**
- * @brief Recupere le nombre de date de récolte pour une station spécifique. Permet de gérer l'arrivée de nouvelles stations dans le périmètre en favori.
+ * @brief Calcule la borne basse d'une fenetre de nb_jours derniers jours : 
+ * minuit du jour de la derniere récolte, moins nb_jours-1 jours. La borne ne 
+ * change donc qu'une fois par jour.
  * 
  * @param db_belib Pointeur type sqlite3 vers la base de donnée
  * @param table Nom de la table dans la bdd
- * @param station Index de la station dont on veut récupérer l'information
- * @param tableau_adresses Tableau des adresses des stations (pour recuperer l'adresse a partir de l'index)
- * @return int 
+ * @param nb_jours Nombre de jours de la fenetre (jour courant compris)
+ * @return sqlite3_int64 Borne basse en epoch, -1 si nb_jours <= 0 ou table vide
  */
-int Get_nb_rows_par_station_unique(sqlite3 *db_belib, char* table,int station, char **tableau_adresses);
+sqlite3_int64 Get_debut_fenetre(sqlite3 *db_belib, char *table, int nb_jours);
 
+/* --------------------------------------------------------------------------- */
 /**
- * @brief Recupere le nombre de stations en se basant sur l'unicité de l'adresse
+ * @brief Recupere la position (lon, lat) des stations chargées dans data, 
+ * lue dans la table Station
  * 
  * @param db_belib Pointeur type sqlite3 vers la base de donnée
  * @param table Nom de la table dans la bdd
- * @return int Nombre de stations unique
+ * @param data Stations chargées (Get_stations_data)
+ * @param positions Tableau rempli par la fonction : {lon, lat} de chaque 
+ * station de data, dans l'ordre de data
+ */
+void Get_positions(sqlite3 *db_belib, char *table, StationsData *data,\
+                    double positions[][2]);
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Liberation de la memoire allouée par Get_stations_data
+ * 
+ * @param data Pointeur vers un objet de type StationsData
  */
-int Get_nb_stations(sqlite3 *db_belib, char* table);
+void Free_stations_data(StationsData *data);
 
+/* --------------------------------------------------------------------------- */
 /**
- * @brief Construit le tableau des moyennes horaires de diponibilité des bornes pour chaque station favorite
+ * @brief Construit le tableau des moyennes horaires de diponibilité des bornes pour chaque station favorite, lues dans l'agregat Stations_fav_hourly (au plus 24 lignes par station). Chaque moyenne est rangée dans la case de son heure dans tableau_avg_hours ; une heure sans donnée pour la station reste à 0.
  * 
  * @param db_belib Pointeur type sqlite3 vers la base de donnée
- * @param tableau_adresses_fav Tableau des adresses des stations favorites
+ * @param tableau_ids_fav Tableau des ID (table Station) des stations favorites
  * @param nb_stations_fav Nombre de stations favorites
  * @param nb_rows_hours Nombre de ligne de données par station
+ * @param tableau_avg_hours Tableau des heures (fonction Get_avg_hours)
  * @param tableau_avg_dispo_station Tableau des moyennes horaires de disponibilité pour chaque station favorite
  */
-void Get_avg_dispo_station(sqlite3 *db_belib,char **tableau_adresses_fav,int nb_stations_fav, int nb_rows_hours, float tableau_avg_dispo_station[nb_stations_fav][nb_rows_hours]);
+void Get_avg_dispo_station(sqlite3 *db_belib,int *tableau_ids_fav,int nb_stations_fav, int nb_rows_hours, int tableau_avg_hours[nb_rows_hours], float tableau_avg_dispo_station[nb_stations_fav][nb_rows_hours]);
 
 /**
  * @brief 
@@ -225,14 +424,11 @@ void Get_time_vect(int nb_rows, int vect_time[nb_rows], Date tableau_date_recolt
 /**
  * @brief Fonction de debug permettant d'afficher le contenu de la bdd
  * 
- * @param nb_station Nombre de stations
- * @param nb_date Nombre de date de recolte (rows)
- * @param nb_statuts Nombre de statuts
- * @param tab Tableau des statuts (complet) à afficher
+ * @param cube Cube des statuts (complet) à afficher
  * @param tableau_date_recolte Tableau des date de récolte
  * @param tableau_adresses Tableau contenant les adresses des stations
  */
-void Print_tableau_stations(int nb_station, int nb_date, int nb_statuts, int tab[nb_station][nb_date][nb_statuts],Date *tableau_date_recolte, char** tableau_adresses);
+void Print_tableau_stations(StatusCube *cube, Date *tableau_date_recolte, char** tableau_adresses);
 
 /**
  * @brief Fonction de debug permettant d'afficher le contenu d'un vecteur de float
@@ -261,62 +457,28 @@ void print_arr1D(int len_tab, int tab[len_tab], char col);
 void Get_time_vect(int nb_rows, int vect_time[nb_rows],\
                 Date tableau_date_recolte[nb_rows])
 {
+    // Ecart direct des epochs : pas besoin des labels du Datetick ici
+    time_t t0 = tableau_date_recolte[0].ctime;
     for (int i = 0; i < nb_rows; i++)
     {
-        Datetick tick_i;
-        Init_Datetick(&tick_i,\
-                &tableau_date_recolte[i], &tableau_date_recolte[0]);
-
-        vect_time[i] = tick_i.ecart_init;
+        vect_time[i] = (int)(tableau_date_recolte[i].ctime - t0);
     }  
 }
 
 
-/* --------------------------------------------------------------------------- */
-void Get_statut_station(int nb_stations, int nb_rows, int nb_statuts,\
-            int vect_statut[nb_rows], \
-            int tableau_statuts_fav[nb_stations][nb_rows][nb_statuts],
-            int station, int statut)
-{
-    for (int i = 0; i < nb_rows; i++) {
-        vect_statut[i] = tableau_statuts_fav[station][i][statut];
-    }
-}
-
 /* --------------------------------------------------------------------------- */
 int Get_nb_avg_hours(sqlite3 *db_belib)
 {
-        // Declaration statement
-    sqlite3_stmt *stmt;
+    // Recuperation du statement prepare
+    sqlite3_stmt *stmt = Get_stmt(db_belib, req_nb_avg_hours, "Stations_fav");
 
     int nb_avg_hours = 0;
 
-    char *query_nb_avg_hours = \
-            "SELECT COUNT(DISTINCT(strftime(\'%H\', date_recolte))) as Hour FROM Stations_fav;";
-
-    // Test de la requete
-    if (sqlite3_prepare_v2(db_belib, query_nb_avg_hours,-1, &stmt, NULL))
-    {
-        printf("Erreur SQL :\n");
-        printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                         sqlite3_errmsg(db_belib));
-        sqlite3_close(db_belib);
-        exit(EXIT_FAILURE);
-    }
-
-    // Application du statement et fermeture de la db
-    int step = sqlite3_step(stmt);
-
-    // int nb_col = sqlite3_column_count(stmt);
-
-    if (step == SQLITE_ROW) 
+    // Application du statement
+    if (sqlite3_step(stmt) == SQLITE_ROW) 
     {
         nb_avg_hours = sqlite3_column_int(stmt, 0);
     }
-    // printf("Nb station favs : %d \n",sqlite3_column_int(stmt, 0));
-
-    // Reset du stmt
-    sqlite3_finalize(stmt);
 
     return nb_avg_hours;
 }
@@ -325,459 +487,508 @@ int Get_nb_avg_hours(sqlite3 *db_belib)
 void Get_avg_hours(sqlite3 *db_belib, int nb_rows_hours,\
                         int tableau_avg_hours[nb_rows_hours])
 {
-    // Declaration statement
-    sqlite3_stmt *stmt;
+    // Recuperation du statement prepare
+    sqlite3_stmt *stmt = Get_stmt(db_belib, req_avg_hours, "Stations_fav");
 
-    char *query_avg_hours = \
-        "SELECT (strftime(\'%H\', date_recolte)) as Hour FROM Stations_fav GROUP BY (strftime(\'%H\', date_recolte));";
-
-    // Test de la requete
-    if (sqlite3_prepare_v2(db_belib, query_avg_hours, -1, &stmt, NULL))
-    {
-        printf("Erreur SQL :\n");
-        printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                         sqlite3_errmsg(db_belib));
-        sqlite3_close(db_belib);
-        exit(EXIT_FAILURE);
-    }
-
-    // Application du statement et fermeture de la db
+    // Application du statement
     for (int i = 0; i < nb_rows_hours; i++) {
         int step = sqlite3_step(stmt);
         if (step == SQLITE_ROW) 
         {
-            tableau_avg_hours[i] = (int) strtol( (char *)sqlite3_column_text(stmt, 0), NULL, 10);
+            tableau_avg_hours[i] = sqlite3_column_int(stmt, 0);
         }
         // ELIF STOP
     }
-
-    // Reset du stmt
-    sqlite3_finalize(stmt);    
 }
 
 /* --------------------------------------------------------------------------- */
-char *Construct_req_station_statuts(char* table, int station, char **tableau_adresses)
+void Get_avg_dispo_station(sqlite3 *db_belib,\
+                        int *tableau_ids_fav,\
+                        int nb_stations_fav, int nb_rows_hours, \
+                        int tableau_avg_hours[nb_rows_hours], \
+                        float tableau_avg_dispo_station[nb_stations_fav][nb_rows_hours])
 {
-    char query_statuts_stations[250] = \
-            "SELECT disponible, occupe, en_maintenance, inconnu FROM ";
-
-    strcat(query_statuts_stations, table);
-    strcat(query_statuts_stations, " WHERE adresse_station = ");  
+    // Case de chaque heure de la journée dans tableau_avg_hours (-1 : absente)
+    int case_heure[24];
+    for (int heure = 0; heure < 24; heure++)
+        case_heure[heure] = -1;
+    for (int h = 0; h < nb_rows_hours; h++)
+        if (tableau_avg_hours[h] >= 0 && tableau_avg_hours[h] < 24)
+            case_heure[tableau_avg_hours[h]] = h;
 
-    int len_query_base = strlen(query_statuts_stations);
-    int len_max_adresse = 200;
-    int len_query_station = len_query_base + len_max_adresse;
+    for (int station = 0; station < nb_stations_fav; station++)
+    {
+        // Statement prepare une seule fois, seul l'ID de station lie change
+        sqlite3_stmt *stmt_station = \
+                Get_stmt(db_belib, req_avg_dispo_station, "Stations_fav");
+        sqlite3_bind_int(stmt_station, 1, tableau_ids_fav[station]);
 
-    char *req = malloc(len_query_station*sizeof(char));
+        // Initialisation du tableau : utile lorsque de nouvelles stations pop
+        for (int h = 0; h < nb_rows_hours; h++) {
+            tableau_avg_dispo_station[station][h] = 0.;
+        }
 
-    strcpy(req, query_statuts_stations);
-    strcat(req, "\"");
-    strcat(req, tableau_adresses[station]);
-    strcat(req, "\";");
+        // Application du statement : chaque moyenne va dans la case de son
+        // heure (une heure sans ligne pour la station ne décale pas les suivantes)
+        while (sqlite3_step(stmt_station) == SQLITE_ROW) {
+            int heure = sqlite3_column_int(stmt_station, 0);
+            if (heure < 0 || heure >= 24 || case_heure[heure] < 0) continue;
 
-    return req;
+            tableau_avg_dispo_station[station][case_heure[heure]] = \
+                    (float)sqlite3_column_double(stmt_station, 1);
+        }
+    }
 }
 
-
 /* --------------------------------------------------------------------------- */
-char *Construct_req_station_avg_dispo(int station, char **tableau_adresses_fav)
+void Init_stations_data(StationsData *data, int nb_statuts)
 {
-    char *query_statuts_stations_avg_dispo = \
-            "SELECT AVG(disponible) as Avg_dispo FROM Stations_fav WHERE adresse_station = "; 
-
-
-    int len_query_base = strlen(query_statuts_stations_avg_dispo);
-    int len_max_adresse = 200; // comprend le reste de la req plus bas
-    int len_query_station = len_query_base + len_max_adresse;
-
-    char *req = malloc(len_query_station*sizeof(char));
-
-    strcpy(req, query_statuts_stations_avg_dispo);
-    strcat(req, "\'");
-    strcat(req, tableau_adresses_fav[station]);
-    strcat(req, "\' ");
-    strcat(req, "GROUP BY strftime(\'%H\', date_recolte);");
-
-    return req;
+    data->nb_stations = 0;
+    data->nb_rows_par_station = 0;
+    data->nb_statuts = nb_statuts;
+    data->tableau_ids = NULL;
+    data->tableau_adresses = NULL;
+    data->tableau_labels = NULL;
+    data->tableau_date_recolte = malloc(sizeof(Date));
+    data->epoch_debut = -1;
+    data->watermark = -1;
+    data->fenetre.nb_jours = 0;
+    data->fenetre.resolution = 0;
+    data->fenetre.epoch_debut = -1;
+
+    Init_cube(&(data->statuts), nb_statuts, 0, 0, 1);
 }
 
-
 /* --------------------------------------------------------------------------- */
-void Get_avg_dispo_station(sqlite3 *db_belib,\
-                        char **tableau_adresses_fav,\
-                        int nb_stations_fav, int nb_rows_hours, \
-                        float tableau_avg_dispo_station[nb_stations_fav][nb_rows_hours])
+int Update_stations_data(sqlite3 *db_belib, char *table, StationsData *data)
 {
-    for (int station = 0; station < nb_stations_fav; station++)
-    {
-        // Declaration statement
-        sqlite3_stmt *stmt_station;
+    int nb_statuts = data->nb_statuts;
+    int nb_anciennes = data->nb_stations;
 
-        // Construction requete
-        char *req_sql = Construct_req_station_avg_dispo(station, tableau_adresses_fav);
-        // printf("Req : %s \n", req_sql);
+    // Stations de la table, triées par ID : celles absentes de data sont 
+    // candidates (ajoutées si elles ont des lignes apres le watermark)
+    sqlite3_stmt *stmt = Get_stmt(db_belib, req_stations, table);
 
-        // Test de la requete
-        if (sqlite3_prepare_v2(db_belib, req_sql, -1, &stmt_station, NULL))
-        {
-            printf("Erreur SQL :\n");
-            printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                            sqlite3_errmsg(db_belib));
-            sqlite3_close(db_belib);
-            exit(EXIT_FAILURE);
-        }
+    int cap_cand = 8, nb_cand = 0;
+    int *cand_ids = malloc(cap_cand*sizeof(int));
+    char **cand_adresses = malloc(cap_cand*sizeof(char *));
+    char **cand_labels = malloc(cap_cand*sizeof(char *));
+    int id_max = 0;
 
-        // Initialisation du tableau : utile lorsque de nouvelles stations pop
-        for (int h = 0; h < nb_rows_hours; h++) {
-            tableau_avg_dispo_station[station][h] = 0.;
+    for (int st = 0; st < nb_anciennes; st++)
+        if (data->tableau_ids[st] > id_max) id_max = data->tableau_ids[st];
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        if (nb_cand == cap_cand) {
+            cap_cand *= 2;
+            cand_ids = realloc(cand_ids, cap_cand*sizeof(int));
+            cand_adresses = realloc(cand_adresses, cap_cand*sizeof(char *));
+            cand_labels = realloc(cand_labels, cap_cand*sizeof(char *));
         }
 
-        // Application du statement : on recupere les statuts
-        for (int h = 0; h < nb_rows_hours; h++) {
-            int step = sqlite3_step(stmt_station);
-            if (step == SQLITE_ROW) {
-                // printf("SQL Avg dispo Station %d à %02d:00 : %.1f \n", station,+1 h, (float)sqlite3_column_double(stmt_station, 0));
-                tableau_avg_dispo_station[station][h] = \
-                        (float)sqlite3_column_double(stmt_station, 0);
-            }
+        if (cand_ids == NULL || cand_adresses == NULL || cand_labels == NULL) {
+            printf("Erreur : Pas assez de memoire.\n");
+            exit(EXIT_FAILURE);
         }
 
-        // Reset du stmt
-        sqlite3_finalize(stmt_station);
+        const char *adresse = (const char *)sqlite3_column_text(stmt, 1);
+        const char *label = (const char *)sqlite3_column_text(stmt, 2);
 
-        free(req_sql);
+        cand_ids[nb_cand] = sqlite3_column_int(stmt, 0);
+        cand_adresses[nb_cand] = strdup(adresse);
+        cand_labels[nb_cand] = strdup(label ? label : adresse);
+        if (cand_ids[nb_cand] > id_max) id_max = cand_ids[nb_cand];
+        nb_cand++;
     }
-}
 
-/* --------------------------------------------------------------------------- */
-void Get_statuts_station(sqlite3 *db_belib, char *table,\
-    char **tableau_adresses, int nb_stations, \
-    int nb_rows_par_station, int nb_statuts, \
-    int tableau_statuts[nb_stations][nb_rows_par_station][nb_statuts])
-{
-    
-    for (int station = 0; station < nb_stations; station++)
-    {
+    // Tableau indexé par ID de station : ID -> index de la station dans data, 
+    // -1 pour une candidate pas encore ajoutée
+    int *index_id = malloc((id_max+1)*sizeof(int));
+    int *cand_id = malloc((id_max+1)*sizeof(int));
 
-        int nb_date_station = \
-                        Get_nb_rows_par_station_unique(db_belib, table, \
-                            station, tableau_adresses);
+    if (index_id == NULL || cand_id == NULL) {
+        printf("Erreur : Pas assez de memoire.\n");
+        exit(EXIT_FAILURE);
+    }
 
-        // Declaration statement
-        sqlite3_stmt *stmt_station;
+    for (int id = 0; id <= id_max; id++) {
+        index_id[id] = -1;
+        cand_id[id] = -1;
+    }
+    for (int c = 0; c < nb_cand; c++)
+        cand_id[cand_ids[c]] = c;
+    for (int st = 0; st < nb_anciennes; st++)
+        index_id[data->tableau_ids[st]] = st;
 
-        // Construction requete
-        char *req_sql = Construct_req_station_statuts(table, station, tableau_adresses);
+    // Application du statement : une seule passe sur les nouvelles lignes
+    stmt = Get_stmt(db_belib, req_stations_data, table);
+    sqlite3_bind_int64(stmt, 1, data->watermark);
+    sqlite3_bind_int64(stmt, 2, data->fenetre.epoch_debut);
+    sqlite3_bind_int64(stmt, 3, (sqlite3_int64)data->fenetre.resolution*60);
 
-        // Test de la requete
-        if (sqlite3_prepare_v2(db_belib, req_sql, -1, &stmt_station, NULL))
-        {
-            printf("Erreur SQL :\n");
-            printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                            sqlite3_errmsg(db_belib));
-            sqlite3_close(db_belib);
-            exit(EXIT_FAILURE);
-        }
+    StatusCube *cube = &(data->statuts);
+    int nb_lignes = 0;
 
-        
-        if (nb_date_station == nb_rows_par_station) {
-            // Initialisation
-            for (int t = 0; t < nb_rows_par_station; t++) {
-                for (int statut = disponible; statut <= inconnu; statut++) {
-                        tableau_statuts[station][t][statut] = 0;
-                }
-            }
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int id = sqlite3_column_int(stmt, 0);
+        sqlite3_int64 epoch = sqlite3_column_int64(stmt, 2);
 
-            // Application du statement : on recupere les statuts
-            for (int t = 0; t < nb_rows_par_station; t++) {
-                int step = sqlite3_step(stmt_station);
-                if (step == SQLITE_ROW) 
-                {
-                    for (int statut = disponible; statut <= inconnu; statut++) {
-                        tableau_statuts[station][t][statut] = \
-                        sqlite3_column_int(stmt_station, statut);
-                    }
-                }
+        // Nouvelle date de récolte : ajout en fin de tableau
+        if (data->nb_rows_par_station == 0 || epoch != data->watermark) {
+            if ((size_t)data->nb_rows_par_station == cube->cap_rows) {
+                Cube_reserve(cube, cube->nb_stations, 2*cube->cap_rows);
             }
-        } else {
-            // Gestion des nouvelles stations qui pop
-            printf("nb recolte       : %d \n", nb_date_station);
-            printf("nb total recolte : %d \n", nb_rows_par_station);
-            // Initialisation a 0 avant le debut de recolte
-            for (int t = 0; t < nb_rows_par_station-nb_date_station; t++) {
-                for (int statut = disponible; statut <= inconnu; statut++) {
-                        tableau_statuts[station][t][statut] = 0;
-                }
+            data->tableau_date_recolte = realloc(data->tableau_date_recolte,\
+                                            cube->cap_rows*sizeof(Date));
+            if (data->tableau_date_recolte == NULL) {
+                printf("Erreur : Pas assez de memoire.\n");
+                exit(EXIT_FAILURE);
             }
 
-            // On remplit avec ce qui est disponible dans la db
-            for (int t = 0; t < nb_date_station; t++) {
-                int step = sqlite3_step(stmt_station);
-                if (step == SQLITE_ROW) 
-                {
-                    for (int statut = disponible; statut <= inconnu; statut++) {
-                        tableau_statuts[station][nb_rows_par_station-nb_date_station+t][statut] = \
-                        sqlite3_column_int(stmt_station, statut);
-                    }
-                }
+            char date_i[20];
+            strncpy(date_i, (const char *)sqlite3_column_text(stmt, 1), 19);
+            date_i[19] = '\0';
+            Init_Date(&(data->tableau_date_recolte[data->nb_rows_par_station]), date_i);
+            cube->epoch[data->nb_rows_par_station] = epoch;
+
+            if (data->nb_rows_par_station == 0) data->epoch_debut = epoch;
+            data->watermark = epoch;
+            cube->nb_rows = ++data->nb_rows_par_station;
+        }
+
+        // Nouvelle station : ajout en fin de liste (ordre d'arrivée)
+        if (index_id[id] < 0) {
+            int c = cand_id[id];
+            int st = data->nb_stations++;
+
+            data->tableau_ids = realloc(data->tableau_ids, data->nb_stations*sizeof(int));
+            data->tableau_adresses = realloc(data->tableau_adresses,\
+                                            data->nb_stations*sizeof(char *));
+            data->tableau_labels = realloc(data->tableau_labels,\
+                                            data->nb_stations*sizeof(char *));
+
+            if (c < 0 || data->tableau_ids == NULL || data->tableau_adresses == NULL \
+                    || data->tableau_labels == NULL) {
+                printf("Erreur : Station %d introuvable ou pas assez de memoire.\n", id);
+                exit(EXIT_FAILURE);
             }
 
+            data->tableau_ids[st] = id;
+            data->tableau_adresses[st] = cand_adresses[c];
+            data->tableau_labels[st] = cand_labels[c];
+            cand_adresses[c] = NULL;
+            cand_labels[c] = NULL;
+            index_id[id] = st;
+
+            Cube_reserve(cube, data->nb_stations, cube->cap_rows);
         }
 
-        // Reset du stmt
-        sqlite3_finalize(stmt_station);
+        // Rangement des statuts a la derniere date de récolte
+        for (int statut = 0; statut < nb_statuts; statut++) {
+            Cube_set(cube, statut, index_id[id], data->nb_rows_par_station-1,\
+                        sqlite3_column_int(stmt, 3+statut));
+        }
+        nb_lignes++;
+    }
 
-        free(req_sql);
+    for (int c = 0; c < nb_cand; c++) {
+        free(cand_adresses[c]);
+        free(cand_labels[c]);
     }
+    free(cand_ids);
+    free(cand_adresses);
+    free(cand_labels);
+    free(cand_id);
+    free(index_id);
+
+    return nb_lignes;
 }
 
 /* --------------------------------------------------------------------------- */
-void Get_date_recolte(sqlite3 *db_belib, char *table,\
-                Date *tableau_date_recolte, int nb_rows_par_station)
+void Get_stations_data(sqlite3 *db_belib, char *table, int nb_statuts,\
+                        Fenetre *fenetre, StationsData *data)
 {
-    // Declaration statement
-    sqlite3_stmt *stmt;
-
-    char query_date_recolte_fav[250] = \
-            "SELECT  DISTINCT(date_recolte) FROM ";
-    
-    strcat(query_date_recolte_fav, table);
-    strcat(query_date_recolte_fav, ";");
-    
-    // Test de la requete
-    if (sqlite3_prepare_v2(db_belib, query_date_recolte_fav, -1, &stmt, NULL))
-    {
-        printf("Erreur SQL :\n");
-        printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                         sqlite3_errmsg(db_belib));
-        sqlite3_close(db_belib);
-        exit(EXIT_FAILURE);
-    }
+    Init_stations_data(data, nb_statuts);
 
-    // Application du statement et fermeture de la db
-    for (int i = 0; i < nb_rows_par_station; i++) {
-        int step = sqlite3_step(stmt);
-        if (step == SQLITE_ROW) 
-        {
-            Date date_i;
-            Init_Date(&date_i, (char *)sqlite3_column_text(stmt, 0));
-            tableau_date_recolte[i] = date_i;
-        }
-        // ELIF STOP
+    if (fenetre != NULL) {
+        data->fenetre = *fenetre;
+        data->fenetre.epoch_debut = Get_debut_fenetre(db_belib, table, fenetre->nb_jours);
     }
 
-    // Reset du stmt
-    sqlite3_finalize(stmt);
+    Update_stations_data(db_belib, table, data);
 }
 
-
 /* --------------------------------------------------------------------------- */
-void Get_adresses(sqlite3 *db_belib, char* table,\
-                char **tableau_adresses, int nb_stations)
+sqlite3_int64 Get_debut_fenetre(sqlite3 *db_belib, char *table, int nb_jours)
 {
+    if (nb_jours <= 0) return -1;
 
-    int len_max = 100;
-    // Declaration statement
-    sqlite3_stmt *stmt;
+    sqlite3_int64 epoch_max = Get_epoch_max(db_belib, table);
+    if (epoch_max < 0) return -1;
 
-    char query_adresse_stations_fav[250] = \
-            "SELECT  DISTINCT(adresse_station) FROM ";
-    
-    strcat(query_adresse_stations_fav, table);
-    strcat(query_adresse_stations_fav, ";");
-
-    // Test de la requete
-    if (sqlite3_prepare_v2(db_belib, query_adresse_stations_fav, -1, &stmt, NULL))
-    {
-        printf("Erreur SQL :\n");
-        printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                         sqlite3_errmsg(db_belib));
-        sqlite3_close(db_belib);
-        exit(EXIT_FAILURE);
-    }
+    // epoch "naive" (heure locale) : minuit local = multiple de 86400
+    return (epoch_max/86400 - (nb_jours-1))*86400;
+}
 
-    // Application du statement et fermeture de la db
-    for (int i = 0; i < nb_stations; i++) {
-        int step = sqlite3_step(stmt);
-        if (step == SQLITE_ROW) 
-        {
-            tableau_adresses[i] = (char *)malloc(len_max*sizeof(char));
-            // On supprime " Paris" en fin de chaine
-            strcpy(tableau_adresses[i],\
-                (char *)sqlite3_column_text(stmt, 0)); 
-                //, strlen((char *)sqlite3_column_text(stmt, 0))-6);
-        }
-        // ELIF STOP
-    }
+/* --------------------------------------------------------------------------- */
+void Get_somme_controle(sqlite3 *db_belib, char *table, sqlite3_int64 epoch_debut,\
+                        sqlite3_int64 epoch_fin, sqlite3_int64 somme_controle[3])
+{
+    // Recuperation du statement prepare
+    sqlite3_stmt *stmt = Get_stmt(db_belib, req_somme_controle, table);
+    sqlite3_bind_int64(stmt, 1, epoch_debut);
+    sqlite3_bind_int64(stmt, 2, epoch_fin);
 
-    // Reset du stmt
-    sqlite3_finalize(stmt);
+    for (int i = 0; i < 3; i++)
+        somme_controle[i] = 0;
 
+    // Application du statement (SUM sans ligne : NULL, lu comme 0)
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        for (int i = 0; i < 3; i++)
+            somme_controle[i] = sqlite3_column_int64(stmt, i);
+    }
 }
 
-
 /* --------------------------------------------------------------------------- */
-int Get_nb_rows_par_station_unique(sqlite3 *db_belib, char* table, \
-            int station, char **tableau_adresses)
+sqlite3_int64 Get_version_bdd(sqlite3 *db_belib, char *table)
 {
+    // Recuperation du statement prepare
+    sqlite3_stmt *stmt = Get_stmt(db_belib, req_version_bdd, table);
 
-    // Declaration statement
-    sqlite3_stmt *stmt;
-
-    int nb_rows_par_station = 0;
+    sqlite3_int64 version = -1;
 
-    char query_nb_row_par_station_unique[250] = \
-            "SELECT COUNT(DISTINCT date_recolte) FROM ";
-    
-    strcat(query_nb_row_par_station_unique, table);
-    strcat(query_nb_row_par_station_unique, " WHERE adresse_station = ");  
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        version = sqlite3_column_int64(stmt, 0);
 
-    int len_query_base = strlen(query_nb_row_par_station_unique);
-    int len_max_adresse = 200;
-    int len_query_station = len_query_base + len_max_adresse;
+    return version;
+}
 
-    char *req = malloc(len_query_station*sizeof(char));
+/* --------------------------------------------------------------------------- */
+sqlite3_int64 Get_epoch_max(sqlite3 *db_belib, char *table)
+{
+    // Recuperation du statement prepare
+    sqlite3_stmt *stmt = Get_stmt(db_belib, req_epoch_max, table);
 
-    strcpy(req, query_nb_row_par_station_unique);
-    strcat(req, "\"");
-    strcat(req, tableau_adresses[station]);
-    strcat(req, "\";");
+    sqlite3_int64 epoch_max = -1;
 
-    // Test de la requete
-    if (sqlite3_prepare_v2(db_belib,req,-1, &stmt, NULL))
+    // Application du statement (MAX sur table vide : NULL)
+    if (sqlite3_step(stmt) == SQLITE_ROW && \
+            sqlite3_column_type(stmt, 0) != SQLITE_NULL)
     {
-        printf("Erreur SQL unique:\n");
-        printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                         sqlite3_errmsg(db_belib));
-        sqlite3_close(db_belib);
-        exit(EXIT_FAILURE);
+        epoch_max = sqlite3_column_int64(stmt, 0);
     }
-    // Application du statement et fermeture de la db
-    int step = sqlite3_step(stmt);
 
-    if (step == SQLITE_ROW) {
-        nb_rows_par_station = sqlite3_column_int(stmt, 0);
-    }
+    return epoch_max;
+}
 
-    // Reset du stmt
-    sqlite3_finalize(stmt);
+/* --------------------------------------------------------------------------- */
+sqlite3_int64 Get_epoch_min(sqlite3 *db_belib, char *table, sqlite3_int64 epoch_borne)
+{
+    // Recuperation du statement prepare
+    sqlite3_stmt *stmt = Get_stmt(db_belib, req_epoch_min, table);
+    sqlite3_bind_int64(stmt, 1, epoch_borne);
 
-    free(req);
+    sqlite3_int64 epoch_min = -1;
 
-    return nb_rows_par_station;
-}
+    // Application du statement (MIN sur table vide : NULL)
+    if (sqlite3_step(stmt) == SQLITE_ROW && \
+            sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+    {
+        epoch_min = sqlite3_column_int64(stmt, 0);
+    }
 
+    return epoch_min;
+}
 
 /* --------------------------------------------------------------------------- */
-int Get_nb_rows_par_station(sqlite3 *db_belib, char* table)
+void Free_stations_data(StationsData *data)
 {
+    free_tab_char1(data->tableau_adresses, data->nb_stations);
+    free_tab_char1(data->tableau_labels, data->nb_stations);
+    free(data->tableau_ids);
+    free(data->tableau_adresses);
+    free(data->tableau_labels);
+    free(data->tableau_date_recolte);
+    Free_cube(&(data->statuts));
+}
 
-    // Declaration statement
-    sqlite3_stmt *stmt;
-
-    int nb_rows_par_station = 0;
+/* --------------------------------------------------------------------------- */
+void Get_positions(sqlite3 *db_belib, char *table, StationsData *data,\
+                    double positions[][2])
+{
+    sqlite3_stmt *stmt = Get_stmt(db_belib, req_positions, table);
 
-    char query_nb_row_par_station[250] = \
-            "SELECT COUNT(DISTINCT date_recolte) FROM ";
-    
-    strcat(query_nb_row_par_station, table);
-    strcat(query_nb_row_par_station, ";");
-    
+    // Stations de data dans l'ordre d'arrivée, lignes triées par ID
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        int id = sqlite3_column_int(stmt, 0);
+        for (int st = 0; st < data->nb_stations; st++) {
+            if (data->tableau_ids[st] == id) {
+                positions[st][0] = sqlite3_column_double(stmt, 1);
+                positions[st][1] = sqlite3_column_double(stmt, 2);
+                break;
+            }
+        }
+    }
+}
 
+/* --------------------------------------------------------------------------- */
+void Sqlite_open_check(char *bdd_filename, sqlite3 **db_belib)
+{
+    // Lecture seule, connexion utilisée par un seul thread
+    int rc = sqlite3_open_v2(bdd_filename, db_belib,\
+                    SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL);
 
-    // Test de la requete
-    if (sqlite3_prepare_v2(db_belib, query_nb_row_par_station,-1, &stmt, NULL))
+    // Test d'ouverture de la db
+    if (rc != SQLITE_OK)
     {
-        printf("Erreur SQL :\n");
-        printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                         sqlite3_errmsg(db_belib));
-        sqlite3_close(db_belib);
+        fprintf(stderr, "Err: %s\n", sqlite3_errmsg(*db_belib));
+        sqlite3_close(*db_belib);
         exit(EXIT_FAILURE);
     }
-    // Application du statement et fermeture de la db
-    int step = sqlite3_step(stmt);
 
-    if (step == SQLITE_ROW) 
+    // Test de la version du schema
+    sqlite3_stmt *stmt;
+    int version = -1;
+
+    if (sqlite3_prepare_v2(*db_belib, "PRAGMA user_version;", -1, &stmt, NULL) \
+            == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+        version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+
+    if (version < VERSION_BDD)
     {
-        nb_rows_par_station = sqlite3_column_int(stmt, 0);
+        fprintf(stderr, "Err: bdd en version %d, version %d attendue. "\
+                    "Lancer db_sqlite/migrate_db_belib.sh.\n", version, VERSION_BDD);
+        sqlite3_close(*db_belib);
+        exit(EXIT_FAILURE);
     }
 
-    // Reset du stmt
+    // Mode WAL attendu (sinon les lectures peuvent bloquer la recuperation)
+    if (sqlite3_prepare_v2(*db_belib, "PRAGMA journal_mode;", -1, &stmt, NULL) \
+            == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW && \
+            strcmp((const char *)sqlite3_column_text(stmt, 0), "wal") != 0)
+        printf("Info : bdd hors mode WAL. Lancer db_sqlite/migrate_db_belib.sh.\n");
     sqlite3_finalize(stmt);
 
-    return nb_rows_par_station;
+    Sqlite_pragmas(*db_belib, &PROFIL_BDD);
 }
 
 /* --------------------------------------------------------------------------- */
-int Get_nb_stations(sqlite3 *db_belib, char* table)
+void Sqlite_pragmas(sqlite3 *db_belib, const ProfilPragmas *profil)
 {
+    char req_sql[200];
+    char *err_msg = NULL;
 
-    // Declaration statement
-    sqlite3_stmt *stmt;
-
-    int nb_stations_favs = 0;
+    snprintf(req_sql, sizeof(req_sql), "PRAGMA mmap_size = %lld; "\
+                "PRAGMA cache_size = %d; PRAGMA temp_store = %s;",\
+                (long long)profil->mmap_size, profil->cache_size, profil->temp_store);
 
-    char query_nb_stations[250] = \
-            "SELECT COUNT(DISTINCT adresse_station) FROM ";
-    
-    strcat(query_nb_stations, table);
-    strcat(query_nb_stations, ";");
-
-    // Test de la requete
-    if (sqlite3_prepare_v2(db_belib, query_nb_stations,-1, &stmt, NULL))
+    if (sqlite3_exec(db_belib, req_sql, NULL, NULL, &err_msg) != SQLITE_OK)
     {
-        printf("Erreur SQL :\n");
-        printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
-                         sqlite3_errmsg(db_belib));
+        fprintf(stderr, "Err: %s\n", err_msg);
+        sqlite3_free(err_msg);
         sqlite3_close(db_belib);
         exit(EXIT_FAILURE);
     }
+}
 
-    // Application du statement et fermeture de la db
-    int step = sqlite3_step(stmt);
+/* --------------------------------------------------------------------------- */
+sqlite3_stmt *Get_stmt(sqlite3 *db_belib, int requete, char *table)
+{
+    // Recherche de la table dans la liste des tables autorisees
+    int id_table = 0;
+    while (id_table < NB_TABLES_REQ && strcmp(table, tables_req[id_table]) != 0)
+        id_table++;
+
+    if (id_table == NB_TABLES_REQ) {
+        printf("Erreur : table %s inconnue.\n", table);
+        Sqlite_close(db_belib);
+        exit(EXIT_FAILURE);
+    }
 
-    // int nb_col = sqlite3_column_count(stmt);
+    // Changement de connexion : on repart d'un registre vide
+    if (registre_stmt.db != db_belib) {
+        Finalize_stmts();
+        registre_stmt.db = db_belib;
+    }
 
-    if (step == SQLITE_ROW) 
-    {
-        nb_stations_favs = sqlite3_column_int(stmt, 0);
+    sqlite3_stmt **stmt = &(registre_stmt.stmt[id_table][requete]);
+
+    // Statement deja prepare : remise a zero
+    if (*stmt != NULL) {
+        sqlite3_reset(*stmt);
+        sqlite3_clear_bindings(*stmt);
+        return *stmt;
     }
-    // printf("Nb station favs : %d \n",sqlite3_column_int(stmt, 0));
 
-    // Reset du stmt
-    sqlite3_finalize(stmt);
+    // Premier appel : construction et preparation de la requete
+    // (nom de table passé deux fois : requetes avec sous-requete sur la table)
+    char req_sql[512];
+    snprintf(req_sql, sizeof(req_sql), sql_requetes[requete], tables_req[id_table],\
+                tables_req[id_table]);
 
-    return nb_stations_favs;
+    if (sqlite3_prepare_v3(db_belib, req_sql, -1, SQLITE_PREPARE_PERSISTENT,\
+                            stmt, NULL))
+    {
+        printf("Erreur SQL :\n");
+        printf("%s : %s\n", sqlite3_errstr(sqlite3_extended_errcode(db_belib)),\
+                         sqlite3_errmsg(db_belib));
+        Sqlite_close(db_belib);
+        exit(EXIT_FAILURE);
+    }
+
+    return *stmt;
 }
 
 /* --------------------------------------------------------------------------- */
-void Sqlite_open_check(char *bdd_filename, sqlite3 **db_belib)
+void Finalize_stmts(void)
 {
-    int rc = sqlite3_open(bdd_filename, db_belib);
+    for (int id_table = 0; id_table < NB_TABLES_REQ; id_table++) {
+        for (int requete = 0; requete < nb_requetes; requete++) {
+            sqlite3_finalize(registre_stmt.stmt[id_table][requete]);
+            registre_stmt.stmt[id_table][requete] = NULL;
+        }
+    }
+    registre_stmt.db = NULL;
+}
 
-    // Test d'ouverture de la db
-    if (rc != SQLITE_OK)
-    {
-        fprintf(stderr, "Err: %s\n", sqlite3_errmsg(*db_belib));
-        sqlite3_close(*db_belib);
-        exit(EXIT_FAILURE);
+/* --------------------------------------------------------------------------- */
+void Reset_stmts(void)
+{
+    for (int id_table = 0; id_table < NB_TABLES_REQ; id_table++) {
+        for (int requete = 0; requete < nb_requetes; requete++) {
+            if (registre_stmt.stmt[id_table][requete] != NULL)
+                sqlite3_reset(registre_stmt.stmt[id_table][requete]);
+        }
     }
 }
 
 /* --------------------------------------------------------------------------- */
-void Print_tableau_stations(int nb_station, int nb_date, int nb_statuts,\
-            int tab[nb_station][nb_date][nb_statuts],\
-            Date *tableau_date_recolte, char** tableau_adresses)
+void Sqlite_close(sqlite3 *db_belib)
+{
+    if (registre_stmt.db == db_belib)
+        Finalize_stmts();
+    sqlite3_close(db_belib);
+}
+
+/* --------------------------------------------------------------------------- */
+void Print_tableau_stations(StatusCube *cube, Date *tableau_date_recolte,\
+            char** tableau_adresses)
 {
-    for (int s = 0; s < nb_station; s++) {
+    for (int s = 0; s < cube->nb_stations; s++) {
         printf("--------------------------------------------------------\n");
         printf("> Adresse de la station : %s\n", tableau_adresses[s]);
         printf("--------------------------------------------------------\n");
-        for (int t = 0; t < nb_date; t++) {
+        for (int t = 0; t < cube->nb_rows; t++) {
             printf("|   %s -> %d disponible |", tableau_date_recolte[t].datestr,\
-             tab[s][t][disponible]);
+             Cube_get(cube, disponible, s, t));
             printf(" %d occupe | %d maintenance | %d inconnu |\n",\
-            tab[s][t][occupe], tab[s][t][en_maintenance], tab[s][t][inconnu]);
+            Cube_get(cube, occupe, s, t), Cube_get(cube, en_maintenance, s, t),\
+            Cube_get(cube, inconnu, s, t));
         }
         printf("\n");
     }
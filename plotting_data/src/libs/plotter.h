@@ -11,19 +11,43 @@
 
 #include "consts.h"
 #include "getter.h"
+#include "arene.h"
+#include "encodeur_png.h"
 #include <stdlib.h>
 #include <gd.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #define PI 3.141592
 
+/**
+ * @brief Nombre max de sprites de marqueurs (disques) gardés en mémoire, un par 
+ * couple (diamètre, couleur). Au-delà, les disques sont tracés directement.
+ */
+#define MARQUEURS_NB_MAX 32
+
 /* --------------------------------------------------------------------------- */
 /**
  * @brief Enumeration permettant d'atteindre les differentes polices pour chaque
  * élément de la figure : labels, titres, legende, annotation ...
  * 
  */
-typedef enum {label_f, annotation_f, title_f, ticklabel_f, subtitle_f, leg_f} fontsFig;
+typedef enum {label_f, annotation_f, title_f, ticklabel_f, subtitle_f, leg_f, nb_fonts} fontsFig;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Enumeration des emplacements de la table des couleurs d'une figure 
+ * (Figure.couleurs) : fond, canvas, une couleur par police (coul_polices + 
+ * index fontsFig) et les couleurs des lines plots (coul_lignes + index dans 
+ * color_lines).
+ * 
+ */
+typedef enum {coul_fond, coul_cvs, coul_polices,\
+              coul_lignes = coul_polices + nb_fonts,\
+              nb_couleurs = coul_lignes + NB_COULEURS_LIGNES} couleursFig;
 
 /* --------------------------------------------------------------------------- */
 /**
@@ -36,10 +60,12 @@ typedef struct BarData_s {
     size_t nb_ctg;        /**< Nombre de categories*/
     char **ctg_names;     /**< Labels des categories*/
     size_t nb_tot;        /**< Nombre total d'éléments dans l'ensemble des ctg*/
-    int *nb_in_ctg;        /**< Vecteur contenant le nombre d'elements par ctg */
+    uint16_t *nb_in_ctg;   /**< Vecteur contenant le nombre d'elements par ctg */
     int (*colors)[3];      /**< Vecteur contenant une couleur pour chaque ctg*/
+    int couleurs[NB_COULEURS_CTG]; /**< Couleurs truecolor de chaque ctg */
     char* label;           /**< Label associé au BarData */
     int idx;                /**< Index donné lorsqu'ajouté à la figure (pour posX)*/
+    size_t idx_dessin;      /**< Position dans Figure.pts_dessin (voir Add_barplot_to_fig)*/
 } BarData; 
 
 /* --------------------------------------------------------------------------- */
@@ -58,21 +84,25 @@ typedef struct LineStyle_s {
                                            '' : pas de marker */
     int  ms;        /**< Markersize*/
     int  color[3];  /**< Couleur rgb*/
+    int  couleur;   /**< Couleur truecolor (calculée par Init_linestyle) */
 } LineStyle;
 
 /* --------------------------------------------------------------------------- */
 /**
- * @brief Structure associant un vecteur de donnees labelisé (int) à un LineStyle
+ * @brief Structure associant un vecteur de donnees labelisé (int en X, 
+ * comptes uint16 en Y) à un LineStyle. Les Y sont élargis en int au tracé.
  * 
  */
 typedef struct LineData_s {
     size_t len_data;      /**< Taille du vecteur de data */
     int *x;               /**< Vecteur de data X */
-    int *y;               /**< Vecteur de data Y */
+    const uint16_t *y;    /**< Vecteur de data Y */
     int max_X;            /**< Maximum des valeurs X */
     int max_Y;            /**< Maximum des valeurs Y */
     char* label;
     LineStyle *linestyle;  /**< LineStyle */
+    size_t idx_dessin;    /**< Position dans Figure.pts_dessin (voir Add_line_to_fig)*/
+    size_t len_dessin;    /**< Nombre de points tracés (après LTTB) */
 } LineData; 
 
 /* --------------------------------------------------------------------------- */
@@ -88,6 +118,8 @@ typedef struct fLineData_s {
     float fmax_Y;            /**< Maximum des valeurs Y */
     char* label;
     LineStyle *linestyle;  /**< LineStyle */
+    size_t idx_dessin;    /**< Position dans Figure.pts_dessin (voir Add_fline_to_fig)*/
+    size_t len_dessin;    /**< Nombre de points tracés (après LTTB) */
 } fLineData; 
 
 
@@ -102,6 +134,44 @@ typedef struct Font_s {
     int color[3];       /**< Couleur de la police (rgb) */
 } Font;
 
+// Déclaration anticipée : les primitives du Backend prennent un Figure *
+struct Figure_s;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Backend de dessin d'une figure : primitives appelées par toutes les 
+ * fonctions de tracé (Make_*, Plot*). Par défaut backend_gd (image gd, png),
+ * backend_svg dans svg.h. Coordonnées en pixels de la figure, couleurs 
+ * truecolor, textes comme gdImageStringFT.
+ * 
+ */
+typedef struct Backend_s {
+    const char *nom;    /**< Nom du backend ("gd", "svg") */
+    /** Rectangle plein, coins (x1,y1) et (x2,y2) inclus */
+    void (*rectangle)(struct Figure_s *fig, int x1, int y1, int x2, int y2, int couleur);
+    /** Segment avec le style (trait plein ou pointillé, épaisseur) */
+    void (*ligne)(struct Figure_s *fig, int x1, int y1, int x2, int y2, LineStyle *linestyle);
+    /** Polyligne de nb_pts points, décalés de orig */
+    void (*polyligne)(struct Figure_s *fig, size_t nb_pts, const int x[], const int y[],\
+                        const int orig[2], LineStyle *linestyle);
+    /** Disque plein de centre (x,y) */
+    void (*disque)(struct Figure_s *fig, int x, int y, int diametre, int couleur);
+    /** Secteur de disque plein, angles en degrés (sens horaire, 0 : 3h) */
+    void (*secteur)(struct Figure_s *fig, int x, int y, int diametre, int debut, int fin,\
+                        int couleur);
+    /** Texte (angle en radians, (x,y) début de la baseline), brect rempli si
+     * non NULL. Renvoie NULL ou un message d'erreur, comme gdImageStringFT */
+    char *(*texte)(struct Figure_s *fig, int *brect, int couleur, char *path,\
+                        double size, double angle, int x, int y, char *texte);
+    /** Texte court horizontal (ticks, valeurs), taille entière */
+    void (*etiquette)(struct Figure_s *fig, int couleur, const char *path, int size,\
+                        int x, int y, const char *texte);
+    /** Ecrit le fichier de la figure (png, svg) dans un flux ouvert en
+     * écriture. Renvoie 0, ou -1 si l'écriture a échoué */
+    int (*ecrire)(struct Figure_s *fig, FILE *f);
+    /** Libère les données du backend (appelée par Destroy_figure), ou NULL */
+    void (*liberer)(struct Figure_s *fig);
+} Backend;
 
 /* --------------------------------------------------------------------------- */
 /**
@@ -118,7 +188,7 @@ typedef struct Figure_s {
     fLineData **flinedata;  /**< Vecteur de fLineData */
     LineData **linedata;  /**< Vecteur de LineData */
     BarData **bardata;   /**< Vecteur de BarData */
-    Font fonts[6];       /**< Fonts used in the fig*/
+    Font fonts[nb_fonts]; /**< Fonts used in the fig*/
     int max_X;           /**< max de l'ensemble des max_X de linedata[] */
     int max_Y;           /**< max de l'ensemble des max_Y de linedata[] */
     float fmax_Y;        /**< max de l'ensemble des max_Y (float) de linedata[] */
@@ -129,8 +199,37 @@ typedef struct Figure_s {
     int color_bg[3];     /**< Couleur du fond de la figure */
     int color_cvs_bg[3]; /**< Couleur du fond du canvas */
     int color_axes[3];   /**< Couleur des axes*/
+    int couleurs[nb_couleurs]; /**< Table des couleurs truecolor (voir couleursFig) */
+    int pts_par_pixel;   /**< Sous-echantillonnage LTTB des courbes (0 : aucun) */
+    int niveau_png;      /**< Niveau de compression zlib du png (0-9) */
+    int strategie_png;   /**< Stratégie zlib du png (encodeur par blocs) */
+    int nb_blocs_png;    /**< Blocs de l'encodeur png parallèle (0 : gdImagePngEx) */
+    char palette_png;    /**< 'y' : png à palette 8 bits, 'n' : png truecolor (RGB) */
+    int *pts_dessin;     /**< Coordonnées pixels de toutes les séries (voir Transform_series_figure) */
+    size_t len_pts_dessin;    /**< Nombre d'entiers utilisés par les séries dans pts_dessin */
+    size_t taille_pts_dessin; /**< Nombre d'entiers alloués pour pts_dessin */
+    int dessin_a_jour;   /**< 1 si pts_dessin correspond aux séries et maxima actuels */
+    size_t cap_linedata;  /**< Capacité du vecteur linedata */
+    size_t cap_flinedata; /**< Capacité du vecteur flinedata */
+    size_t cap_bardata;   /**< Capacité du vecteur bardata */
+    Arene arene;         /**< Mémoire de la figure (séries, pts_dessin, ...), libérée par Destroy_figure */
+    char axes;           /**< 'y' si les axes support sont tracés (wAxes de Init_figure) */
+    const Backend *backend; /**< Primitives de dessin (backend_gd par défaut) */
+    void *donnees_backend;  /**< Données propres au backend (flux svg...), NULL pour gd */
 } Figure;
 
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Sprite d'un marqueur circulaire : disque plein tracé une fois par
+ * gdImageFilledEllipse sur une image transparente, puis copié à chaque point.
+ * 
+ */
+typedef struct Marqueur_s {
+    int diametre;        /**< Diamètre du disque (pixels) */
+    int couleur;         /**< Couleur truecolor */
+    gdImagePtr img;      /**< Image du disque (côté 2*(diametre/2)+1) */
+} Marqueur;
+
 /* --------------------------------------------------------------------------- */
 // Declaration fonctions
 /* --------------------------------------------------------------------------- */
@@ -191,6 +290,15 @@ float Max_float(float x, float y);
  */
 float fMaxval_array(const float x_array[], size_t n);
 
+/**
+ * @brief Renvoie le max d'un tableau de comptes (uint16)
+ * 
+ * @param x_array Tableau de uint16
+ * @param n Taille du tableau
+ * @return int Valeur max dans le tableau
+ */
+int uMaxval_array(const uint16_t x_array[], size_t n);
+
 /**
  * @brief Transforme les degrés en radians
  * 
@@ -209,6 +317,36 @@ float Deg2rad(float angle);
  */
 int GetCouleur(gdImagePtr im_fig, const int couleur[3]);
 
+/**
+ * @brief Renvoie l'entier couleur truecolor d'un triplet rgb, sans appel à 
+ * libgd (les figures sont toujours en truecolor, voir Init_figure)
+ * 
+ * @param couleur Couleur : vecteur de 3 entiers (0-255) 
+ * @return int Couleur truecolor
+ */
+static inline int Couleur_tc(const int couleur[3])
+{
+    return gdTrueColor(couleur[0], couleur[1], couleur[2]);
+}
+
+/**
+ * @brief Remplit la table des couleurs de la figure (fond, canvas, polices, 
+ * lines plots). Appelée par Init_figure et à chaque changement de couleur.
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ */
+void Maj_couleurs_figure(Figure *fig);
+
+/**
+ * @brief Ecrit l'image d'une figure au format png dans un flux (palette, 
+ * encodage par blocs ou libgd selon les réglages de la figure)
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ * @param f Flux ouvert en écriture
+ * @return int 0 si ok, -1 si l'écriture a échoué
+ */
+int Ecrire_png(Figure *fig, FILE *f);
+
 /**
  * @brief Sauvegarde une figure au format png
  * 
@@ -218,6 +356,87 @@ int GetCouleur(gdImagePtr im_fig, const int couleur[3]);
  */
 void Save_to_png(Figure *fig, const char *dir_figures, const char *filename_fig);
 
+/**
+ * @brief Sauvegarde une figure avec son backend : png (backend_gd, voir 
+ * Ecrire_png) ou svg (backend_svg). Le fichier est écrit sous un nom 
+ * temporaire unique du même dossier puis renommé : un lecteur (serveur web)
+ * ne voit jamais de figure partielle, et plusieurs threads ou process peuvent
+ * sauvegarder la même figure.
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ * @param dir_figures Dossier de sauvegarde des figures (output)
+ * @param filename_fig Nom du fichier à sauvegarder
+ * @return int 0 si ok, -1 si le fichier n'a pas pu être écrit
+ */
+int Save_figure(Figure *fig, const char *dir_figures, const char *filename_fig);
+
+/**
+ * @brief Ecrit une figure avec son backend dans un tampon mémoire (envoi sur
+ * une socket, ...)
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ * @param taille Taille du fichier en octets (sortie)
+ * @return char* Fichier png ou svg, à libérer par free (NULL si échec)
+ */
+char *Figure_en_memoire(Figure *fig, size_t *taille);
+
+/**
+ * @brief Backend par défaut des figures : dessin dans l'image gd (fig->img)
+ * et sauvegarde en png
+ * 
+ */
+extern const Backend backend_gd;
+
+/**
+ * @brief Primitives du backend gd (voir Backend) : appels libgd sur fig->img
+ * 
+ */
+void Gd_rectangle(Figure *fig, int x1, int y1, int x2, int y2, int couleur);
+void Gd_ligne(Figure *fig, int x1, int y1, int x2, int y2, LineStyle *linestyle);
+void Gd_polyligne(Figure *fig, size_t nb_pts, const int x[], const int y[],\
+                    const int orig[2], LineStyle *linestyle);
+void Gd_disque(Figure *fig, int x, int y, int diametre, int couleur);
+void Gd_secteur(Figure *fig, int x, int y, int diametre, int debut, int fin, int couleur);
+char *Gd_texte(Figure *fig, int *brect, int couleur, char *path,\
+                    double size, double angle, int x, int y, char *texte);
+void Gd_etiquette(Figure *fig, int couleur, const char *path, int size,\
+                    int x, int y, const char *texte);
+
+/**
+ * @brief Détruit une figure : libère l'image et toute la mémoire de son arène 
+ * (vecteurs de séries, coordonnées pixels, buffers alloués par Alloc_arene 
+ * sur fig->arene). A appeler une fois la figure sauvegardée.
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ */
+void Destroy_figure(Figure *fig);
+
+/**
+ * @brief Initialise le cache des polices FreeType de libgd, partagé par toutes 
+ * les figures. A appeler une seule fois au lancement du programme, avant de
+ * tracer des figures dans plusieurs threads.
+ */
+void Init_cache_polices(void);
+
+/**
+ * @brief Libère le cache des polices et les sprites des marqueurs. A appeler une seule fois, une fois toutes les figures tracées
+ * (threads de tracé terminés).
+ */
+void Free_cache_polices(void);
+
+/**
+ * @brief Trace un disque plein centré en (x, y), comme gdImageFilledEllipse, 
+ * par copie d'un sprite rasterisé au premier appel pour ce (diamètre, couleur).
+ * Peut être appelée depuis plusieurs threads (sprites protégés par un mutex).
+ * 
+ * @param im_fig Pointeur vers l'image de la figure
+ * @param x Abcisse du centre
+ * @param y Ordonnée du centre
+ * @param diametre Diamètre du disque (pixels)
+ * @param couleur Couleur truecolor
+ */
+void ImageDisqueSprite(gdImagePtr im_fig, int x, int y, int diametre, int couleur);
+
 
 /**
  * @brief Permet d'initialiser un objet de type Figure 
@@ -275,6 +494,41 @@ void Change_fig_cvs_bg(Figure *fig, int color[3]);
  */
 void Change_fig_axes_color(Figure *fig, int color[3]);
 
+/**
+ * @brief Active le sous-échantillonnage LTTB des courbes de la figure avant 
+ * tracé (PlotLine, PlotFLine) : au plus pts_par_pixel points par pixel de 
+ * largeur de la zone de dessin.
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ * @param pts_par_pixel Nombre de points par pixel (0 : desactivé, par défaut)
+ */
+void Change_sous_echantillonnage(Figure *fig, int pts_par_pixel);
+
+/**
+ * @brief Règle l'encodage png de la figure (Save_to_png) : niveau zlib et, 
+ * avec nb_blocs > 0, encodeur par blocs en parallèle (encodeur_png.h) avec 
+ * la stratégie zlib donnée. Par défaut : niveau 5, sans blocs (gdImagePngEx
+ * en truecolor, un seul bloc pour le png à palette).
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ * @param niveau Niveau de compression zlib (0-9)
+ * @param strategie Stratégie zlib (Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE...),
+ * ignorée par gdImagePngEx
+ * @param nb_blocs Nombre de blocs de l'encodeur parallèle (0 : gdImagePngEx
+ * en truecolor)
+ */
+void Change_compression_png(Figure *fig, int niveau, int strategie, int nb_blocs);
+
+/**
+ * @brief Choisit le format du png de la figure : palette 8 bits (par défaut,
+ * la figure est tracée en truecolor puis convertie à l'enregistrement, 
+ * couleurs de la figure exactes) ou truecolor (RGB 24 bits).
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ * @param palette 'y' : png à palette, 'n' : png truecolor
+ */
+void Change_palette_png(Figure *fig, char palette);
+
 /**
  * @brief Permet de modifier la police d'un des éléments de la figure (voir enum fontsFig)
  * 
@@ -322,11 +576,11 @@ void Init_linestyle(LineStyle *linestyle, char style,const int color[3], int wid
  * @param nb_ctg Nombre de catégories dans les données
  * @param labels_ctg Labels associés à chaque catégorie
  * @param nb_tot Nombre total d'éléments dans les data
- * @param nb_in_ctg Nombre d'éléments par catégorie (tableau de taille nb_ctg)
+ * @param nb_in_ctg Nombre d'éléments par catégorie (tableau de taille nb_ctg, uint16)
  * @param colors Couleurs associées à chaque catégorie (tableau de taille nb_ctg)
  * @param label Label associé a l'object BarData
  */
-void Init_bardata(BarData *bardata, int nb_ctg, char *labels_ctg[nb_ctg],int nb_tot, int nb_in_ctg[nb_ctg],int colors[nb_ctg][3], char* label);
+void Init_bardata(BarData *bardata, int nb_ctg, char *labels_ctg[nb_ctg],int nb_tot, uint16_t nb_in_ctg[nb_ctg],int colors[nb_ctg][3], char* label);
 
 /**
  * @brief Initialise un objet de type LineData, utilisé pour un lineplot de données entières
@@ -338,7 +592,7 @@ void Init_bardata(BarData *bardata, int nb_ctg, char *labels_ctg[nb_ctg],int nb_
  * @param label Label associé au LineData, retrouvé dans la légende
  * @param linestyle Objet de type LineStyle associé au LineData
  */
-void Init_linedata(LineData *linedata, int len_data, int ptx[], int pty[],char* label, LineStyle *linestyle);
+void Init_linedata(LineData *linedata, int len_data, int ptx[], const uint16_t pty[],char* label, LineStyle *linestyle);
 
 /**
  * @brief Initialise un objet de type fLineData, utilisé pour un lineplot de données de type float en Y
@@ -387,44 +641,66 @@ void PlotFLine(Figure *fig, fLineData *flinedata);
  */
 void PlotBarplot(Figure *fig, BarData *bardata, char wlabels);
 
+/**
+ * @brief Fonction interne passant toutes les séries de la figure (LineData, 
+ * fLineData, BarData) dans le référentiel de la zone de dessin, en une passe 
+ * et dans un seul tableau (fig->pts_dessin, réalloué seulement s'il grandit).
+ * Pour chaque courbe : les X puis les Y, sous-échantillonnés (LTTB) si 
+ * demandé ; pour chaque barplot : les Y cumulés des catégories. 
+ * Appelée par PlotLine, PlotFLine et PlotBarplot, ne refait rien tant 
+ * qu'aucune série n'est ajoutée.
+ * 
+ * @param fig Pointeur vers objet de type Figure
+ */
+void Transform_series_figure(Figure *fig);
+
 /**
  * @brief Fonction interne permettant de changer le référentiel des données d'entrée selon X (int) pour qu'il s'adapte à la zone de dessin
- * Cas d'un fLineData. Renvoie un vecteur d'entier (pixels).
+ * Cas d'un fLineData (points régulièrement espacés).
  *  
  * @param fig Pointeur vers objet de type Figure
  * @param len_pts Taille du vecteur X
  * @param pts Vecteur d'entier X
- * @return int* Vecteur d'entier X dans le référentiel de la zone de dessin (en pixel)
+ * @param pts_dessin Tableau de len_pts entiers rempli avec les X dans le référentiel de la zone de dessin (en pixel)
  */
-int *Transform_fdataX_to_plot(Figure *fig, size_t len_pts,const int pts[]);
+void Transform_fdataX_to_plot(Figure *fig, size_t len_pts,const int pts[], int* pts_dessin);
 
 /**
  * @brief Fonction interne permettant de changer le référentiel des données d'entrée selon Y (float) pour qu'il s'adapte à la zone de dessin.
- * Cas d'un fLineData. Renvoie un vecteur d'entier (pixels).
+ * Cas d'un fLineData.
  * 
  * @param fig Pointeur vers objet de type Figure
  * @param len_pts Taille du vecteur Y
  * @param pts Vecteur de float Y
- * @return int* Vecteur d'entier Y dans le référentiel de la zone de dessin
+ * @param pts_dessin Tableau de len_pts entiers rempli avec les Y dans le référentiel de la zone de dessin (en pixel)
+ */
+void Transform_fdataY_to_plot(Figure *fig, size_t len_pts,const float pts[], int* pts_dessin);
+
+/**
+ * @brief Fonction interne permettant de changer le référentiel des données d'entrée selon Y (uint16) pour qu'il s'adapte à la zone de dessin.
+ * Cas d'un LineData : les comptes sont élargis en int uniquement ici.
+ * 
+ * @param fig Pointeur vers objet de type Figure
+ * @param len_pts Taille du vecteur Y
+ * @param pts Vecteur de uint16 Y
+ * @param pts_dessin Tableau de len_pts entiers rempli avec les Y dans le référentiel de la zone de dessin (en pixel)
  */
-int *Transform_fdataY_to_plot(Figure *fig, size_t len_pts,const float pts[]);
+void Transform_udataY_to_plot(Figure *fig, size_t len_pts,const uint16_t pts[], int* pts_dessin);
 
 /**
  * @brief Fonction interne permettant de changer le référentiel des données d'entrée d'un BarData pour qu'il s'adapte à la zone de dessin.
- * Cas d'un BarData. Renvoie un vecteur d'entier (pixels).
+ * Cas d'un BarData : Y cumulés (haut de chaque catégorie empilée).
  * 
  * @param fig Pointeur vers un objet de type Figure
  * @param nb_ctg Nombre de catégorie dans le Bardata
- * @param pts 
- * @return int* 
- * @warning Malloc fait, desallocation en interne
- * @note nb_ctg peut normalement etre recupéré à partir de fig->BarData
+ * @param pts Nombre d'éléments par catégorie
+ * @param pts_dessin Tableau de nb_ctg entiers rempli avec les Y dans le référentiel de la zone de dessin (en pixel)
  */
-int *Transform_data_to_plot_bar(Figure *fig, size_t nb_ctg,const int pts[]);
+void Transform_data_to_plot_bar(Figure *fig, size_t nb_ctg,const uint16_t pts[], int* pts_dessin);
 
 /**
  * @brief Fonction interne permettant de changer le référentiel des données d'entrée selon X (int) pour qu'il s'adapte à la zone de dessin
- * Cas d'un LineData. Renvoie un vecteur d'entier (pixels).
+ * Cas d'un LineData.
  * 
  * @param fig Pointeur vers objet de type Figure
  * @param len_pts Taille du vecteur X
@@ -435,7 +711,7 @@ void Transform_dataX_to_plot(Figure *fig, size_t len_pts,const int pts[], int* p
 
 /**
   * @brief Fonction interne permettant de changer le référentiel des données d'entrée selon Y (int) pour qu'il s'adapte à la zone de dessin
- * Cas d'un LineData. Renvoie un vecteur d'entier (pixels).
+ * Cas d'un LineData.
  * 
  * @param fig Pointeur vers objet de type Figure
  * @param len_pts Taille du vecteur Y
@@ -444,17 +720,6 @@ void Transform_dataX_to_plot(Figure *fig, size_t len_pts,const int pts[], int* p
  */
 void Transform_dataY_to_plot(Figure *fig, size_t len_pts,const int pts[], int* pts_dessin);
 
-/**
- * @brief Fonction interne appelant Transform_dataX_to_plot ou Transform_dataY_to_plot en fonction de la direction spécifiée
- * 
- * @param fig Pointeur vers objet de type Figure
- * @param len_pts Taille du vecteur X ou Y
- * @param pts Vecteur d'entier X ou Y en input 
- * @param direction Caractere 'x' ou 'y'
- * @return int* Tableau d'entier dans le réferentiel de la zone de dessin (en pixel)
- */
-int *Transform_data_to_plot(Figure *fig, size_t len_pts,const int pts[], char direction);
-
 
 /**
  * @brief Ajoute un objet de type LineData à la Figure. Permet un update des maxima et de gérer les tracés
@@ -665,7 +930,47 @@ void Print_debug_bd(BarData *bardata, char w_cat);
  * @param y2 Ordonnée du point 2
  * @param linestyle Pointeur vers objet de type LineStyle donnant le style du trait
  */
-void ImageLineEpaisseur(gdImagePtr im_fig,const int x1, const int y1, const int x2, const int y2, LineStyle *linestyle)
+void ImageLineEpaisseur(gdImagePtr im_fig,const int x1, const int y1, const int x2, const int y2, LineStyle *linestyle);
+
+/**
+ * @brief Trace une courbe entière avec un LineStyle donné, en une passe : 
+ * l'épaisseur est réglée une seule fois, les points alignés consécutifs 
+ * (paliers, points confondus) sont fusionnés en un seul segment, et seuls les 
+ * changements de direction donnent une jonction (carré de côté l'épaisseur du 
+ * trait, qui bouche l'encoche entre deux segments épais).
+ * 
+ * @param im_fig Pointeur vers un objet de type gdImage
+ * @param nb_pts Nombre de points de la courbe
+ * @param x Abcisses des points dans le référentiel de la zone de dessin
+ * @param y Ordonnées des points dans le référentiel de la zone de dessin
+ * @param orig Origine de la zone de dessin dans l'image (ajoutée à x et y)
+ * @param linestyle Pointeur vers objet de type LineStyle donnant le style du trait
+ */
+void ImagePolyligneEpaisseur(gdImagePtr im_fig, size_t nb_pts, const int x[], const int y[], const int orig[2], LineStyle *linestyle);
+
+/**
+ * @brief Sous-échantillonne une courbe (coordonnées en pixels) par la méthode 
+ * Largest-Triangle-Three-Buckets : le 1er et le dernier point sont gardés, puis
+ * un point par intervalle, celui formant le plus grand triangle avec le point 
+ * gardé précédent et la moyenne de l'intervalle suivant. Les pics visibles sont
+ * ainsi conservés. Les points gardés sont rangés en début de x et y (en place).
+ * 
+ * @param len_pts Nombre de points de la courbe
+ * @param x Abcisses des points (croissantes)
+ * @param y Ordonnées des points
+ * @param nb_pts Nombre de points souhaités (>= 3)
+ * @return size_t Nombre de points gardés (min(len_pts, nb_pts))
+ */
+size_t Lttb_sous_echantillonnage(size_t len_pts, int x[], int y[], size_t nb_pts);
+
+/**
+ * @brief Renvoie le nombre max de points tracés par courbe pour la figure 
+ * (0 : pas de sous-échantillonnage)
+ * 
+ * @param fig Pointeur vers un objet de type Figure
+ * @return size_t Nombre max de points par courbe
+ */
+size_t Get_nb_pts_max(Figure *fig);
 
 
 /* --------------------------------------------------------------------------- */
@@ -698,6 +1003,17 @@ int Maxval_array(const int x_array[], size_t n)
     return t;
 }
 
+/* --------------------------------------------------------------------------- */
+int uMaxval_array(const uint16_t x_array[], size_t n)
+{
+    uint16_t t = x_array[0];
+    for (size_t i = 1; i < n; i++)
+    {
+        t = (x_array[i] > t) ? x_array[i] : t;
+    }
+    return t;
+}
+
 /* --------------------------------------------------------------------------- */
 int Minval_array(const int x_array[], size_t n)
 {
@@ -728,6 +1044,34 @@ float Deg2rad(float angle)
     return angle*PI/180;
 }
 
+/* --------------------------------------------------------------------------- */
+int Ecrire_png(Figure *fig, FILE *pngout_fig)
+{
+    /* Output the image to the disk file in PNG format. */
+    if (fig->palette_png == 'y') {
+        // Couleurs de la figure (fond, polices, lignes, catégories) gardées 
+        // exactes dans la palette
+        int couleurs_fixes[nb_couleurs + fig->nb_bardata*NB_COULEURS_CTG];
+        int nb_fixes = 0;
+        for (int c = 0; c < nb_couleurs; c++)
+            couleurs_fixes[nb_fixes++] = fig->couleurs[c];
+        for (size_t bd = 0; bd < fig->nb_bardata; bd++)
+            for (size_t ctg = 0; ctg < fig->bardata[bd]->nb_ctg; ctg++)
+                couleurs_fixes[nb_fixes++] = fig->bardata[bd]->couleurs[ctg];
+
+        Ecrire_png_palette(fig->img, pngout_fig, couleurs_fixes, nb_fixes,\
+                            fig->niveau_png, fig->strategie_png,\
+                            fig->nb_blocs_png > 0 ? fig->nb_blocs_png : 1);
+    }
+    else if (fig->nb_blocs_png > 0)
+        Ecrire_png_blocs(fig->img, pngout_fig, fig->niveau_png,\
+                            fig->strategie_png, fig->nb_blocs_png);
+    else
+        gdImagePngEx(fig->img, pngout_fig, fig->niveau_png);
+
+    return ferror(pngout_fig) ? -1 : 0;
+}
+
 /* --------------------------------------------------------------------------- */
 void Save_to_png(Figure *fig, const char *dir_figures, const char *filename_fig)
 {
@@ -738,17 +1082,148 @@ void Save_to_png(Figure *fig, const char *dir_figures, const char *filename_fig)
     strcat(path_outputFig, filename_fig);
     pngout_fig = fopen(path_outputFig, "wb");
 
-    /* Output the image to the disk file in PNG format. */
-    gdImagePngEx(fig->img, pngout_fig,5);
+    Ecrire_png(fig, pngout_fig);
 
     /* Close the files. */
     fclose(pngout_fig);
+}
 
-    // Free des tableau de data dans la figure
-    free(fig->flinedata);
-    free(fig->linedata);
-    free(fig->bardata);
+/* --------------------------------------------------------------------------- */
+int Save_figure(Figure *fig, const char *dir_figures, const char *filename_fig)
+{
+    char path_outputFig[400] = {""};
+    strcat(path_outputFig, dir_figures);
+    strcat(path_outputFig, filename_fig);
+
+    // Fichier temporaire unique à coté de la figure (même système de 
+    // fichiers : le renommage est atomique)
+    char fichier_tmp[strlen(path_outputFig)+8];
+    sprintf(fichier_tmp, "%s.XXXXXX", path_outputFig);
+
+    int fd = mkstemp(fichier_tmp);
+    FILE *f = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (f == NULL) {
+        printf("Info : impossible d'ecrire la figure %s.\n", path_outputFig);
+        if (fd >= 0) {
+            close(fd);
+            remove(fichier_tmp);
+        }
+        return -1;
+    }
+
+    // mkstemp crée le fichier en 0600 : figure lisible par le serveur web
+    fchmod(fd, 0644);
+
+    int ok = fig->backend->ecrire(fig, f) == 0;
+    if (fclose(f) != 0) ok = 0;
 
+    if (!ok || rename(fichier_tmp, path_outputFig) != 0) {
+        printf("Info : echec de l'ecriture de la figure %s.\n", path_outputFig);
+        remove(fichier_tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------- */
+char *Figure_en_memoire(Figure *fig, size_t *taille)
+{
+    char *tampon = NULL;
+    FILE *f = open_memstream(&tampon, taille);
+    if (f == NULL) return NULL;
+
+    int ok = fig->backend->ecrire(fig, f) == 0;
+    if (fclose(f) != 0) ok = 0;
+
+    if (!ok) {
+        free(tampon);
+        return NULL;
+    }
+
+    return tampon;
+}
+
+/* --------------------------------------------------------------------------- */
+void Gd_rectangle(Figure *fig, int x1, int y1, int x2, int y2, int couleur)
+{
+    gdImageFilledRectangle(fig->img, x1, y1, x2, y2, couleur);
+}
+
+/* --------------------------------------------------------------------------- */
+void Gd_ligne(Figure *fig, int x1, int y1, int x2, int y2, LineStyle *linestyle)
+{
+    ImageLineEpaisseur(fig->img, x1, y1, x2, y2, linestyle);
+}
+
+/* --------------------------------------------------------------------------- */
+void Gd_polyligne(Figure *fig, size_t nb_pts, const int x[], const int y[],\
+                    const int orig[2], LineStyle *linestyle)
+{
+    ImagePolyligneEpaisseur(fig->img, nb_pts, x, y, orig, linestyle);
+}
+
+/* --------------------------------------------------------------------------- */
+void Gd_disque(Figure *fig, int x, int y, int diametre, int couleur)
+{
+    ImageDisqueSprite(fig->img, x, y, diametre, couleur);
+}
+
+/* --------------------------------------------------------------------------- */
+void Gd_secteur(Figure *fig, int x, int y, int diametre, int debut, int fin, int couleur)
+{
+    gdImageFilledArc(fig->img, x, y, diametre, diametre, debut, fin, couleur, gdArc);
+}
+
+/* --------------------------------------------------------------------------- */
+char *Gd_texte(Figure *fig, int *brect, int couleur, char *path,\
+                    double size, double angle, int x, int y, char *texte)
+{
+    return gdImageStringFT(fig->img, brect, couleur, path, size, angle, x, y, texte);
+}
+
+/* --------------------------------------------------------------------------- */
+void Gd_etiquette(Figure *fig, int couleur, const char *path, int size,\
+                    int x, int y, const char *texte)
+{
+    gdImageStringFT(fig->img, NULL, couleur, (char *)path, size, 0., x, y, (char *)texte);
+}
+
+/* --------------------------------------------------------------------------- */
+const Backend backend_gd = {
+    .nom = "gd",
+    .rectangle = Gd_rectangle,
+    .ligne = Gd_ligne,
+    .polyligne = Gd_polyligne,
+    .disque = Gd_disque,
+    .secteur = Gd_secteur,
+    .texte = Gd_texte,
+    .etiquette = Gd_etiquette,
+    .ecrire = Ecrire_png,
+    .liberer = NULL,
+};
+
+/* --------------------------------------------------------------------------- */
+void Destroy_figure(Figure *fig)
+{
+    if (fig->backend->liberer != NULL)
+        fig->backend->liberer(fig);
+    fig->backend = &backend_gd;
+    fig->donnees_backend = NULL;
+
+    gdImageDestroy(fig->img);
+    fig->img = NULL;
+
+    // Vecteurs de séries et coordonnées pixels : tout est dans l'arène
+    Free_arene(&fig->arene);
+    fig->linedata = NULL;
+    fig->flinedata = NULL;
+    fig->bardata = NULL;
+    fig->pts_dessin = NULL;
+    fig->nb_linedata = fig->nb_flinedata = fig->nb_bardata = 0;
+    fig->cap_linedata = fig->cap_flinedata = fig->cap_bardata = 0;
+    fig->len_pts_dessin = fig->taille_pts_dessin = 0;
+    fig->dessin_a_jour = 0;
 }
 
 
@@ -757,16 +1232,16 @@ void Make_background(Figure *fig,\
                         const int color_bg[3], const int color_canvas_bg[3])
 {
     /* Remplissage du fond */
-    gdImageFilledRectangle(fig->img,\
+    fig->backend->rectangle(fig,\
                         0, 0,\
                         fig->img->sx-1, fig->img->sy-1,
-                        GetCouleur(fig->img, color_bg));
+                        Couleur_tc(color_bg));
 
     /* Remplissage du canvas */
-    gdImageFilledRectangle(fig->img,\
+    fig->backend->rectangle(fig,\
                         fig->padX[0], fig->padY[0],\
                         (fig->img->sx-1)-fig->padX[1], (fig->img->sy-1) - fig->padY[1],\
-                        GetCouleur(fig->img, color_canvas_bg));
+                        Couleur_tc(color_canvas_bg));
 }
 
 /* --------------------------------------------------------------------------- */
@@ -775,13 +1250,13 @@ void ImageLineEpaisseur(gdImagePtr im_fig,\
 {
                     
     gdImageSetThickness(im_fig, linestyle->w);
-    // gdImageSetAntiAliased(im_fig, GetCouleur(im_fig, linestyle->color));
+    // gdImageSetAntiAliased(im_fig, linestyle->couleur);
     if (linestyle->style == '-') {
         gdImageLine(im_fig, x1, y1,   x2,   y2,\
-                   GetCouleur(im_fig, linestyle->color));
+                   linestyle->couleur);
     } else if (linestyle->style == ':') {
         gdImageDashedLine(im_fig, x1, y1,   x2,   y2,\
-                   GetCouleur(im_fig, linestyle->color));
+                   linestyle->couleur);
     } else {
 
     }
@@ -789,6 +1264,64 @@ void ImageLineEpaisseur(gdImagePtr im_fig,\
     // gdImageSetThickness(im_fig, 1);
 }
 
+/* --------------------------------------------------------------------------- */
+void ImagePolyligneEpaisseur(gdImagePtr im_fig, size_t nb_pts,\
+        const int x[], const int y[], const int orig[2], LineStyle *linestyle)
+{
+    if (nb_pts < 2 || (linestyle->style != '-' && linestyle->style != ':'))
+        return;
+
+    gdImageSetThickness(im_fig, linestyle->w);
+
+    size_t debut = 0;   /**< Index du 1er point du segment en cours */
+    int dx = 0, dy = 0; /**< Direction du segment en cours (0,0 : pas encore) */
+
+    for (size_t i = 1; i <= nb_pts; i++) {
+        int pas_x = 0, pas_y = 0;
+        if (i < nb_pts) {
+            pas_x = x[i] - x[i-1];
+            pas_y = y[i] - y[i-1];
+
+            // Point confondu avec le précédent
+            if (pas_x == 0 && pas_y == 0) continue;
+
+            // Premier pas, ou pas aligné et de même sens : le segment continue
+            if ((dx == 0 && dy == 0) || ((long)dx*pas_y == (long)dy*pas_x\
+                                            && dx*pas_x + dy*pas_y > 0)) {
+                if (dx == 0 && dy == 0) {
+                    dx = pas_x;
+                    dy = pas_y;
+                }
+                continue;
+            }
+        } else if (dx == 0 && dy == 0) {
+            // Courbe réduite à un point
+            break;
+        }
+
+        // Tracé du segment debut -> i-1
+        const int x1 = x[debut] + orig[0], y1 = y[debut] + orig[1];
+        const int x2 = x[i-1]   + orig[0], y2 = y[i-1]   + orig[1];
+        if (linestyle->style == '-') {
+            gdImageLine(im_fig, x1, y1, x2, y2, linestyle->couleur);
+        } else {
+            gdImageDashedLine(im_fig, x1, y1, x2, y2, linestyle->couleur);
+        }
+
+        // Jonction avec le segment suivant : carré de la section du trait
+        // (même emprise que les traits horizontaux et verticaux épais de gd)
+        if (i < nb_pts && linestyle->style == '-' && linestyle->w > 1) {
+            const int c = x2 - linestyle->w/2, l = y2 - linestyle->w/2;
+            gdImageFilledRectangle(im_fig, c, l,\
+                        c + linestyle->w-1, l + linestyle->w-1, linestyle->couleur);
+        }
+
+        debut = i-1;
+        dx = pas_x;
+        dy = pas_y;
+    }
+}
+
 
 /* --------------------------------------------------------------------------- */
 void Make_support_axes(Figure *fig, const int couleur[3])
@@ -798,13 +1331,13 @@ void Make_support_axes(Figure *fig, const int couleur[3])
     Init_linestyle(&linestyle_axe, '-', couleur, w_axes, ' ', 0);
 
     // axe vertical
-    ImageLineEpaisseur(fig->img,\
+    fig->backend->ligne(fig,\
                             fig->orig[0]-(w_axes-1), fig->orig[1]+(w_axes-1),\
                             fig->orig[0]-(w_axes-1), fig->padY[0],\
                             &linestyle_axe); 
 
     // axe horizontal
-    ImageLineEpaisseur(fig->img,\
+    fig->backend->ligne(fig,\
                             fig->orig[0]-(w_axes-1), fig->orig[1]+(w_axes-1),\
                             (fig->img->sx-1)-fig->padX[1],  fig->orig[1]+(w_axes-1),
                             &linestyle_axe); 
@@ -817,138 +1350,229 @@ void PlotPoint(Figure *fig, const int x1, const int y1,\
     if (x1 == fig->orig[0] && y1 != fig->orig[1])
     {   
         // Arc lorsque pt sur axe horizontal
-        gdImageFilledArc (fig->img, x1, y1, linestyle->ms, linestyle->ms,\
-                          -90, 90,\
-                          GetCouleur(fig->img, linestyle->color), gdArc);
+        fig->backend->secteur(fig, x1, y1, linestyle->ms, -90, 90,\
+                          linestyle->couleur);
     } else if (x1 != fig->orig[0] && y1 == fig->orig[1])
     {
         // Arc lorsque pt sur axe vertical
-        gdImageFilledArc (fig->img, x1, y1, linestyle->ms, linestyle->ms,\
-                          -180, 0,\
-                          GetCouleur(fig->img, linestyle->color), gdArc);
+        fig->backend->secteur(fig, x1, y1, linestyle->ms, -180, 0,\
+                          linestyle->couleur);
     } else if (x1 == fig->orig[0] && y1 == fig->orig[1])
     {
         // Arc lorsque pt sur l'origine
-        gdImageFilledArc (fig->img, x1, y1, linestyle->ms, linestyle->ms,\
-                          -90, 0,\
-                          GetCouleur(fig->img, linestyle->color), gdArc);
+        fig->backend->secteur(fig, x1, y1, linestyle->ms, -90, 0,\
+                          linestyle->couleur);
     } else {
-        gdImageFilledEllipse(fig->img, x1, y1,\
-            linestyle->ms, linestyle->ms, GetCouleur(fig->img, linestyle->color));
+        fig->backend->disque(fig, x1, y1, linestyle->ms, linestyle->couleur);
     }
 
 }
 
 /* --------------------------------------------------------------------------- */
-void PlotLine(Figure *fig, LineData *linedata)
+size_t Get_nb_pts_max(Figure *fig)
 {
-    int *x_plot = Transform_data_to_plot(fig, linedata->len_data, linedata->x, 'x');
-    int *y_plot = Transform_data_to_plot(fig, linedata->len_data, linedata->y, 'y');   
+    const int w_dessin = (fig->img->sx-1) - fig->orig[0] - fig->margin[0] - fig->padX[1];
 
-    for (int i=0; i < linedata->len_data-1; i++) 
-    {
-        ImageLineEpaisseur(fig->img,\
-                x_plot[i]   + fig->orig[0],   y_plot[i] + fig->orig[1],\
-                x_plot[i+1] + fig->orig[0], y_plot[i+1] + fig->orig[1],\
-                linedata->linestyle);
+    if (fig->pts_par_pixel <= 0 || w_dessin <= 0) return 0;
 
-        
-        /* PlotPoint(fig,\
-            x_plot[i] + fig->orig[0], y_plot[i] + fig->orig[1], linedata->linestyle);
+    return Max_int(3, fig->pts_par_pixel*w_dessin);
+}
+
+/* --------------------------------------------------------------------------- */
+size_t Lttb_sous_echantillonnage(size_t len_pts, int x[], int y[], size_t nb_pts)
+{
+    if (nb_pts < 3 || len_pts <= nb_pts) return len_pts;
+
+    // Largeur (en points) des intervalles entre le 1er et le dernier point
+    const double every = (double)(len_pts-2) / (nb_pts-2);
 
-        if (i == linedata->len_data-2) {
-            PlotPoint(fig,\
-                            x_plot[i+1] + fig->orig[0],\
-                            y_plot[i+1] + fig->orig[1],\
-                            linedata->linestyle);
-        } */
+    size_t a = 0;      /**< Index du dernier point gardé */
+    size_t k = 1;      /**< Position d'écriture (le point 0 reste en place) */
+
+    for (size_t i = 0; i < nb_pts-2; i++) {
+        // Moyenne de l'intervalle suivant (3e sommet du triangle)
+        size_t debut_suiv = (size_t)((i+1)*every) + 1;
+        size_t fin_suiv = Min_int((size_t)((i+2)*every) + 1, len_pts);
+        double x_moy = 0., y_moy = 0.;
+
+        for (size_t j = debut_suiv; j < fin_suiv; j++) {
+            x_moy += x[j];
+            y_moy += y[j];
+        }
+        x_moy /= (fin_suiv - debut_suiv);
+        y_moy /= (fin_suiv - debut_suiv);
+
+        // Point de l'intervalle courant formant le plus grand triangle
+        size_t debut = (size_t)(i*every) + 1;
+        size_t fin = (size_t)((i+1)*every) + 1;
+        double aire_max = -1.;
+        size_t i_max = debut;
+
+        for (size_t j = debut; j < fin; j++) {
+            double aire = fabs((x[a] - x_moy)*(y[j] - y[a]) \
+                                - (x[a] - x[j])*(y_moy - y[a]));
+            if (aire > aire_max) {
+                aire_max = aire;
+                i_max = j;
+            }
+        }
 
+        // Rangement en place : i_max >= debut >= k, et les intervalles 
+        // suivants ne sont pas encore écrasés
+        x[k] = x[i_max];
+        y[k] = y[i_max];
+        a = k++;
     }
 
-    free(x_plot);
-    free(y_plot);
+    x[k] = x[len_pts-1];
+    y[k] = y[len_pts-1];
+
+    return k+1;
+}
+
+/* --------------------------------------------------------------------------- */
+void PlotLine(Figure *fig, LineData *linedata)
+{
+    if (linedata->idx_dessin == SIZE_MAX) {
+        printf("Erreur : LineData \"%s\" non ajouté à la figure.\n", linedata->label);
+        exit(EXIT_FAILURE);
+    }
+    Transform_series_figure(fig);
+
+    const int *x_plot = fig->pts_dessin + linedata->idx_dessin;
+    const int *y_plot = x_plot + linedata->len_data;
+
+    fig->backend->polyligne(fig, linedata->len_dessin, x_plot, y_plot,\
+                                            fig->orig, linedata->linestyle);
+
+    /* for (int i=0; i < (int)linedata->len_dessin; i++) 
+        PlotPoint(fig,\
+            x_plot[i] + fig->orig[0], y_plot[i] + fig->orig[1], linedata->linestyle); */
 }
 
 /* --------------------------------------------------------------------------- */
 void PlotFLine(Figure *fig, fLineData *flinedata)
 {
-    int *x_plot = Transform_fdataX_to_plot(fig, flinedata->len_data, flinedata->x);
-    int *y_plot = Transform_fdataY_to_plot(fig, flinedata->len_data, flinedata->y);
+    if (flinedata->idx_dessin == SIZE_MAX) {
+        printf("Erreur : fLineData \"%s\" non ajouté à la figure.\n", flinedata->label);
+        exit(EXIT_FAILURE);
+    }
+    Transform_series_figure(fig);
 
-    for (int i=0; i < flinedata->len_data-1; i++) 
-    {
-        
-        ImageLineEpaisseur(fig->img,\
-                x_plot[i]   + fig->orig[0],   y_plot[i] + fig->orig[1],\
-                x_plot[i+1] + fig->orig[0], y_plot[i+1] + fig->orig[1],\
-                flinedata->linestyle);
+    const int *x_plot = fig->pts_dessin + flinedata->idx_dessin;
+    const int *y_plot = x_plot + flinedata->len_data;
 
-        
+    fig->backend->polyligne(fig, flinedata->len_dessin, x_plot, y_plot,\
+                                            fig->orig, flinedata->linestyle);
+
+    // Marqueurs, par dessus la courbe
+    for (int i=0; i < (int)flinedata->len_dessin; i++) 
         PlotPoint(fig,\
             x_plot[i] + fig->orig[0], y_plot[i] + fig->orig[1], flinedata->linestyle);
+}
 
-        if (i == flinedata->len_data-2) {
-            PlotPoint(fig,\
-                            x_plot[i+1] + fig->orig[0],\
-                            y_plot[i+1] + fig->orig[1],\
-                            flinedata->linestyle);
-        }
+/* --------------------------------------------------------------------------- */
+void Transform_series_figure(Figure *fig)
+{
+    if (fig->dessin_a_jour) return;
 
+    // Pas de recopie : toutes les coordonnées sont recalculées ci-dessous
+    if (fig->len_pts_dessin > fig->taille_pts_dessin) {
+        fig->pts_dessin = Alloc_arene(&fig->arene, fig->len_pts_dessin*sizeof(int));
+        fig->taille_pts_dessin = fig->len_pts_dessin;
     }
 
-    free(x_plot);
-    free(y_plot);
+    const size_t nb_pts_max = Get_nb_pts_max(fig);
+
+    for (size_t s = 0; s < fig->nb_linedata; s++) {
+        LineData *ld = fig->linedata[s];
+        int *x_plot = fig->pts_dessin + ld->idx_dessin;
+        int *y_plot = x_plot + ld->len_data;
+
+        Transform_dataX_to_plot(fig, ld->len_data, ld->x, x_plot);
+        Transform_udataY_to_plot(fig, ld->len_data, ld->y, y_plot);
+
+        // Sous-echantillonnage optionnel (LTTB) en coordonnées pixels
+        ld->len_dessin = Lttb_sous_echantillonnage(ld->len_data, x_plot, y_plot,\
+                                                                    nb_pts_max);
+    }
+
+    for (size_t s = 0; s < fig->nb_flinedata; s++) {
+        fLineData *fld = fig->flinedata[s];
+        int *x_plot = fig->pts_dessin + fld->idx_dessin;
+        int *y_plot = x_plot + fld->len_data;
+
+        Transform_fdataX_to_plot(fig, fld->len_data, fld->x, x_plot);
+        Transform_fdataY_to_plot(fig, fld->len_data, fld->y, y_plot);
+
+        fld->len_dessin = Lttb_sous_echantillonnage(fld->len_data, x_plot, y_plot,\
+                                                                    nb_pts_max);
+    }
+
+    for (size_t s = 0; s < fig->nb_bardata; s++) {
+        BarData *bd = fig->bardata[s];
+        Transform_data_to_plot_bar(fig, bd->nb_ctg, bd->nb_in_ctg,\
+                                            fig->pts_dessin + bd->idx_dessin);
+    }
+
+    fig->dessin_a_jour = 1;
 }
 
 /* --------------------------------------------------------------------------- */
-int *Transform_fdataX_to_plot(Figure *fig, size_t len_pts,\
-                                             const int pts[])
+void Transform_fdataX_to_plot(Figure *fig, size_t len_pts,\
+                                    const int pts[], int* pts_dessin)
 {
     // Taile de la zone de dessin
     // (Nx-1) - orig X (0) - margin X (0) - padX droite (1)
     const int w_dessin = (fig->img->sx-1) - fig->orig[0] - fig->margin[0] - fig->padX[1];
 
-    int *pts_dessin = malloc(len_pts * sizeof(int));
     int itv_pixels = (w_dessin) / (fig->max_X - pts[0]);
 
-    for (int i = 0; i < len_pts; i++) {
+    for (size_t i = 0; i < len_pts; i++) {
         // Decalage de l'origine au point initial (lorsque ne debute pas à 0)
-        pts_dessin[i] = i * itv_pixels;
-        // pts_dessin[i] = pts_dessin[i] - pts_dessin[0]; 
+        pts_dessin[i] = (int)i * itv_pixels;
         // printf("Point : %d, %d \n", i, pts_dessin[i]);
     }
-
-    return pts_dessin;
-
 }
 
 /* --------------------------------------------------------------------------- */
-int *Transform_fdataY_to_plot(Figure *fig, size_t len_pts, \
-                                    const float pts[])
+void Transform_fdataY_to_plot(Figure *fig, size_t len_pts, \
+                                    const float pts[], int* pts_dessin)
 {
     // Taile de la zone de dessin
     // Orig - padding haut (0) - margin Y (1)
     const int h_dessin = fig->orig[1] - fig->padY[0] - fig->margin[1];   
+    const float fmax_Y = fig->fmax_Y;
 
-    int *pts_dessin = malloc(len_pts * sizeof(float));
-
-    for (int i = 0; i < len_pts; i++) {
-        pts_dessin[i] = -(pts[i] * h_dessin) / fig->fmax_Y;
+    for (size_t i = 0; i < len_pts; i++) {
+        pts_dessin[i] = -(pts[i] * h_dessin) / fmax_Y;
         // printf("Point : %d, %d \n", i, pts_dessin[i]);
     }
+}
 
-    return pts_dessin;
+/* --------------------------------------------------------------------------- */
+void Transform_udataY_to_plot(Figure *fig, size_t len_pts, \
+                                    const uint16_t pts[], int* pts_dessin)
+{
+    // Taile de la zone de dessin
+    // Orig - padding haut (0) - margin Y (1)
+    const int h_dessin = fig->orig[1] - fig->padY[0] - fig->margin[1];   
+    const double max_Y = Max_int(fig->max_Y, 1);
+
+    // Division en double (vectorisable, contrairement à la division entière) : 
+    // pts*h_dessin est exact et le quotient tronqué est celui de la division 
+    // entière, les écarts aux entiers (>= 1/max_Y) dépassant l'arrondi
+    for (size_t i = 0; i < len_pts; i++) {
+        pts_dessin[i] = -(int)(((double)pts[i] * h_dessin) / max_Y);
+    }
 }
 
 
 /* --------------------------------------------------------------------------- */
-int *Transform_data_to_plot_bar(Figure *fig, size_t nb_ctg, \
-                                    const int pts[])
+void Transform_data_to_plot_bar(Figure *fig, size_t nb_ctg, \
+                                    const uint16_t pts[], int* y_dessin_ctg)
 {
     const int h_dessin = fig->orig[1] - fig->padY[0] - fig->margin[1];   
-    
-    // MALLOC
-    int *y_dessin_ctg = malloc(nb_ctg * sizeof(int));
 
     for (int i = 0; i < nb_ctg; i++) {
         if (i == 0)
@@ -956,8 +1580,6 @@ int *Transform_data_to_plot_bar(Figure *fig, size_t nb_ctg, \
         else
             y_dessin_ctg[i] = y_dessin_ctg[i-1] - (pts[i] * h_dessin) / fig->max_Y;
     }
-
-    return y_dessin_ctg;
 }      
 
 /* --------------------------------------------------------------------------- */
@@ -966,6 +1588,27 @@ void Change_font(Figure *fig, int textType, char* path_f)
     fig->fonts[textType].path = path_f;
 }
 
+/* --------------------------------------------------------------------------- */
+void Change_sous_echantillonnage(Figure *fig, int pts_par_pixel)
+{
+    fig->pts_par_pixel = pts_par_pixel;
+    fig->dessin_a_jour = 0;
+}
+
+/* --------------------------------------------------------------------------- */
+void Change_compression_png(Figure *fig, int niveau, int strategie, int nb_blocs)
+{
+    fig->niveau_png = niveau;
+    fig->strategie_png = strategie;
+    fig->nb_blocs_png = nb_blocs;
+}
+
+/* --------------------------------------------------------------------------- */
+void Change_palette_png(Figure *fig, char palette)
+{
+    fig->palette_png = palette;
+}
+
 /* --------------------------------------------------------------------------- */
 void Change_fontsize(Figure *fig, int textType, int size)
 {
@@ -977,14 +1620,20 @@ void Change_fontcolor(Figure *fig, int textType, int color[3])
 {
     for (int i = 0; i < 3; i++)
         fig->fonts[textType].color[i] = color[i];
+    fig->couleurs[coul_polices + textType] = Couleur_tc(color);
 }
 
 
 /* --------------------------------------------------------------------------- */
 void PlotBarplot(Figure *fig, BarData *bardata, char wlabels)
 {
-    int *y_bars = \
-        Transform_data_to_plot_bar(fig, bardata->nb_ctg, bardata->nb_in_ctg);   
+    if (bardata->idx_dessin == SIZE_MAX) {
+        printf("Erreur : BarData \"%s\" non ajouté à la figure.\n", bardata->label);
+        exit(EXIT_FAILURE);
+    }
+    Transform_series_figure(fig);
+
+    const int *y_bars = fig->pts_dessin + bardata->idx_dessin;
 
     // largeur zone de dessin
     int w_dessin = (fig->img->sx-1) - fig->orig[0] - fig->margin[0] - fig->padX[1];
@@ -1014,30 +1663,23 @@ void PlotBarplot(Figure *fig, BarData *bardata, char wlabels)
                 char nb_in_ctg[fig->max_Y]; // pas de surprises
                 sprintf(nb_in_ctg, "%d", bardata->nb_in_ctg[ctg]);
 
-                gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                            bardata->colors[ctg]),\
-                            fig->fonts[title_f].path,\
-                            fig->fonts[label_f].size,\
-                            0.,\
-                            posX_label,\
-                            posY_label,\
-                            nb_in_ctg);  
+                fig->backend->etiquette(fig, bardata->couleurs[ctg],\
+                                    fig->fonts[title_f].path,\
+                                    fig->fonts[label_f].size,\
+                                    posX_label, posY_label, nb_in_ctg);  
             }
 
             // Plot rect
-            gdImageFilledRectangle(fig->img, \
+            fig->backend->rectangle(fig, \
                 posX_center - itv_posX/4, y1_rect,\
                 posX_center + itv_posX/4, y2_rect,\
-                GetCouleur(fig->img, bardata->colors[ctg]));
+                bardata->couleurs[ctg]);
         }
 
         // Update y2=y1
         y2_rect = y1_rect;
 
     }
-
-    free(y_bars);
 }
 
 
@@ -1050,9 +1692,15 @@ void Transform_dataX_to_plot(Figure *fig, size_t len_pts,\
     // (Nx-1) - orig X (0) - margin X (0) - padX droite (1)
     const int w_dessin = (fig->img->sx-1) - fig->orig[0] - fig->margin[0] - fig->padX[1];
 
-    for (int i = 0; i < len_pts; i++)
+    const int x0 = pts[0];
+    const double itv_X = Max_int(fig->max_X - x0, 1);
+
+    for (size_t i = 0; i < len_pts; i++)
     {
-        pts_dessin[i] = ((pts[i]-pts[0]) * w_dessin) / (fig->max_X-pts[0]);
+        // Produit en double : ecart en secondes x largeur déborde d'un int 
+        // au dela de ~35 jours d'historique, mais reste exact en double (< 2^53).
+        // Le quotient tronqué est celui de la division entière (vectorisable)
+        pts_dessin[i] = (int)(((double)(pts[i]-x0) * w_dessin) / itv_X);
         // printf("Point : %d, %d \n", i, pts_dessin[i]);
     }
 
@@ -1074,38 +1722,84 @@ void Transform_dataY_to_plot(Figure *fig, size_t len_pts, \
 }
 
 /* --------------------------------------------------------------------------- */
-int *Transform_data_to_plot(Figure *fig, size_t len_pts,\
-                                  const int pts[], char direction)
+int GetCouleur(gdImagePtr im_fig, const int couleur[3])
 {
-    int *pts_dessin = malloc(len_pts * sizeof(int));
+    return gdImageColorAllocate(im_fig, couleur[0], couleur[1], couleur[2]);
+}
 
-    if (pts_dessin == NULL) {
-        printf("Erreur : Pas assez de memoire.\n");
-        free(pts_dessin);
-        exit(EXIT_FAILURE);
-    }    
+/* --------------------------------------------------------------------------- */
+void Maj_couleurs_figure(Figure *fig)
+{
+    fig->couleurs[coul_fond] = Couleur_tc(fig->color_bg);
+    fig->couleurs[coul_cvs]  = Couleur_tc(fig->color_cvs_bg);
 
-    // Taile de la zone de dessin
-    if (direction == 'x') {
-        Transform_dataX_to_plot(fig, len_pts, pts, pts_dessin);
-    } else if (direction == 'y')
-    {
-        Transform_dataY_to_plot(fig, len_pts, pts, pts_dessin);
-    }
-    else 
-    {
-        printf("Erreur : Direction de tracé inconnue.\n");
-        free(pts_dessin);
-        exit(EXIT_FAILURE);
-    }
-    
-    return pts_dessin;
+    for (int f = 0; f < nb_fonts; f++)
+        fig->couleurs[coul_polices + f] = Couleur_tc(fig->fonts[f].color);
+
+    for (int bp = 0; bp < NB_COULEURS_LIGNES; bp++)
+        fig->couleurs[coul_lignes + bp] = Couleur_tc(color_lines[bp]);
 }
 
 /* --------------------------------------------------------------------------- */
-int GetCouleur(gdImagePtr im_fig, const int couleur[3])
+// Sprites des marqueurs, partagés par toutes les figures du process
+static Marqueur sprites_marqueurs[MARQUEURS_NB_MAX];
+static int nb_marqueurs = 0;
+static pthread_mutex_t mutex_marqueurs = PTHREAD_MUTEX_INITIALIZER;
+
+/* --------------------------------------------------------------------------- */
+void Init_cache_polices(void)
 {
-    return gdImageColorAllocate(im_fig, couleur[0], couleur[1], couleur[2]);
+    if (gdFontCacheSetup() != 0)
+        printf("> Warning: initialisation du cache des polices impossible.\n");
+}
+
+/* --------------------------------------------------------------------------- */
+void Free_cache_polices(void)
+{
+    for (int m = 0; m < nb_marqueurs; m++)
+        gdImageDestroy(sprites_marqueurs[m].img);
+    nb_marqueurs = 0;
+
+    gdFontCacheShutdown();
+}
+
+/* --------------------------------------------------------------------------- */
+void ImageDisqueSprite(gdImagePtr im_fig, int x, int y, int diametre, int couleur)
+{
+    const int r = diametre/2;
+    Marqueur *mrq = NULL;
+
+    pthread_mutex_lock(&mutex_marqueurs);
+    for (int m = 0; m < nb_marqueurs; m++) {
+        if (sprites_marqueurs[m].diametre == diametre\
+                && sprites_marqueurs[m].couleur == couleur) {
+            mrq = &(sprites_marqueurs[m]);
+            break;
+        }
+    }
+
+    if (mrq == NULL && nb_marqueurs < MARQUEURS_NB_MAX) {
+        gdImagePtr img = gdImageCreateTrueColor(2*r+1, 2*r+1);
+        if (img != NULL) {
+            // Fond transparent : seuls les pixels du disque sont copiés
+            gdImageAlphaBlending(img, 0);
+            gdImageFilledRectangle(img, 0, 0, 2*r, 2*r, gdAlphaMax << 24);
+            gdImageFilledEllipse(img, r, r, diametre, diametre, couleur);
+
+            mrq = &(sprites_marqueurs[nb_marqueurs++]);
+            mrq->diametre = diametre;
+            mrq->couleur = couleur;
+            mrq->img = img;
+        }
+    }
+    pthread_mutex_unlock(&mutex_marqueurs);
+
+    if (mrq == NULL) {
+        gdImageFilledEllipse(im_fig, x, y, diametre, diametre, couleur);
+        return;
+    }
+
+    gdImageCopy(im_fig, mrq->img, x - r, y - r, 0, 0, 2*r+1, 2*r+1);
 }
 
 /* --------------------------------------------------------------------------- */
@@ -1167,6 +1861,10 @@ void Init_figure(Figure *fig, int figsize[2],\
     // fig.fonts[1] = "/usr/share/fonts/lato/Lato-Medium.ttf";
     // fig.fonts[2] = "/usr/share/fonts/lato/Lato-LightItalic.ttf";
 
+    Maj_couleurs_figure(fig);
+    fig->backend = &backend_gd;
+    fig->donnees_backend = NULL;
+    fig->axes = wAxes;
     Make_background(fig, fig->color_bg, fig->color_cvs_bg);
     if ( wAxes == 'y')
         Make_support_axes(fig, fig->color_axes);
@@ -1182,6 +1880,21 @@ void Init_figure(Figure *fig, int figsize[2],\
     fig->max_X = 0;
     fig->max_Y = 0;
     fig->fmax_Y = 0.;
+    fig->pts_par_pixel = 0;
+    fig->niveau_png = 5;
+    fig->strategie_png = Z_DEFAULT_STRATEGY;
+    fig->nb_blocs_png = 0;
+    fig->palette_png = 'y';
+
+    fig->pts_dessin = NULL;
+    fig->len_pts_dessin = 0;
+    fig->taille_pts_dessin = 0;
+    fig->dessin_a_jour = 0;
+
+    fig->cap_linedata = 0;
+    fig->cap_flinedata = 0;
+    fig->cap_bardata = 0;
+    Init_arene(&fig->arene, 0);
 }
 
 /* --------------------------------------------------------------------------- */
@@ -1191,6 +1904,7 @@ void Change_fig_bg(Figure *fig, int color[3])
     {
         fig->color_bg[i] = color[i];
     }
+    fig->couleurs[coul_fond] = Couleur_tc(color);
     Make_background(fig, fig->color_bg, fig->color_cvs_bg);                                           
 }
 
@@ -1201,6 +1915,7 @@ void Change_fig_cvs_bg(Figure *fig, int color[3])
     {
         fig->color_cvs_bg[i] = color[i];        
     }
+    fig->couleurs[coul_cvs] = Couleur_tc(color);
     Make_background(fig, fig->color_bg, fig->color_cvs_bg);
 }
 
@@ -1216,7 +1931,7 @@ void Change_fig_axes_color(Figure *fig, int color[3])
 
 /* --------------------------------------------------------------------------- */
 void Init_bardata(BarData *bardata, int nb_ctg, char *labels_ctg[nb_ctg],\
-                    int nb_tot, int nb_in_ctg[nb_ctg], \
+                    int nb_tot, uint16_t nb_in_ctg[nb_ctg], \
                         int colors[nb_ctg][3], char* label)
 {
     bardata->nb_ctg = nb_ctg;
@@ -1226,11 +1941,20 @@ void Init_bardata(BarData *bardata, int nb_ctg, char *labels_ctg[nb_ctg],\
     bardata->colors = colors;
     bardata->label = label;
 
+    if (nb_ctg > NB_COULEURS_CTG) {
+        printf("Erreur : %d categories pour %d couleurs max.\n", nb_ctg,\
+                                                            NB_COULEURS_CTG);
+        exit(EXIT_FAILURE);
+    }
+    for (int ctg = 0; ctg < nb_ctg; ctg++)
+        bardata->couleurs[ctg] = Couleur_tc(colors[ctg]);
+
     bardata->idx = 0;
+    bardata->idx_dessin = SIZE_MAX;
 }
 
 /* --------------------------------------------------------------------------- */
-void Init_linedata(LineData *linedata, int len_data, int ptx[], int pty[],
+void Init_linedata(LineData *linedata, int len_data, int ptx[], const uint16_t pty[],
                     char* label, LineStyle *linestyle)
 {
     // int *ptx_plot = Transform_data_to_plot(fig, len_data, ptx, 'x');
@@ -1240,9 +1964,11 @@ void Init_linedata(LineData *linedata, int len_data, int ptx[], int pty[],
     linedata->x = ptx; 
     linedata->y = pty;
     linedata->max_X = Maxval_array(linedata->x, linedata->len_data);
-    linedata->max_Y = Maxval_array(linedata->y, linedata->len_data);
+    linedata->max_Y = uMaxval_array(linedata->y, linedata->len_data);
     linedata->label = label;
     linedata->linestyle = linestyle;
+    linedata->idx_dessin = SIZE_MAX;
+    linedata->len_dessin = 0;
     // print_arr1D(len_data, linedata->y, 'n');
 }
 
@@ -1259,6 +1985,8 @@ void Init_flinedata(fLineData *flinedata, int len_data, int ptx[], float pty[],
     flinedata->fmax_Y = fMaxval_array(flinedata->y, flinedata->len_data);
     flinedata->label = label;
     flinedata->linestyle = linestyle;
+    flinedata->idx_dessin = SIZE_MAX;
+    flinedata->len_dessin = 0;
 
     // print_arr1D(len_data, linedata->y, 'n');
 }
@@ -1272,6 +2000,7 @@ void Init_linestyle(LineStyle *linestyle, char style,\
     {
         linestyle->color[i] = color[i];
     }    
+    linestyle->couleur = Couleur_tc(color);
     linestyle->w = width;
     linestyle->marker = marker;
     linestyle->ms = ms;
@@ -1317,7 +2046,9 @@ void Print_debug_ld(LineData *linedata, char w_xy)
         printf("* Vecteur X : \n");
         print_arr1D(linedata->len_data, linedata->x, 'n');
         printf("* Vecteur Y : \n");
-        print_arr1D(linedata->len_data, linedata->y, 'n');
+        for (size_t i = 0; i < linedata->len_data; i++)
+            printf("%d, ", linedata->y[i]);
+        printf("\n");
     }    
     Print_debug_ls(linedata->linestyle);
     printf("*** End linedata ----------------------------\n\n");
@@ -1383,18 +2114,23 @@ int Min_int(int x, int y)
 /* --------------------------------------------------------------------------- */
 void Add_line_to_fig(Figure *fig, LineData *linedata)
 {
-    fig->nb_linedata++;
-    fig->linedata = (LineData **)realloc(fig->linedata, fig->nb_linedata*sizeof(LineData));
-
-    if (fig->linedata == NULL) {
-        printf("Erreur : Pas assez de memoire.\n");
-        free(fig->linedata);
-        exit(EXIT_FAILURE);
+    // Croissance par doublement dans l'arène de la figure
+    if (fig->nb_linedata == fig->cap_linedata) {
+        size_t cap = (fig->cap_linedata == 0) ? 8 : 2*fig->cap_linedata;
+        fig->linedata = Realloc_arene(&fig->arene, fig->linedata,\
+                        fig->cap_linedata*sizeof(LineData *), cap*sizeof(LineData *));
+        fig->cap_linedata = cap;
     }
+    fig->nb_linedata++;
 
     // Index = nb line - 1 : on remplit les linedata de la figure
     fig->linedata[fig->nb_linedata-1] = linedata;
 
+    // Place réservée dans le tableau des coordonnées pixels (X puis Y)
+    linedata->idx_dessin = fig->len_pts_dessin;
+    fig->len_pts_dessin += 2*linedata->len_data;
+    fig->dessin_a_jour = 0;
+
     // Print_debug_ld(fig->linedata[fig->nb_linedata]);
 
     fig->max_X = Max_int(fig->max_X, linedata->max_X);
@@ -1406,18 +2142,23 @@ void Add_line_to_fig(Figure *fig, LineData *linedata)
 /* --------------------------------------------------------------------------- */
 void Add_fline_to_fig(Figure *fig, fLineData *flinedata)
 {
-    fig->nb_flinedata++;
-    fig->flinedata = (fLineData **)realloc(fig->flinedata, fig->nb_flinedata*sizeof(fLineData));
-
-    if (fig->flinedata == NULL) {
-        printf("Erreur : Pas assez de memoire.\n");
-        free(fig->flinedata);
-        exit(EXIT_FAILURE);
+    // Croissance par doublement dans l'arène de la figure
+    if (fig->nb_flinedata == fig->cap_flinedata) {
+        size_t cap = (fig->cap_flinedata == 0) ? 8 : 2*fig->cap_flinedata;
+        fig->flinedata = Realloc_arene(&fig->arene, fig->flinedata,\
+                        fig->cap_flinedata*sizeof(fLineData *), cap*sizeof(fLineData *));
+        fig->cap_flinedata = cap;
     }
+    fig->nb_flinedata++;
 
     // Index = nb line - 1 : on remplit les linedata de la figure
     fig->flinedata[fig->nb_flinedata-1] = flinedata;
 
+    // Place réservée dans le tableau des coordonnées pixels (X puis Y)
+    flinedata->idx_dessin = fig->len_pts_dessin;
+    fig->len_pts_dessin += 2*flinedata->len_data;
+    fig->dessin_a_jour = 0;
+
     // Print_debug_ld(fig->linedata[fig->nb_linedata]);
 
     fig->max_X = Max_int(fig->max_X, flinedata->max_X);
@@ -1427,14 +2168,14 @@ void Add_fline_to_fig(Figure *fig, fLineData *flinedata)
 /* --------------------------------------------------------------------------- */
 void Add_barplot_to_fig(Figure *fig, BarData *bardata)
 {
-    fig->nb_bardata++;
-    fig->bardata = (BarData **)realloc(fig->bardata, fig->nb_bardata*sizeof(BarData));
-
-    if (fig->bardata== NULL) {
-        printf("Erreur : Pas assez de memoire.\n");
-        free(fig->bardata);
-        exit(EXIT_FAILURE);
+    // Croissance par doublement dans l'arène de la figure
+    if (fig->nb_bardata == fig->cap_bardata) {
+        size_t cap = (fig->cap_bardata == 0) ? 8 : 2*fig->cap_bardata;
+        fig->bardata = Realloc_arene(&fig->arene, fig->bardata,\
+                        fig->cap_bardata*sizeof(BarData *), cap*sizeof(BarData *));
+        fig->cap_bardata = cap;
     }
+    fig->nb_bardata++;
 
     // Index = nb line - 1 : on remplit les linedata de la figure
     fig->bardata[fig->nb_bardata-1] = bardata;
@@ -1444,6 +2185,11 @@ void Add_barplot_to_fig(Figure *fig, BarData *bardata)
     fig->max_Y = Max_int(fig->max_Y, bardata->nb_tot);
 
     bardata->idx = fig->nb_bardata; // On update l'index du bardata, pour posX
+
+    // Place réservée dans le tableau des coordonnées pixels (Y cumulés)
+    bardata->idx_dessin = fig->len_pts_dessin;
+    fig->len_pts_dessin += bardata->nb_ctg;
+    fig->dessin_a_jour = 0;
 }
 
 /* --------------------------------------------------------------------------- */
@@ -1456,15 +2202,12 @@ void Make_annotation(Figure *fig, char* text,\
     int posY_xlabel = (fig->img->sy-1) - 5 - decalage_Y; 
 
     // int brect[8] = {0};
-    gdImageStringFT(fig->img, NULL,\
-                    GetCouleur(fig->img,
-                    fig->fonts[annotation_f].color),\
+    fig->backend->texte(fig, NULL,\
+                    fig->couleurs[coul_polices + annotation_f],\
                     fig->fonts[annotation_f].path,\
                     fig->fonts[annotation_f].size,\
                     0., posX_xlabel, posY_xlabel, text);
 
-    //Avoid memory leaks
-    gdFontCacheShutdown();
     // printf("%s \n", errStringFT); 
 }
 
@@ -1479,14 +2222,11 @@ void Make_subtitle(Figure *fig, char* subtitle,\
     int posY_subtitle = bbox_title[1] + fig->fonts[subtitle_f].size \
                     + ecartY_title - decalage_Y; 
 
-    gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                                fig->fonts[subtitle_f].color),
+    fig->backend->texte(fig, NULL,\
+                            fig->couleurs[coul_polices + subtitle_f],
                             fig->fonts[subtitle_f].path,\
                             fig->fonts[subtitle_f].size,\
                             0., posX_subtitle, posY_subtitle, subtitle);    
-    //Avoid memory leaks
-    gdFontCacheShutdown();
 }
 
 /* --------------------------------------------------------------------------- */
@@ -1515,15 +2255,13 @@ int *Make_title(Figure *fig, char* title,\
                         * fig->fonts[title_f].size/3.7) + decalage_X;
     int posY_xlabel = fig->img->sy - (fig->padY[1] - 3*fig->padY[1]/4) - decalage_Y; 
 
-    static int brect_title[8] = {0};
-    gdImageStringFT(fig->img, brect_title,\
-                            GetCouleur(fig->img,\
-                                fig->fonts[title_f].color),\
+    // Un exemplaire par thread : figures tracées en parallèle
+    static _Thread_local int brect_title[8] = {0};
+    fig->backend->texte(fig, brect_title,\
+                            fig->couleurs[coul_polices + title_f],\
                             fig->fonts[title_f].path,\
                             fig->fonts[title_f].size,\
                             0., posX_xlabel, posY_xlabel, title);    
-    //Avoid memory leaks
-    gdFontCacheShutdown();
     // printf("%s \n", errStringFT); 
 
     return brect_title;
@@ -1543,14 +2281,11 @@ void Make_xlabel(Figure *fig, char* xlabel,\
     int posY_xlabel = fig->img->sy - (fig->padY[1] - fig->padY[1]/3) + decalage_Y; 
 
     // int brect[8] = {0};
-    gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                                fig->fonts[label_f].color),\
+    fig->backend->texte(fig, NULL,\
+                            fig->couleurs[coul_polices + label_f],\
                             fig->fonts[label_f].path,\
                             fig->fonts[label_f].size,\
                             0., posX_xlabel, posY_xlabel, xlabel);    
-    //Avoid memory leaks
-    gdFontCacheShutdown();
     // printf("%s \n", errStringFT); 
 }
 
@@ -1568,9 +2303,8 @@ void Make_ylabel(Figure *fig, char* ylabel,\
                              + decalage_Y;   
 
     int brect[8] = {0};
-    char *errStringFT = gdImageStringFT(fig->img, brect,\
-                            GetCouleur(fig->img,\
-                            fig->fonts[label_f].color),
+    char *errStringFT = fig->backend->texte(fig, brect,\
+                            fig->couleurs[coul_polices + label_f],
                             fig->fonts[label_f].path,\
                             fig->fonts[label_f].size,\
                             Deg2rad(90.), posX_ylabel, posY_ylabel, ylabel);    
@@ -1578,8 +2312,6 @@ void Make_ylabel(Figure *fig, char* ylabel,\
     if (errStringFT != NULL)
         printf("> Warning: police introuvable ou autre probleme police.\n");
 
-    //Avoid memory leaks
-    gdFontCacheShutdown();
 }
 
 /* --------------------------------------------------------------------------- */
@@ -1612,17 +2344,16 @@ void Make_legend_barplot(Figure *fig,\
 
     for (int i = 0; i < fig->bardata[0]->nb_ctg ; i++) {
         // Plot petits rectangles legendes
-        gdImageFilledRectangle(fig->img,\
+        fig->backend->rectangle(fig,\
                     pos_X[i], pos_Y[i]-h_rect,\
                     pos_X[i]+l_rect, pos_Y[i],\
-                    GetCouleur(fig->img, fig->bardata[0]->colors[i]));
+                    fig->bardata[0]->couleurs[i]);
 
         // Labels
         posX_label = pos_X[i]+l_rect+10;
         posY_label = pos_Y[i] ;
-        gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                            fig->fonts[leg_f].color),
+        fig->backend->texte(fig, NULL,\
+                            fig->couleurs[coul_polices + leg_f],
                             fig->fonts[leg_f].path,\
                             fig->fonts[leg_f].size,\
                             0, posX_label, posY_label,\
@@ -1669,7 +2400,7 @@ void Make_legend(Figure *fig,\
         /* Pour les LineData*/
         // Print des petits traits de legende pour chaque plot
         for (int i = 0; i < fig->nb_linedata; i++) { 
-            ImageLineEpaisseur(fig->img,\
+            fig->backend->ligne(fig,\
                         pos_X[i],\
                         pos_Y[i] - fig->fonts[leg_f].size/2,\
                         pos_X[i] + long_trait_leg,\
@@ -1679,9 +2410,8 @@ void Make_legend(Figure *fig,\
 
         for (int i = 0; i < fig->nb_linedata; i++)
         {
-            errStringFT=gdImageStringFT(fig->img, brect,\
-                                GetCouleur(fig->img,\
-                                    fig->fonts[leg_f].color),\
+            errStringFT = fig->backend->texte(fig, brect,\
+                                fig->couleurs[coul_polices + leg_f],\
                                 fig->fonts[leg_f].path,\
                                 fig->fonts[leg_f].size,\
                                 0.,\
@@ -1699,7 +2429,7 @@ void Make_legend(Figure *fig,\
         /* Pour les FLineData*/
         // Print des petits traits de legende pour chaque plot
         for (int i = 0; i < fig->nb_flinedata; i++) { 
-            ImageLineEpaisseur(fig->img,\
+            fig->backend->ligne(fig,\
                         pos_X[i],\
                         pos_Y[i] - fig->fonts[leg_f].size/2,\
                         pos_X[i] + long_trait_leg,\
@@ -1710,9 +2440,8 @@ void Make_legend(Figure *fig,\
 
         for (int i = 0; i < fig->nb_flinedata; i++)
         {
-            errStringFT= gdImageStringFT(fig->img, brect,\
-                                GetCouleur(fig->img,\
-                                    fig->fonts[leg_f].color),\
+            errStringFT = fig->backend->texte(fig, brect,\
+                                fig->couleurs[coul_polices + leg_f],\
                                 fig->fonts[leg_f].path,\
                                 fig->fonts[leg_f].size,\
                                 0.,\
@@ -1726,8 +2455,6 @@ void Make_legend(Figure *fig,\
         }        
 
     }
-    //Avoid memory leaks
-    gdFontCacheShutdown();
 }
 
 
@@ -1765,7 +2492,7 @@ void Make_xticks_barplot(Figure *fig, float angle_labels)
         posX_center = fig->orig[0] + fig->bardata[bp]->idx * itv_posX;
 
         // plot tick
-        ImageLineEpaisseur(fig->img,\
+        fig->backend->ligne(fig,\
                         posX_center,\
                         fig->orig[1]+2,\
                         posX_center,\
@@ -1774,10 +2501,10 @@ void Make_xticks_barplot(Figure *fig, float angle_labels)
         
 
         // tick label
-        // Fake call : recuperation du brect sur le label horizontal
-        // On ecrit en 0,0
-        gdImageStringFT(fig->img, brect,\
-                            GetCouleur(fig->img, fig->color_bg),\
+        // Mesure seule (image NULL) : recuperation du brect sur le label 
+        // horizontal, rien n'est dessiné
+        gdImageStringFT(NULL, brect,\
+                            fig->couleurs[coul_fond],\
                             fig->fonts[ticklabel_f].path,\
                             fig->fonts[ticklabel_f].size, 0.,\
                             0, 0,\
@@ -1789,9 +2516,8 @@ void Make_xticks_barplot(Figure *fig, float angle_labels)
         posX_label = (int)(len_label_px * cos(Deg2rad(angle_labels)));
         posY_label = (int)(len_label_px * sin(Deg2rad(angle_labels)));
 
-        gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                                    color_lines[bp]),\
+        fig->backend->texte(fig, NULL,\
+                            fig->couleurs[coul_lignes + bp],\
                             fig->fonts[ticklabel_f].path,\
                             fig->fonts[ticklabel_f].size,\
                             Deg2rad(angle_labels),\
@@ -1801,9 +2527,6 @@ void Make_xticks_barplot(Figure *fig, float angle_labels)
 
     }
 
-    //Avoid memory leaks
-    gdFontCacheShutdown();
-
 }
 
 /* --------------------------------------------------------------------------- */
@@ -1846,7 +2569,7 @@ void Make_xticks_xgrid_time_avgH(Figure *fig, int nb_ticks,\
         // printf("Tick : %d \n", i);
 
         // tick
-        ImageLineEpaisseur(fig->img,\
+        fig->backend->ligne(fig,\
                         fig->orig[0] + i*itv_pixels,\
                         fig->orig[1]+2,\
                         fig->orig[0] + i*itv_pixels,\
@@ -1854,7 +2577,7 @@ void Make_xticks_xgrid_time_avgH(Figure *fig, int nb_ticks,\
                         &style_tick);
 
         //gridline
-        ImageLineEpaisseur(fig->img,\
+        fig->backend->ligne(fig,\
                         fig->orig[0] + i*itv_pixels,\
                         fig->orig[1],\
                         fig->orig[0] + i*itv_pixels,\
@@ -1871,20 +2594,14 @@ void Make_xticks_xgrid_time_avgH(Figure *fig, int nb_ticks,\
                 (long_tick+10) + fig->fonts[ticklabel_f].size;
         // tick label date
         if (fig->flinedata[0]->x[i]%2 != 0) {
-        gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                                fig->fonts[ticklabel_f].color),\
+        fig->backend->etiquette(fig, fig->couleurs[coul_polices + ticklabel_f],\
                             fig->fonts[ticklabel_f].path,\
                             fig->fonts[ticklabel_f].size,\
-                            0.,\
                             xlabel_date, ylabel_date, tickAvgH);
         }
         
     }
 
-    //Avoid memory leaks
-    gdFontCacheShutdown();
-
 }
 
 /* --------------------------------------------------------------------------- */
@@ -1908,7 +2625,7 @@ void Make_xticks_xgrid_time(Figure *fig, Date date_init)
     int l_max = l_canvas - fig->margin[0];
 
     // Intervalle entre 2 ticks en pix
-    int itv_pixels = (itv_sec*l_max) / fig->max_X;
+    int itv_pixels = ((long long)itv_sec*l_max) / fig->max_X;
     // printf("Itv X en px = %d \n", itv_pixels);
 
     // Style tick
@@ -1929,7 +2646,7 @@ void Make_xticks_xgrid_time(Figure *fig, Date date_init)
         // printf("Tick : %d \n", i);
 
         // tick
-        ImageLineEpaisseur(fig->img,\
+        fig->backend->ligne(fig,\
                         fig->orig[0] + i*itv_pixels,\
                         fig->orig[1]+2,\
                         fig->orig[0] + i*itv_pixels,\
@@ -1937,22 +2654,19 @@ void Make_xticks_xgrid_time(Figure *fig, Date date_init)
                         &style_tick);
 
         //gridline
-        ImageLineEpaisseur(fig->img,\
+        fig->backend->ligne(fig,\
                         fig->orig[0] + i*itv_pixels,\
                         fig->orig[1],\
                         fig->orig[0] + i*itv_pixels,\
                         fig->padY[0],\
                         &style_linegrid);        
 
-        #if defined(LENOVO) || defined(QEMU)
-            time_t t_tick = date_init.ctime + i*itv_sec + 3600; // hack ajout 1h
-        #else
-            time_t t_tick = date_init.ctime + i*itv_sec;
-        #endif
+        // Heure murale du tick (voir DECALAGE_DATES_SEC dans traitement.h)
+        time_t t_tick = date_init.ctime + (time_t)i*itv_sec + DECALAGE_DATES_SEC;
 
+        struct tm tm_buf;
         struct tm *tm_tick;
-        gmtime(&t_tick);
-        tm_tick = gmtime(&t_tick);
+        tm_tick = gmtime_r(&t_tick, &tm_buf);
 
         char tickdate[6];
         strftime(tickdate, 6, "%d/%m", tm_tick);
@@ -1966,30 +2680,22 @@ void Make_xticks_xgrid_time(Figure *fig, Date date_init)
         int xlabel_date = fig->padX[0]/2 -10 + i*itv_pixels;
         int ylabel_date = fig->orig[1] + (long_tick+2) + fig->fonts[ticklabel_f].size;
         // tick label date
-        gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                                fig->fonts[ticklabel_f].color),\
+        fig->backend->etiquette(fig, fig->couleurs[coul_polices + ticklabel_f],\
                             fig->fonts[ticklabel_f].path,\
                             fig->fonts[ticklabel_f].size,\
-                            0.,\
                             xlabel_date, ylabel_date, tickdate);
 
         int xlabel_hour = fig->padX[0]/2 -10 + i*itv_pixels + fig->fonts[ticklabel_f].size/2;
         int ylabel_hour = fig->orig[1] + 2*((long_tick) + fig->fonts[ticklabel_f].size);
         // tick label heure
-        gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                                fig->fonts[ticklabel_f].color),\
+        fig->backend->etiquette(fig, fig->couleurs[coul_polices + ticklabel_f],\
                             fig->fonts[ticklabel_f].path,\
                             fig->fonts[ticklabel_f].size,\
-                            0.,xlabel_hour, ylabel_hour, tickhour);
+                            xlabel_hour, ylabel_hour, tickhour);
                                 
         // printf("%d\n", i);
     }
 
-    //Avoid memory leaks
-    gdFontCacheShutdown();
-
 }
 
 
@@ -2044,7 +2750,7 @@ void Make_fyticks_ygrid(Figure *fig, char wTicks)
 
     for (int i = 1; i <= nb_ticks; i++) {
         // gridline
-        ImageLineEpaisseur(fig->img,\
+        fig->backend->ligne(fig,\
                         fig->orig[0],\
                             fig->orig[1] - i*(itv_pixels+0.5),\
                         (fig->img->sx-1) - fig->padX[1],\
@@ -2055,7 +2761,7 @@ void Make_fyticks_ygrid(Figure *fig, char wTicks)
         if (wTicks == 'y') {
             long_tick = 9;
             // tick : facteur 0.5 ajouté pour gerer les nombres pairs/impais de px
-            ImageLineEpaisseur(fig->img,\
+            fig->backend->ligne(fig,\
                             fig->orig[0]-long_tick-2,\
                                 fig->orig[1] - i*(itv_pixels+0.5),\
                             fig->orig[0]-2,\
@@ -2077,17 +2783,13 @@ void Make_fyticks_ygrid(Figure *fig, char wTicks)
         // printf("%s \n",fig->fonts[ticklabel_f].path);
         // printf("%d \n",fig->fonts[ticklabel_f].size);
 
-        gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                                    style_tick.color),\
+        fig->backend->etiquette(fig, style_tick.couleur,\
                             fig->fonts[ticklabel_f].path,\
                             fig->fonts[ticklabel_f].size,\
-                                0., posX_ticklab, posY_ticklab, tickVal);
+                            posX_ticklab, posY_ticklab, tickVal);
 
     }
 
-    //Avoid memory leaks
-    gdFontCacheShutdown();
 }
 
 /* --------------------------------------------------------------------------- */
@@ -2164,7 +2866,7 @@ void Make_yticks_ygrid(Figure *fig, char wTicks)
 
 
         // gridline
-        ImageLineEpaisseur(fig->img,\
+        fig->backend->ligne(fig,\
                         fig->orig[0],\
                             fig->orig[1] - i*(itv_pixels+0.5),\
                         (fig->img->sx-1) - fig->padX[1],\
@@ -2175,7 +2877,7 @@ void Make_yticks_ygrid(Figure *fig, char wTicks)
             long_tick = 9;
             long_tick_min = 5;
             // tick : facteur 0.5 ajouté pour gerer les nombres pairs/impais de px
-            ImageLineEpaisseur(fig->img,\
+            fig->backend->ligne(fig,\
                             fig->orig[0]-long_tick-2,\
                                 fig->orig[1] - i*(itv_pixels+0.5),\
                             fig->orig[0]-2,\
@@ -2188,7 +2890,7 @@ void Make_yticks_ygrid(Figure *fig, char wTicks)
                 {
                     int itv_ytickmin = fig->orig[1] - (i-1)*itv_pixels - j*(itv_pixels/(nb_ticks_min));
                     
-                    ImageLineEpaisseur(fig->img,\
+                    fig->backend->ligne(fig,\
                                     fig->orig[0]-long_tick_min-2,\
                                         itv_ytickmin,\
                                     fig->orig[0]-2,\
@@ -2203,17 +2905,13 @@ void Make_yticks_ygrid(Figure *fig, char wTicks)
         int posY_ticklab = fig->orig[1] - i*itv_pixels \
                             + fig->fonts[ticklabel_f].size / 2;
 
-        gdImageStringFT(fig->img, NULL,\
-                            GetCouleur(fig->img,\
-                                    style_tick.color),\
+        fig->backend->etiquette(fig, style_tick.couleur,\
                             fig->fonts[ticklabel_f].path,\
                             fig->fonts[ticklabel_f].size,\
-                                0., posX_ticklab, posY_ticklab, tickVal);
+                            posX_ticklab, posY_ticklab, tickVal);
 
     }
 
-    //Avoid memory leaks
-    gdFontCacheShutdown();
 }
 
 #endif /* PLOTTER_H */
\ No newline at end of file
@@ -0,0 +1,238 @@
+/* ----------------------------------------------------------------------------
+*  Bibliotheque definissant un petit pool de threads (pthread) : des taches
+*  indépendantes (ex : une figure chacune) sont mises en file et exécutées
+*  par nb_threads workers. Avec 0 thread, chaque tache est exécutée
+*  directement à l'ajout (mode série, pour le debug).
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * @brief Nombre max de taches en attente dans la file d'un pool
+ *
+ */
+#define POOL_NB_TACHES_MAX 16
+
+/**
+ * @brief Nombre max de threads d'un pool
+ *
+ */
+#define POOL_NB_THREADS_MAX 8
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Tache du pool : fonction appelée avec son argument
+ *
+ */
+typedef struct Tache_s {
+    void (*fonction)(void *arg);  /**< Fonction à exécuter */
+    void *arg;                    /**< Argument de la fonction */
+} Tache;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Pool de threads : file circulaire de taches protégée par un mutex,
+ * les workers attendent sur une condition tant que la file est vide.
+ *
+ */
+typedef struct PoolTaches_s {
+    pthread_t threads[POOL_NB_THREADS_MAX]; /**< Workers */
+    int nb_threads;                 /**< Nombre de workers (0 : mode série) */
+    Tache file[POOL_NB_TACHES_MAX]; /**< File des taches en attente */
+    int debut;                      /**< Index de la prochaine tache à exécuter */
+    int nb_attente;                 /**< Nombre de taches dans la file */
+    int nb_en_cours;                /**< Nombre de taches en cours d'exécution */
+    int arret;                      /**< 1 : les workers s'arrêtent (Free_pool_taches) */
+    pthread_mutex_t mutex;          /**< Protège la file et les compteurs */
+    pthread_cond_t cond_tache;      /**< Signalée à l'ajout d'une tache ou à l'arrêt */
+    pthread_cond_t cond_fin;        /**< Signalée quand plus rien n'est en cours */
+} PoolTaches;
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Renvoie le nombre de threads à utiliser pour nb_taches taches
+ * indépendantes : nombre de coeurs en ligne, borné par nb_taches et
+ * POOL_NB_THREADS_MAX.
+ *
+ * @param nb_taches Nombre de taches à exécuter
+ * @return int Nombre de threads (au moins 1)
+ */
+int Nb_threads_pool(int nb_taches);
+
+/**
+ * @brief Initialise un pool et lance ses nb_threads workers. Avec 0 thread,
+ * le pool est en mode série. Sort en erreur si un thread ne peut être créé.
+ *
+ * @param pool Pointeur vers un objet de type PoolTaches
+ * @param nb_threads Nombre de workers (0 à POOL_NB_THREADS_MAX)
+ */
+void Init_pool_taches(PoolTaches *pool, int nb_threads);
+
+/**
+ * @brief Ajoute une tache dans la file du pool (exécutée directement en mode
+ * série). Sort en erreur si la file est pleine.
+ *
+ * @param pool Pointeur vers un objet de type PoolTaches
+ * @param fonction Fonction à exécuter
+ * @param arg Argument passé à la fonction
+ */
+void Ajout_tache(PoolTaches *pool, void (*fonction)(void *arg), void *arg);
+
+/**
+ * @brief Attend que toutes les taches ajoutées soient terminées
+ *
+ * @param pool Pointeur vers un objet de type PoolTaches
+ */
+void Attente_taches(PoolTaches *pool);
+
+/**
+ * @brief Attend la fin des taches, arrête les workers et libère le pool
+ *
+ * @param pool Pointeur vers un objet de type PoolTaches
+ */
+void Free_pool_taches(PoolTaches *pool);
+
+/**
+ * @brief Fonction interne : boucle d'un worker (prend les taches de la file
+ * jusqu'à l'arrêt du pool)
+ *
+ * @param arg Pointeur vers le PoolTaches
+ * @return void* NULL
+ */
+void *Worker_pool(void *arg);
+
+
+/* --------------------------------------------------------------------------- */
+// Définition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+int Nb_threads_pool(int nb_taches)
+{
+    long nb_coeurs = sysconf(_SC_NPROCESSORS_ONLN);
+    int nb_threads = nb_coeurs > 0 ? (int)nb_coeurs : 1;
+
+    if (nb_threads > nb_taches) nb_threads = nb_taches;
+    if (nb_threads > POOL_NB_THREADS_MAX) nb_threads = POOL_NB_THREADS_MAX;
+    if (nb_threads < 1) nb_threads = 1;
+
+    return nb_threads;
+}
+
+/* --------------------------------------------------------------------------- */
+void *Worker_pool(void *arg)
+{
+    PoolTaches *pool = arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->nb_attente == 0 && !pool->arret)
+            pthread_cond_wait(&pool->cond_tache, &pool->mutex);
+
+        if (pool->nb_attente == 0) break;   // arrêt et file vide
+
+        Tache tache = pool->file[pool->debut];
+        pool->debut = (pool->debut + 1) % POOL_NB_TACHES_MAX;
+        pool->nb_attente--;
+        pool->nb_en_cours++;
+
+        pthread_mutex_unlock(&pool->mutex);
+        tache.fonction(tache.arg);
+        pthread_mutex_lock(&pool->mutex);
+
+        pool->nb_en_cours--;
+        if (pool->nb_attente == 0 && pool->nb_en_cours == 0)
+            pthread_cond_broadcast(&pool->cond_fin);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------- */
+void Init_pool_taches(PoolTaches *pool, int nb_threads)
+{
+    if (nb_threads < 0) nb_threads = 0;
+    if (nb_threads > POOL_NB_THREADS_MAX) nb_threads = POOL_NB_THREADS_MAX;
+
+    pool->nb_threads = 0;
+    pool->debut = 0;
+    pool->nb_attente = 0;
+    pool->nb_en_cours = 0;
+    pool->arret = 0;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond_tache, NULL);
+    pthread_cond_init(&pool->cond_fin, NULL);
+
+    for (int t = 0; t < nb_threads; t++) {
+        if (pthread_create(&pool->threads[t], NULL, Worker_pool, pool) != 0) {
+            printf("Erreur : creation du thread %d du pool impossible.\n", t);
+            exit(EXIT_FAILURE);
+        }
+        pool->nb_threads++;
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+void Ajout_tache(PoolTaches *pool, void (*fonction)(void *arg), void *arg)
+{
+    // Mode série : exécution immédiate dans le thread appelant
+    if (pool->nb_threads == 0) {
+        fonction(arg);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->nb_attente == POOL_NB_TACHES_MAX) {
+        printf("Erreur : file du pool pleine (%d taches).\n", POOL_NB_TACHES_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    int fin = (pool->debut + pool->nb_attente) % POOL_NB_TACHES_MAX;
+    pool->file[fin].fonction = fonction;
+    pool->file[fin].arg = arg;
+    pool->nb_attente++;
+
+    pthread_cond_signal(&pool->cond_tache);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/* --------------------------------------------------------------------------- */
+void Attente_taches(PoolTaches *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->nb_attente != 0 || pool->nb_en_cours != 0)
+        pthread_cond_wait(&pool->cond_fin, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/* --------------------------------------------------------------------------- */
+void Free_pool_taches(PoolTaches *pool)
+{
+    Attente_taches(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->arret = 1;
+    pthread_cond_broadcast(&pool->cond_tache);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int t = 0; t < pool->nb_threads; t++)
+        pthread_join(pool->threads[t], NULL);
+    pool->nb_threads = 0;
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->cond_tache);
+    pthread_cond_destroy(&pool->cond_fin);
+}
+
+#endif
@@ -0,0 +1,334 @@
+/* ----------------------------------------------------------------------------
+*  Bibliotheque definissant la figure des stations live (barplot des statuts
+*  des bornes par station à la derniere récolte). Partagée par le programme
+*  main_stations_live.c (une figure par execution) et par le serveur de rendu
+*  main_serveur_live.c (une figure par requete) : sélection des stations
+*  autour d'une position, puis préparation et tracé de la figure.
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+#ifndef RENDU_LIVE_H
+#define RENDU_LIVE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "consts.h"
+#include "traitement.h"
+#include "getter.h"
+#include "plotter.h"
+#include "couche.h"
+#include "svg.h"
+
+/**
+ * @brief Nombre de statuts de la figure live (disponible, occupe,
+ * en_maintenance, inconnu)
+ *
+ */
+#define NB_STATUTS_LIVE 4
+
+/**
+ * @brief Rayon moyen de la Terre en km (distances station - position)
+ *
+ */
+#define RAYON_TERRE_KM 6371.0
+
+/**
+ * @brief Nombre de textes de la couche statique (lien github, copyright, titre)
+ *
+ */
+#define NB_TEXTES_COUCHE_LIVE 3
+
+/**
+ * @brief Textes de la couche statique de la figure live
+ *
+ */
+char *textes_couche_live[NB_TEXTES_COUCHE_LIVE] = {\
+    "https://github.com/bauj/AJC_projet_belib",
+    "\u00a9 2023 by Juba Hamma",
+    "Disponibilité des bornes Belib (stations live)"};
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Stations retenues pour une figure live : copie des labels et des
+ * statuts de la derniere récolte, indépendante des StationsData (qui peuvent
+ * etre rechargées pendant le tracé)
+ *
+ */
+typedef struct SelectionLive_s {
+    int nb_stations;                        /**< Nombre de stations retenues */
+    char **labels;                          /**< Labels (sans code postal) */
+    uint16_t (*statuts)[NB_STATUTS_LIVE];   /**< Statuts de la derniere récolte */
+    Date date_recolte;                      /**< Date de la derniere récolte */
+} SelectionLive;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Figure live préparée par Init_figure_live : figure, clé de sa couche
+ * statique et empreinte de ses entrées
+ *
+ */
+typedef struct FigureLive_s {
+    Figure fig;             /**< Figure (barplots ajoutés) */
+    uint64_t cle;           /**< Clé de la couche statique (Cle_couche_statique) */
+    uint64_t hash;          /**< Empreinte de la figure (Hash_figure) */
+    char subtitle[70];      /**< Sous titre : date de la derniere récolte */
+} FigureLive;
+
+
+/* --------------------------------------------------------------------------- */
+// Declaration fonctions
+/* --------------------------------------------------------------------------- */
+
+/**
+ * @brief Distance en km entre deux positions (formule de haversine)
+ *
+ * @param lat1 Latitude de la 1ere position (degrés)
+ * @param lon1 Longitude de la 1ere position (degrés)
+ * @param lat2 Latitude de la 2eme position (degrés)
+ * @param lon2 Longitude de la 2eme position (degrés)
+ * @return double Distance en km
+ */
+double Distance_km(double lat1, double lon1, double lat2, double lon2);
+
+/**
+ * @brief Sélectionne les stations présentes à la derniere récolte (au moins
+ * une borne) et, si rayon > 0, à moins de rayon km de (lat, lon). Les labels
+ * et statuts sont copiés dans la sélection.
+ *
+ * @param data Stations chargées (Get_stations_data)
+ * @param positions Positions {lon, lat} des stations (Get_positions),
+ * peut etre NULL si rayon <= 0
+ * @param lat Latitude du centre de la recherche
+ * @param lon Longitude du centre de la recherche
+ * @param rayon Rayon de la recherche en km (<= 0 : toutes les stations)
+ * @param selection Pointeur vers un objet de type SelectionLive (sortie, à
+ * libérer par Free_selection_live)
+ */
+void Selection_stations_live(StationsData *data, double positions[][2],\
+                             double lat, double lon, double rayon,\
+                             SelectionLive *selection);
+
+/**
+ * @brief Libère la mémoire d'une sélection
+ *
+ * @param selection Pointeur vers un objet de type SelectionLive
+ */
+void Free_selection_live(SelectionLive *selection);
+
+/**
+ * @brief Prépare la figure live d'une sélection (au moins une station) :
+ * initialisation, format de sortie, barplots, clé de la couche statique et
+ * empreinte. Rien n'est tracé hormis le fond.
+ *
+ * @param figure_live Pointeur vers un objet de type FigureLive
+ * @param selection Stations de la figure (doit vivre jusqu'à Destroy_figure)
+ * @param palette_png 'y' : png à palette, 'n' : png RGB
+ * @param svg 1 : figure en svg
+ * @param nb_blocs_png Nombre de blocs de l'encodeur png (voir
+ * Change_compression_png)
+ */
+void Init_figure_live(FigureLive *figure_live, SelectionLive *selection,\
+                      char palette_png, int svg, int nb_blocs_png);
+
+/**
+ * @brief Trace la figure live : couche statique (copiée depuis le cache en
+ * mémoire, sinon relue depuis fichier_couche si sa clé correspond, sinon 
+ * dessinée et sauvegardée), ticks, barplots et sous titre
+ *
+ * @param figure_live Pointeur vers un objet de type FigureLive (Init_figure_live)
+ * @param fichier_couche Chemin du fichier de la couche statique
+ * @param couches Cache des couches en mémoire (NULL : pas de cache), 
+ * complété par la couche relue ou dessinée
+ */
+void Trace_figure_live(FigureLive *figure_live, const char *fichier_couche,\
+                       CacheCouches *couches);
+
+
+/* --------------------------------------------------------------------------- */
+// Définition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+double Distance_km(double lat1, double lon1, double lat2, double lon2)
+{
+    double rad = M_PI / 180.;
+    double dlat = (lat2 - lat1) * rad;
+    double dlon = (lon2 - lon1) * rad;
+
+    double a = sin(dlat/2.)*sin(dlat/2.) \
+                + cos(lat1*rad)*cos(lat2*rad)*sin(dlon/2.)*sin(dlon/2.);
+
+    return 2. * RAYON_TERRE_KM * asin(sqrt(a));
+}
+
+/* --------------------------------------------------------------------------- */
+void Selection_stations_live(StationsData *data, double positions[][2],\
+                             double lat, double lon, double rayon,\
+                             SelectionLive *selection)
+{
+    int nb_stations = data->nb_stations;
+    int derniere = data->nb_rows_par_station - 1;
+
+    selection->nb_stations = 0;
+    selection->labels = malloc(Max_int(nb_stations, 1)*sizeof(char *));
+    selection->statuts = malloc(Max_int(nb_stations, 1)*sizeof(*selection->statuts));
+
+    if (selection->labels == NULL || selection->statuts == NULL) {
+        printf("Erreur : Pas assez de memoire.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (derniere < 0) return;
+    selection->date_recolte = data->tableau_date_recolte[derniere];
+
+    for (int st = 0; st < nb_stations; st++) {
+        uint16_t *statuts = selection->statuts[selection->nb_stations];
+        int nb_tot_bornes = 0;
+
+        Cube_get_statuts(&(data->statuts), st, derniere, statuts);
+        for (int statut = disponible; statut <= inconnu; statut++)
+            nb_tot_bornes += statuts[statut];
+
+        // Station absente de la derniere récolte ou hors du rayon
+        if (nb_tot_bornes == 0) continue;
+        if (rayon > 0. && Distance_km(lat, lon, positions[st][1], positions[st][0]) > rayon)
+            continue;
+
+        // On retire le code postal des labels (adresse sans "Paris")
+        char label_tmp[100];
+        int len_label = strlen(data->tableau_labels[st]);
+        slice_str(data->tableau_labels[st], label_tmp, 0, len_label-7);
+        selection->labels[selection->nb_stations++] = strdup(label_tmp);
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+void Free_selection_live(SelectionLive *selection)
+{
+    free_tab_char1(selection->labels, selection->nb_stations);
+    free(selection->labels);
+    free(selection->statuts);
+    selection->labels = NULL;
+    selection->statuts = NULL;
+    selection->nb_stations = 0;
+}
+
+/* --------------------------------------------------------------------------- */
+void Init_figure_live(FigureLive *figure_live, SelectionLive *selection,\
+                      char palette_png, int svg, int nb_blocs_png)
+{
+    Figure *fig = &(figure_live->fig);
+
+    int figsize[2] = {800, 700};     /**< Dimension figure */
+    int padX[2] = {90,0};            /**< pad zone de dessin gauche et droite*/
+    int padY[2] = {90,230};          /**< pad zone de dessin haut et bas*/
+    int margin[2] = {10,10};         /**< margin gauche droite zone de dessin*/
+    char wAxes = 'n';
+    Init_figure(fig, figsize, padX, padY, margin, wAxes);
+
+    Change_compression_png(fig, 5, Z_DEFAULT_STRATEGY, nb_blocs_png);
+    Change_palette_png(fig, palette_png);
+    if (svg)
+        Change_backend_svg(fig);
+
+    // Un bardata par station, dans l'arène de la figure
+    int nb_stations = selection->nb_stations;
+    BarData *barplots = Alloc_arene(&fig->arene, nb_stations*sizeof(BarData));
+
+    for (int st_barplot = 0; st_barplot < nb_stations; st_barplot++) {
+        int nb_tot_bornes = 0;
+        for (int statut = disponible; statut <= inconnu; statut ++)
+            nb_tot_bornes += selection->statuts[st_barplot][statut];
+
+        Init_bardata(&(barplots[st_barplot]), NB_STATUTS_LIVE, labels_ctg, nb_tot_bornes,\
+             selection->statuts[st_barplot],\
+              color_ctg, selection->labels[st_barplot]);
+
+        // Update des data de l'objet figure (gestion des max, posX des barplot)
+        Add_barplot_to_fig(fig, &(barplots[st_barplot]));
+    }
+
+    // Police de la couche statique (légende, annotations, titre)
+    Change_font(fig, leg_f, fonts_fig[1]);
+    Change_fontsize(fig, leg_f, 13);
+    figure_live->cle = Cle_couche_statique(fig, NB_TEXTES_COUCHE_LIVE, textes_couche_live);
+
+    // Sous titre : derniere date de recolte
+    Date *date = &(selection->date_recolte);
+    sprintf(figure_live->subtitle, "le %02d/%02d/%02d à %02d:%02d",\
+                     date->tm.tm_mday,\
+                     date->tm.tm_mon+1,\
+                     (date->tm.tm_year+1900)%2000,\
+                     date->tm.tm_hour,\
+                     date->tm.tm_min);
+
+    char *textes_dyn[] = {figure_live->subtitle};
+    figure_live->hash = Hash_figure(fig, figure_live->cle, 1, textes_dyn);
+}
+
+/* --------------------------------------------------------------------------- */
+void Trace_figure_live(FigureLive *figure_live, const char *fichier_couche,\
+                       CacheCouches *couches)
+{
+    Figure *fig = &(figure_live->fig);
+    char* path_f_med = fonts_fig[1];
+    int bbox_title[COUCHE_NB_META];
+
+    char *github = textes_couche_live[0];
+    char *sign = textes_couche_live[1];
+    char *title = textes_couche_live[2];
+
+    int en_memoire = couches != NULL \
+                && Charger_couche_memoire(fig, couches, figure_live->cle, bbox_title);
+
+    if (!en_memoire && !Charger_couche_statique(fig, fichier_couche, figure_live->cle, bbox_title)) {
+        /* Make legend */
+        int decalx_leg = 0, decaly_leg = 0, ecart = 2;
+        Make_legend_barplot(fig, decalx_leg, decaly_leg, ecart);
+
+        /* Make github link */
+        int decalx_github = 0, decaly_github = 0;
+        Make_annotation(fig, github, decalx_github, decaly_github);
+
+        /* Make copyright */
+        int decalx_sign = fig->img->sx- strlen(sign)*7, decaly_sign = 0;
+        Make_annotation(fig, sign, decalx_sign, decaly_sign);
+
+        /* Make title */
+        int decalx_title = 0, decaly_title = 0;
+        memcpy(bbox_title, Make_title(fig, title, decalx_title, decaly_title),\
+                sizeof(bbox_title));
+
+        Sauver_couche_statique(fig, fichier_couche, figure_live->cle, bbox_title);
+    }
+
+    // Couche relue ou dessinée : gardée pour les requetes suivantes
+    if (couches != NULL && !en_memoire)
+        Garder_couche_memoire(fig, couches, figure_live->cle, bbox_title);
+
+    // Ajout des yticks et des ygrid (avant plot pour eviter de plotter par dessus)
+    char wTicks = 'n';
+    Change_font(fig, ticklabel_f, path_f_med);
+    Change_fontsize(fig, ticklabel_f, 14);
+    Make_yticks_ygrid(fig, wTicks);
+
+    // Ajout des xticks
+    float angle_labels = 25.;
+    Change_fontsize(fig, ticklabel_f, 13);
+    Make_xticks_barplot(fig, angle_labels);
+
+    // Plot des barplots
+    char wlabels = 'y';
+    for (size_t st_barplot = 0; st_barplot < fig->nb_bardata; st_barplot++)
+        PlotBarplot(fig, fig->bardata[st_barplot], wlabels);
+
+    /* Make subtitle */
+    int decalx_subtitle = 0, decaly_subtitle = 0;
+    Make_subtitle(fig, figure_live->subtitle, bbox_title, decalx_subtitle, decaly_subtitle);
+}
+
+#endif
@@ -0,0 +1,374 @@
+/* ----------------------------------------------------------------------------
+*  Bibliotheque definissant le backend svg des figures : les primitives de
+*  dessin (rectangles, traits, polylignes, disques, textes) sont écrites en
+*  éléments svg dans un tampon mémoire au lieu d'être rasterisées. Les textes
+*  restent des textes (police de la figure, taille en px comme libgd à 96 dpi)
+*  et les courbes deviennent des polylines. Le document se récupère en
+*  mémoire (Document_svg) ou se sauvegarde dans un fichier (Save_figure).
+*  Les dimensions de la figure restent celles de son image gd, qui n'est pas
+*  dessinée une fois le backend svg choisi.
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+#ifndef SVG_H
+#define SVG_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <gd.h>
+#include "plotter.h"
+
+/**
+ * @brief Longueur max du nom de famille d'une police (tiré du nom du fichier)
+ *
+ */
+#define SVG_LONGUEUR_FAMILLE 64
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Flux svg d'une figure : éléments écrits dans un tampon mémoire
+ * (open_memstream), terminé par Document_svg
+ *
+ */
+typedef struct FluxSvg_s {
+    FILE *flux;       /**< Flux mémoire des éléments */
+    char *tampon;     /**< Tampon du flux : document svg */
+    size_t taille;    /**< Taille du document */
+    int termine;      /**< 1 une fois la balise </svg> écrite */
+} FluxSvg;
+
+
+/* --------------------------------------------------------------------------- */
+// Declaration fonctions
+/* --------------------------------------------------------------------------- */
+
+/**
+ * @brief Backend svg des figures (voir Backend, Change_backend_svg)
+ *
+ */
+extern const Backend backend_svg;
+
+/**
+ * @brief Passe une figure sur le backend svg : ouvre son flux, écrit l'en-tete
+ * svg et retrace le fond (et les axes support si demandés à Init_figure). A
+ * appeler juste après Init_figure, avant tout tracé. Le flux est libéré par
+ * Destroy_figure.
+ *
+ * @param fig Pointeur vers un objet de type Figure
+ */
+void Change_backend_svg(Figure *fig);
+
+/**
+ * @brief Termine le document svg de la figure (balise fermante) et renvoie
+ * son tampon. Plus rien ne doit être tracé ensuite.
+ *
+ * @param fig Pointeur vers un objet de type Figure (backend svg)
+ * @param taille Taille du document en octets (sortie, peut être NULL)
+ * @return const char* Document svg, valide jusqu'à Destroy_figure
+ */
+const char *Document_svg(Figure *fig, size_t *taille);
+
+/**
+ * @brief Ecrit le document svg d'une figure dans un flux (Document_svg puis
+ * écriture), voir Save_figure et Figure_en_memoire
+ *
+ * @param fig Pointeur vers un objet de type Figure (backend svg)
+ * @param f Flux ouvert en écriture
+ * @return int 0 si ok, -1 si l'écriture a échoué
+ */
+int Ecrire_svg(Figure *fig, FILE *f);
+
+/**
+ * @brief Primitives du backend svg (voir Backend) : un élément svg par appel
+ *
+ */
+void Svg_rectangle(Figure *fig, int x1, int y1, int x2, int y2, int couleur);
+void Svg_ligne(Figure *fig, int x1, int y1, int x2, int y2, LineStyle *linestyle);
+void Svg_polyligne(Figure *fig, size_t nb_pts, const int x[], const int y[],\
+                    const int orig[2], LineStyle *linestyle);
+void Svg_disque(Figure *fig, int x, int y, int diametre, int couleur);
+void Svg_secteur(Figure *fig, int x, int y, int diametre, int debut, int fin, int couleur);
+char *Svg_texte(Figure *fig, int *brect, int couleur, char *path,\
+                    double size, double angle, int x, int y, char *texte);
+void Svg_etiquette(Figure *fig, int couleur, const char *path, int size,\
+                    int x, int y, const char *texte);
+void Svg_liberer(Figure *fig);
+
+/**
+ * @brief Fonction interne : écrit les attributs de trait d'un LineStyle
+ * (couleur, épaisseur, pointillés comme gdImageDashedLine)
+ *
+ * @param flux Flux svg
+ * @param linestyle Style du trait
+ */
+void Trait_svg(FILE *flux, LineStyle *linestyle);
+
+/**
+ * @brief Fonction interne : écrit les attributs de police d'un fichier
+ * police, déduits de son nom (ex : Lato-LightItalic.ttf -> famille Lato,
+ * graisse 300, italique)
+ *
+ * @param flux Flux svg
+ * @param path Chemin vers le fichier police
+ */
+void Police_svg(FILE *flux, const char *path);
+
+/**
+ * @brief Fonction interne : écrit un texte en échappant les caractères
+ * spéciaux xml
+ *
+ * @param flux Flux svg
+ * @param texte Texte (utf-8)
+ */
+void Texte_echappe_svg(FILE *flux, const char *texte);
+
+
+/* --------------------------------------------------------------------------- */
+// Définition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+void Change_backend_svg(Figure *fig)
+{
+    FluxSvg *svg = Alloc_arene(&fig->arene, sizeof(FluxSvg));
+    svg->tampon = NULL;
+    svg->taille = 0;
+    svg->termine = 0;
+    svg->flux = open_memstream(&svg->tampon, &svg->taille);
+    if (svg->flux == NULL) {
+        printf("Erreur : ouverture du flux svg impossible.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fig->backend = &backend_svg;
+    fig->donnees_backend = svg;
+
+    // xml:space : espaces en tete des labels (ticks) gardés, comme dans le png
+    fprintf(svg->flux, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"\
+                       "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" "\
+                       "height=\"%d\" viewBox=\"0 0 %d %d\" xml:space=\"preserve\">\n",\
+                       fig->img->sx, fig->img->sy, fig->img->sx, fig->img->sy);
+
+    // Fond déjà tracé dans l'image gd par Init_figure : retracé en svg
+    Make_background(fig, fig->color_bg, fig->color_cvs_bg);
+    if (fig->axes == 'y')
+        Make_support_axes(fig, fig->color_axes);
+}
+
+/* --------------------------------------------------------------------------- */
+const char *Document_svg(Figure *fig, size_t *taille)
+{
+    FluxSvg *svg = fig->donnees_backend;
+
+    if (!svg->termine) {
+        fputs("</svg>\n", svg->flux);
+        fflush(svg->flux);
+        svg->termine = 1;
+    }
+
+    if (taille != NULL) *taille = svg->taille;
+    return svg->tampon;
+}
+
+/* --------------------------------------------------------------------------- */
+int Ecrire_svg(Figure *fig, FILE *f)
+{
+    size_t taille;
+    const char *document = Document_svg(fig, &taille);
+
+    return fwrite(document, 1, taille, f) == taille ? 0 : -1;
+}
+
+/* --------------------------------------------------------------------------- */
+void Svg_liberer(Figure *fig)
+{
+    // Le FluxSvg est dans l'arène de la figure : seul le flux est à fermer
+    FluxSvg *svg = fig->donnees_backend;
+    fclose(svg->flux);
+    free(svg->tampon);
+}
+
+/* --------------------------------------------------------------------------- */
+void Trait_svg(FILE *flux, LineStyle *linestyle)
+{
+    // Epaisseur 0 : trait fin de 1 pixel, comme gd
+    fprintf(flux, " fill=\"none\" stroke=\"#%06x\" stroke-width=\"%d\"",\
+                    linestyle->couleur & 0xFFFFFF, Max_int(linestyle->w, 1));
+    if (linestyle->style == ':')
+        fputs(" stroke-dasharray=\"4\"", flux);    // gdDashSize
+}
+
+/* --------------------------------------------------------------------------- */
+void Police_svg(FILE *flux, const char *path)
+{
+    // Nom du fichier sans dossier ni extension : Famille-Style
+    const char *nom = strrchr(path, '/');
+    nom = (nom == NULL) ? path : nom + 1;
+
+    char famille[SVG_LONGUEUR_FAMILLE];
+    size_t len = strcspn(nom, "-.");
+    if (len >= sizeof(famille)) len = sizeof(famille) - 1;
+    memcpy(famille, nom, len);
+    famille[len] = '\0';
+
+    const char *style = nom + len;
+    int poids = 400;
+    if (strstr(style, "Thin") != NULL)          poids = 100;
+    else if (strstr(style, "Light") != NULL)    poids = 300;
+    else if (strstr(style, "Medium") != NULL)   poids = 500;
+    else if (strstr(style, "SemiBold") != NULL) poids = 600;
+    else if (strstr(style, "Bold") != NULL)     poids = 700;
+    else if (strstr(style, "Black") != NULL)    poids = 900;
+
+    fprintf(flux, " font-family=\"%s, sans-serif\"", famille);
+    if (poids != 400)
+        fprintf(flux, " font-weight=\"%d\"", poids);
+    if (strstr(style, "Italic") != NULL || strstr(style, "Oblique") != NULL)
+        fputs(" font-style=\"italic\"", flux);
+}
+
+/* --------------------------------------------------------------------------- */
+void Texte_echappe_svg(FILE *flux, const char *texte)
+{
+    for (const char *c = texte; *c != '\0'; c++) {
+        switch (*c) {
+            case '&': fputs("&amp;", flux); break;
+            case '<': fputs("&lt;", flux); break;
+            case '>': fputs("&gt;", flux); break;
+            default:  fputc(*c, flux);
+        }
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+void Svg_rectangle(Figure *fig, int x1, int y1, int x2, int y2, int couleur)
+{
+    FluxSvg *svg = fig->donnees_backend;
+
+    // Coins inclus, comme gdImageFilledRectangle
+    fprintf(svg->flux, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"#%06x\"/>\n",\
+                Min_int(x1, x2), Min_int(y1, y2), abs(x2 - x1) + 1, abs(y2 - y1) + 1,\
+                couleur & 0xFFFFFF);
+}
+
+/* --------------------------------------------------------------------------- */
+void Svg_ligne(Figure *fig, int x1, int y1, int x2, int y2, LineStyle *linestyle)
+{
+    if (linestyle->style != '-' && linestyle->style != ':') return;
+
+    FluxSvg *svg = fig->donnees_backend;
+
+    // Trait d'épaisseur impaire centré sur le milieu du pixel (comme gd)
+    double d = (Max_int(linestyle->w, 1) % 2) * 0.5;
+    fprintf(svg->flux, "<line x1=\"%g\" y1=\"%g\" x2=\"%g\" y2=\"%g\"",\
+                x1 + d, y1 + d, x2 + d, y2 + d);
+    Trait_svg(svg->flux, linestyle);
+    fputs("/>\n", svg->flux);
+}
+
+/* --------------------------------------------------------------------------- */
+void Svg_polyligne(Figure *fig, size_t nb_pts, const int x[], const int y[],\
+                    const int orig[2], LineStyle *linestyle)
+{
+    if (nb_pts < 2 || (linestyle->style != '-' && linestyle->style != ':'))
+        return;
+
+    FluxSvg *svg = fig->donnees_backend;
+    double d = (Max_int(linestyle->w, 1) % 2) * 0.5;
+
+    fputs("<polyline points=\"", svg->flux);
+    fprintf(svg->flux, "%g,%g", x[0] + orig[0] + d, y[0] + orig[1] + d);
+
+    // Points confondus ou alignés dans le même sens que le segment en cours
+    // omis (comme ImagePolyligneEpaisseur)
+    int dx = 0, dy = 0;
+    for (size_t i = 1; i < nb_pts; i++) {
+        int pas_x = x[i] - x[i-1], pas_y = y[i] - y[i-1];
+        if (pas_x == 0 && pas_y == 0) continue;
+
+        int aligne = (long)dx*pas_y == (long)dy*pas_x && dx*pas_x + dy*pas_y > 0;
+        if (!aligne && (dx != 0 || dy != 0))
+            fprintf(svg->flux, " %g,%g", x[i-1] + orig[0] + d, y[i-1] + orig[1] + d);
+        if (!aligne) {
+            dx = pas_x;
+            dy = pas_y;
+        }
+    }
+    fprintf(svg->flux, " %g,%g\"", x[nb_pts-1] + orig[0] + d, y[nb_pts-1] + orig[1] + d);
+
+    Trait_svg(svg->flux, linestyle);
+    fputs("/>\n", svg->flux);
+}
+
+/* --------------------------------------------------------------------------- */
+void Svg_disque(Figure *fig, int x, int y, int diametre, int couleur)
+{
+    FluxSvg *svg = fig->donnees_backend;
+
+    fprintf(svg->flux, "<circle cx=\"%g\" cy=\"%g\" r=\"%g\" fill=\"#%06x\"/>\n",\
+                x + 0.5, y + 0.5, diametre / 2., couleur & 0xFFFFFF);
+}
+
+/* --------------------------------------------------------------------------- */
+void Svg_secteur(Figure *fig, int x, int y, int diametre, int debut, int fin, int couleur)
+{
+    FluxSvg *svg = fig->donnees_backend;
+    double r = diametre / 2., cx = x + 0.5, cy = y + 0.5;
+    double a1 = Deg2rad(debut), a2 = Deg2rad(fin);
+
+    // Angles dans le sens horaire à l'écran (y vers le bas), comme gdImageFilledArc
+    fprintf(svg->flux, "<path d=\"M%g %gL%.2f %.2fA%g %g 0 %d 1 %.2f %.2fZ\" fill=\"#%06x\"/>\n",\
+                cx, cy, cx + r*cos(a1), cy + r*sin(a1), r, r, (fin - debut) > 180,\
+                cx + r*cos(a2), cy + r*sin(a2), couleur & 0xFFFFFF);
+}
+
+/* --------------------------------------------------------------------------- */
+char *Svg_texte(Figure *fig, int *brect, int couleur, char *path,\
+                    double size, double angle, int x, int y, char *texte)
+{
+    FluxSvg *svg = fig->donnees_backend;
+
+    // Boite englobante : mesure par libgd sans image (rien n'est rasterisé)
+    char *erreur = NULL;
+    if (brect != NULL)
+        erreur = gdImageStringFT(NULL, brect, couleur, path, size, angle, x, y, texte);
+
+    // Taille en points à 96 dpi (résolution par défaut de gdImageStringFT)
+    fprintf(svg->flux, "<text x=\"%d\" y=\"%d\"", x, y);
+    Police_svg(svg->flux, path);
+    fprintf(svg->flux, " font-size=\"%g\" fill=\"#%06x\"", size * 96. / 72.,\
+                couleur & 0xFFFFFF);
+    if (angle != 0.)
+        fprintf(svg->flux, " transform=\"rotate(%g %d %d)\"", -angle * 180. / M_PI, x, y);
+    fputc('>', svg->flux);
+    Texte_echappe_svg(svg->flux, texte);
+    fputs("</text>\n", svg->flux);
+
+    return erreur;
+}
+
+/* --------------------------------------------------------------------------- */
+void Svg_etiquette(Figure *fig, int couleur, const char *path, int size,\
+                    int x, int y, const char *texte)
+{
+    Svg_texte(fig, NULL, couleur, (char *)path, size, 0., x, y, (char *)texte);
+}
+
+/* --------------------------------------------------------------------------- */
+const Backend backend_svg = {
+    .nom = "svg",
+    .rectangle = Svg_rectangle,
+    .ligne = Svg_ligne,
+    .polyligne = Svg_polyligne,
+    .disque = Svg_disque,
+    .secteur = Svg_secteur,
+    .texte = Svg_texte,
+    .etiquette = Svg_etiquette,
+    .ecrire = Ecrire_svg,
+    .liberer = Svg_liberer,
+};
+
+#endif
@@ -13,7 +13,23 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 
+/**
+ * @brief Décalage (en secondes) retranché aux dates de récolte lors du calcul
+ * de leur epoch. Les dates de la bdd sont en heure de Paris malgré le suffixe
+ * "Z" : à 0, l'heure murale est lue comme UTC, comme la colonne `epoch` de la
+ * bdd (migration 1). Les labels des figures se lisent alors avec gmtime sans
+ * correction d'heure (été comme hiver).
+ * Choix volontaire : la fenetre (minuit local), les tranches de résolution et
+ * l'agregat horaire de la bdd reposent sur cette heure murale. Le passage à
+ * l'heure d'été (ou d'hiver) laisse donc un trou (ou un recouvrement) d'une
+ * heure sur l'axe du temps de la figure 1, deux fois par an. Un décalage fixe
+ * non nul ne donne pas l'UTC : il ne tient pas compte de l'heure d'été.
+ */
+#ifndef DECALAGE_DATES_SEC
+#define DECALAGE_DATES_SEC 0
+#endif
 
 // ----------------------------------------------------------------------------
 /**
@@ -101,6 +117,64 @@ void Init_Date(Date *dateobj, char date_input[20]);
 void Get_date_element(int *year, int *mon, int *mday, int *hour, int *min,char date_input[20]);
 
 
+// ----------------------------------------------------------------------------
+/**
+ * @brief Nombre de jours entre le 01/01/1970 et une date du calendrier 
+ * grégorien (algorithme "days from civil", sans appel à la libc)
+ * 
+ * @param annee Année (ex : 2023)
+ * @param mois Mois de 1 à 12
+ * @param jour Jour du mois de 1 à 31
+ * @return int64_t Nombre de jours depuis le 01/01/1970 (négatif avant)
+ */
+int64_t Jours_depuis_civil(int annee, int mois, int jour);
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief Opération inverse de Jours_depuis_civil
+ * 
+ * @param jours Nombre de jours depuis le 01/01/1970
+ * @param annee Pointeur vers un entier où est sauvegardé l'année
+ * @param mois Pointeur vers un entier où est sauvegardé le mois (1 à 12)
+ * @param jour Pointeur vers un entier où est sauvegardé le jour (1 à 31)
+ */
+void Civil_depuis_jours(int64_t jours, int *annee, int *mois, int *jour);
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief Convertit une date au format de récolte "YYYY-MM-DDTHH:MM" en 
+ * secondes depuis le 01/01/70, directement à partir des chiffres (pas de copie,
+ * pas de strtol ni de mktime)
+ * 
+ * @param date_input Chaine de caractère de la date (terminée par '\0' : une
+ * chaine de moins de 16 caractères est refusée sans lire au-delà du '\0')
+ * @param decalage_sec Décalage en secondes retranché au résultat (0 : heure 
+ * murale lue comme UTC, 3600 : heure de Paris en hiver vers UTC, ...)
+ * @return int64_t Epoch de la date, -1 si la chaine n'est pas au bon format
+ */
+int64_t Parse_date_iso(const char *date_input, int decalage_sec);
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief Initialise un objet de type Date à partir de son epoch (opération 
+ * inverse de Init_Date), sans appel à gmtime ni strftime
+ * 
+ * @param dateobj Pointeur vers un objet de type Date rempli par la fonction
+ * @param epoch Epoch de la date (heure murale lue comme UTC)
+ */
+void Init_Date_epoch(Date *dateobj, int64_t epoch);
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief Version par lot de Init_Date_epoch : convertit une colonne entière 
+ * d'epochs en objets Date
+ * 
+ * @param nb Nombre de dates
+ * @param tableau_dates Tableau des Date rempli par la fonction
+ * @param epochs Colonne des epochs
+ */
+void Init_Dates_epoch(size_t nb, Date tableau_dates[nb], const int64_t epochs[nb]);
+
 // ----------------------------------------------------------------------------
 /**
  * @brief Fonction permettant de slicer une chaine de caractères
@@ -148,56 +222,91 @@ void Init_Datetick(Datetick *datetick, Date *dateobj_i, Date *dateobj_init)
                             dateobj_i->tm.tm_min);                            
 }
 
+// ----------------------------------------------------------------------------
+int64_t Jours_depuis_civil(int annee, int mois, int jour)
+{
+    // Année décalée au 1er mars : le jour bissextile est en fin d'année
+    annee -= mois <= 2;
+    const int64_t ere = (annee >= 0 ? annee : annee - 399) / 400;
+    const unsigned an_ere = (unsigned)(annee - ere * 400);                // [0, 399]
+    const unsigned jour_an = (153 * (mois > 2 ? mois - 3 : mois + 9) + 2) / 5
+                                + jour - 1;                               // [0, 365]
+    const unsigned jour_ere = an_ere * 365 + an_ere / 4 - an_ere / 100
+                                + jour_an;                                // [0, 146096]
+    return ere * 146097 + (int64_t)jour_ere - 719468;
+}
+
+// ----------------------------------------------------------------------------
+void Civil_depuis_jours(int64_t jours, int *annee, int *mois, int *jour)
+{
+    jours += 719468;
+    const int64_t ere = (jours >= 0 ? jours : jours - 146096) / 146097;
+    const unsigned jour_ere = (unsigned)(jours - ere * 146097);          // [0, 146096]
+    const unsigned an_ere = (jour_ere - jour_ere / 1460 + jour_ere / 36524\
+                                - jour_ere / 146096) / 365;               // [0, 399]
+    const unsigned jour_an = jour_ere - (365 * an_ere + an_ere / 4\
+                                - an_ere / 100);                          // [0, 365]
+    const unsigned mois_mars = (5 * jour_an + 2) / 153;                   // [0, 11]
+
+    *jour = jour_an - (153 * mois_mars + 2) / 5 + 1;
+    *mois = mois_mars < 10 ? mois_mars + 3 : mois_mars - 9;
+    *annee = (int)(an_ere + ere * 400) + (*mois <= 2);
+}
+
+// ----------------------------------------------------------------------------
+/**
+ * @brief Valeur de deux chiffres ASCII consécutifs
+ */
+static inline int Chiffres2(const char *s)
+{
+    return (s[0] - '0') * 10 + (s[1] - '0');
+}
+
+// ----------------------------------------------------------------------------
+int64_t Parse_date_iso(const char *date_input, int decalage_sec)
+{
+    // Rappel format = "%Y-%m-%dT%H:%MZ";
+    // Ex : 2023-01-23T14:00Z
+    const char *s = date_input;
+
+    // Chaine trop courte : pas de lecture au-delà de son '\0'
+    if (strnlen(s, 16) < 16) return -1;
+
+    // Vérification du format sans branchement par caractère
+    unsigned non_chiffre = 0;
+    static const unsigned char pos_chiffres[12] = {0,1,2,3,5,6,8,9,11,12,14,15};
+    for (int i = 0; i < 12; i++) {
+        non_chiffre |= (unsigned)(s[pos_chiffres[i]] - '0') > 9;
+    }
+    non_chiffre |= (s[4] != '-') | (s[7] != '-') | (s[10] != 'T') | (s[13] != ':');
+    if (non_chiffre) return -1;
+
+    int annee = Chiffres2(s) * 100 + Chiffres2(s + 2);
+    int mois = Chiffres2(s + 5);
+    int jour = Chiffres2(s + 8);
+    int heure = Chiffres2(s + 11);
+    int min = Chiffres2(s + 14);
+
+    return Jours_depuis_civil(annee, mois, jour) * 86400\
+            + heure * 3600 + min * 60 - decalage_sec;
+}
+
 // ----------------------------------------------------------------------------
 void Get_date_element(int *year, int *mon, int *mday, int *hour, int *min,\
                             char date_input[20])
 {
-    // Rappel format = "%Y-%m-%dT%H-%MTZD";
-    // Ex : 2023-01-23T14-00TZD;
-
-    int size_str_elem;
-
-    // Annee
-    size_str_elem = 4;
-    char str_year[size_str_elem+1];
-    Slice_str(date_input, str_year, 0, 3);
-    str_year[size_str_elem] = '\0';
-    *year = (int) strtol(str_year, NULL, 10);
-
-    // Mois
-    size_str_elem = 2;
-    char str_mon[size_str_elem+1];
-    Slice_str(date_input, str_mon, 5, 6);
-    str_mon[size_str_elem] = '\0';
-    *mon = (int) strtol(str_mon, NULL, 10);
-
-    // Jour
-    size_str_elem = 2;
-    char str_mday[size_str_elem+1];
-    Slice_str(date_input, str_mday, 8, 9);
-    str_mday[size_str_elem] = '\0';
-    *mday = (int) strtol(str_mday, NULL, 10);
-
-    // Heure
-    size_str_elem = 2;
-    char str_hour[size_str_elem+1];
-    Slice_str(date_input, str_hour, 11, 12);
-    str_hour[size_str_elem] = '\0';
-    *hour = (int) strtol(str_hour, NULL, 10);
-
-    // Min
-    size_str_elem = 2;
-    char str_min[size_str_elem+1];
-    Slice_str(date_input, str_min, 14, 15);
-    str_min[size_str_elem] = '\0';
-    *min = (int) strtol(str_min, NULL, 10);
-
+    // Rappel format = "%Y-%m-%dT%H:%MZ";
+    *year = Chiffres2(date_input) * 100 + Chiffres2(date_input + 2);
+    *mon = Chiffres2(date_input + 5);
+    *mday = Chiffres2(date_input + 8);
+    *hour = Chiffres2(date_input + 11);
+    *min = Chiffres2(date_input + 14);
 }
 
 // ----------------------------------------------------------------------------
 void Init_date_tm(Date *dateobj)
 {
-    int year = 1900, mon = 1, mday = 0, hour = 0, min = 0, sec = 0, isdst = -1;
+    int year = 1900, mon = 1, mday = 0, hour = 0, min = 0;
 
     Get_date_element(&year, &mon, &mday, &hour, &min, dateobj->datestr);
 
@@ -206,8 +315,8 @@ void Init_date_tm(Date *dateobj)
     dateobj->tm.tm_mday = mday;
     dateobj->tm.tm_hour = hour;
     dateobj->tm.tm_min = min;
-    dateobj->tm.tm_sec = sec;
-    dateobj->tm.tm_isdst = isdst;
+    dateobj->tm.tm_sec = 0;
+    dateobj->tm.tm_isdst = 0;
 
 }
 
@@ -215,11 +324,70 @@ void Init_date_tm(Date *dateobj)
 void Init_Date(Date *dateobj, char date_input[20])
 {
     // Recup string de la db
-    strcpy(dateobj->datestr, date_input);
+    strncpy(dateobj->datestr, date_input, sizeof(dateobj->datestr) - 1);
+    dateobj->datestr[sizeof(dateobj->datestr) - 1] = '\0';
 
     // Calcul temps entier depuis 01/01/70
+    int64_t epoch = Parse_date_iso(dateobj->datestr, DECALAGE_DATES_SEC);
+    if (epoch < 0) {
+        printf("Erreur : date de récolte au mauvais format : %s\n", date_input);
+        exit(EXIT_FAILURE);
+    }
     Init_date_tm(dateobj);
-    dateobj->ctime = mktime(&(dateobj->tm));
+    dateobj->ctime = (time_t)epoch;
+}
+
+// ----------------------------------------------------------------------------
+void Init_Date_epoch(Date *dateobj, int64_t epoch)
+{
+    int64_t jours = epoch / 86400;
+    int sec_jour = (int)(epoch % 86400);
+    if (sec_jour < 0) {
+        sec_jour += 86400;
+        jours--;
+    }
+
+    int annee, mois, jour;
+    Civil_depuis_jours(jours, &annee, &mois, &jour);
+    int heure = sec_jour / 3600;
+    int min = (sec_jour / 60) % 60;
+
+    // Chaine au format de la bdd : "YYYY-MM-DDTHH:MMZ"
+    char *s = dateobj->datestr;
+    s[0] = '0' + (annee / 1000) % 10;
+    s[1] = '0' + (annee / 100) % 10;
+    s[2] = '0' + (annee / 10) % 10;
+    s[3] = '0' + annee % 10;
+    s[4] = '-';
+    s[5] = '0' + mois / 10;
+    s[6] = '0' + mois % 10;
+    s[7] = '-';
+    s[8] = '0' + jour / 10;
+    s[9] = '0' + jour % 10;
+    s[10] = 'T';
+    s[11] = '0' + heure / 10;
+    s[12] = '0' + heure % 10;
+    s[13] = ':';
+    s[14] = '0' + min / 10;
+    s[15] = '0' + min % 10;
+    s[16] = 'Z';
+    s[17] = '\0';
+
+    memset(&(dateobj->tm), 0, sizeof(dateobj->tm));
+    dateobj->tm.tm_year = annee - 1900;
+    dateobj->tm.tm_mon = mois - 1;
+    dateobj->tm.tm_mday = jour;
+    dateobj->tm.tm_hour = heure;
+    dateobj->tm.tm_min = min;
+    dateobj->ctime = (time_t)(epoch - DECALAGE_DATES_SEC);
+}
+
+// ----------------------------------------------------------------------------
+void Init_Dates_epoch(size_t nb, Date tableau_dates[nb], const int64_t epochs[nb])
+{
+    for (size_t i = 0; i < nb; i++) {
+        Init_Date_epoch(&tableau_dates[i], epochs[i]);
+    }
 }
 
 
@@ -0,0 +1,849 @@
+/* ----------------------------------------------------------------------------
+*  Serveur de rendu de la figure des stations live : process résident qui
+*  garde la connexion à la bdd (statements préparés), le cache des polices
+*  et les couches statiques en mémoire (copiées dans chaque figure, sans
+*  relire le fichier), et trace la figure à la demande sur une socket unix.
+*  Remplace le lancement de plot_belib_live.exe (et la copie de la figure) à
+*  chaque requete du CGI.
+*
+*  Une requete est une ligne de champs cle=valeur séparés par des espaces :
+*      lat=48.84 lon=2.29 rayon=0.5 format=png fichier=fig2_barplot_live.png
+*  Tous les champs sont optionnels : sans rayon, toutes les stations de la
+*  derniere récolte ; format png (défaut) ou svg ; avec fichier, la figure est
+*  écrite dans le dossier des figures (remplacement atomique), sinon ses
+*  octets sont renvoyés sur la socket. Seules les figures live peuvent etre
+*  écrites : fig<..>_live.png ou .svg selon le format (les figures favoris 
+*  du dossier ne peuvent pas etre écrasées). Réponses :
+*      OK <taille>\n<octets de la figure>
+*      OK <fichier>\n
+*      ERR <message>\n
+*  Le thread principal accepte les connexions et recharge les données à
+*  chaque modification de la bdd (seul accès à la bdd) ; lecture, analyse et tracé
+*  des requetes sont faits par le pool, un client lent ne bloque pas les
+*  autres.
+*  La requete "stats" renvoie le nombre de requetes et leurs latences p50,
+*  p99 et max (aussi affichées à l'arrêt du serveur, SIGINT ou SIGTERM).
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+
+
+// #define AJC
+#define QEMU
+// #define LENOVO
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <grp.h>
+#include <sqlite3.h>
+#include "libs/getter.h"
+#include "libs/pool.h"
+#include "libs/rendu_live.h"
+
+/**
+ * @brief Chemin par défaut de la socket du serveur (option --socket)
+ *
+ */
+#define SOCKET_LIVE_DEFAUT "/tmp/belib_live.sock"
+
+/**
+ * @brief Longueur max d'une requete (ligne terminée par \n)
+ *
+ */
+#define REQUETE_LONGUEUR_MAX 256
+
+/**
+ * @brief Longueur max d'un nom de fichier de figure demandé
+ *
+ */
+#define FICHIER_LONGUEUR_MAX 64
+
+/**
+ * @brief Préfixe et suffixe des noms de figures live (requetes fichier)
+ *
+ */
+#define FICHIER_LIVE_PREFIXE "fig"
+#define FICHIER_LIVE_SUFFIXE "_live"
+
+/**
+ * @brief Histogramme des latences : cases de LATENCE_PAS_MS ms, la derniere
+ * case compte toutes les requetes plus longues
+ *
+ */
+#define LATENCE_NB_CASES 10000
+#define LATENCE_PAS_MS 0.1
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Latences des requetes traitées (histogramme, protégé par un mutex)
+ *
+ */
+typedef struct StatsLatence_s {
+    unsigned int cases[LATENCE_NB_CASES];   /**< Nombre de requetes par case */
+    long nb;                                /**< Nombre de requetes */
+    double max_ms;                          /**< Latence max en ms */
+    pthread_mutex_t mutex;                  /**< Protège l'histogramme */
+} StatsLatence;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Instantané des données de la table live : stations et positions,
+ * jamais modifié une fois chargé (remplacé en entier à chaque récolte)
+ *
+ */
+typedef struct DonneesLive_s {
+    StationsData data;              /**< Stations de la table */
+    double (*positions)[2];         /**< Positions {lon, lat} des stations */
+    sqlite3_int64 version;          /**< Version de la bdd au chargement (Get_version_bdd) */
+} DonneesLive;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Etat partagé par les taches de rendu
+ *
+ */
+typedef struct ServeurLive_s {
+    const char *dir_figures;        /**< Dossier des figures (requetes fichier) */
+    char *fichier_couche;           /**< Fichier de la couche statique */
+    CacheCouches couches;           /**< Couches statiques en mémoire */
+    DonneesLive *donnees;           /**< Instantané courant des données */
+    pthread_rwlock_t verrou_donnees; /**< Sélections (lecture) contre remplacement */
+    char palette_png;               /**< 'y' : png à palette, 'n' : png RGB */
+    int nb_en_cours;                /**< Requetes confiées au pool, pas terminées */
+    pthread_mutex_t mutex;          /**< Protège nb_en_cours */
+    pthread_cond_t cond_place;      /**< Signalée à la fin d'une requete */
+    pthread_mutex_t mutex_fichiers; /**< Ecriture figure + empreinte d'un fichier */
+    StatsLatence latences;          /**< Latences des requetes */
+} ServeurLive;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Requete de rendu : client à qui répondre, puis paramètres lus sur
+ * la socket et stations retenues par la tache (copiées : la tache ne touche
+ * pas à la bdd)
+ *
+ */
+typedef struct RequeteLive_s {
+    double lat;                             /**< Latitude du centre */
+    double lon;                             /**< Longitude du centre */
+    double rayon;                           /**< Rayon en km (<= 0 : tout) */
+    int svg;                                /**< 1 : figure en svg */
+    char fichier[FICHIER_LONGUEUR_MAX];     /**< Fichier à écrire ("" : octets) */
+    int client;                             /**< Socket du client */
+    struct timespec debut;                  /**< Date de l'accept */
+    SelectionLive selection;                /**< Stations de la figure */
+    ServeurLive *serveur;                   /**< Etat partagé */
+} RequeteLive;
+
+/**
+ * @brief Passe à 1 à la réception de SIGINT ou SIGTERM
+ *
+ */
+volatile sig_atomic_t arret_serveur = 0;
+
+
+/* --------------------------------------------------------------------------- */
+// Declaration fonctions
+/* --------------------------------------------------------------------------- */
+
+/**
+ * @brief Charge un instantané des données de la table live (stations de la
+ * derniere récolte et positions). Thread principal seulement (bdd).
+ *
+ * @param db_belib Connexion à la bdd
+ * @param table Table des stations live
+ * @return DonneesLive* Instantané (à libérer par Free_donnees_live)
+ */
+DonneesLive *Charger_donnees_live(sqlite3 *db_belib, char *table);
+
+/**
+ * @brief Libère un instantané des données de la table live
+ *
+ * @param donnees Pointeur vers un objet de type DonneesLive
+ */
+void Free_donnees_live(DonneesLive *donnees);
+
+/**
+ * @brief Ouvre la socket unix d'écoute du serveur (une socket restée d'un
+ * précédent lancement est remplacée). Droits 0660 : seuls l'utilisateur du
+ * serveur et le groupe de la socket peuvent s'y connecter.
+ *
+ * @param chemin Chemin de la socket
+ * @param groupe Groupe de la socket (celui du serveur web), NULL : groupe
+ * du process
+ * @return int Descripteur de la socket
+ */
+int Ouvrir_socket_live(const char *chemin, const char *groupe);
+
+/**
+ * @brief Lit une requete (une ligne) sur la socket d'un client
+ *
+ * @param client Socket du client
+ * @param ligne Tampon de la ligne (sortie, sans le \n)
+ * @param taille Taille du tampon
+ * @return int 0 si ok, -1 si fin de connexion, délai dépassé ou ligne trop longue
+ */
+int Lire_requete(int client, char *ligne, size_t taille);
+
+/**
+ * @brief Analyse les champs d'une requete (voir en-tete du fichier)
+ *
+ * @param ligne Ligne de la requete (modifiée)
+ * @param requete Paramètres de la requete (sortie)
+ * @return const char* NULL si ok, message d'erreur sinon
+ */
+const char *Analyse_requete(char *ligne, RequeteLive *requete);
+
+/**
+ * @brief Teste si un nom de fichier demandé est celui d'une figure live :
+ * FICHIER_LIVE_PREFIXE, puis lettres minuscules, chiffres ou '_', puis 
+ * FICHIER_LIVE_SUFFIXE et l'extension du format (.png ou .svg)
+ *
+ * @param nom Nom du fichier
+ * @param svg 1 : figure en svg
+ * @return int 1 si le nom est accepté, 0 sinon
+ */
+int Nom_figure_live(const char *nom, int svg);
+
+/**
+ * @brief Envoie n octets sur la socket d'un client
+ *
+ * @param client Socket du client
+ * @param octets Octets à envoyer
+ * @param n Nombre d'octets
+ * @return int 0 si ok, -1 si le client est parti
+ */
+int Envoyer(int client, const void *octets, size_t n);
+
+/**
+ * @brief Envoie une ligne de réponse formatée comme printf
+ *
+ * @param client Socket du client
+ * @param format Format de la réponse
+ * @return int 0 si ok, -1 si le client est parti
+ */
+int Repondre(int client, const char *format, ...);
+
+/**
+ * @brief Tache du pool : lit et analyse la requete, sélectionne les stations
+ * dans l'instantané courant, trace la figure, répond au client et libère la
+ * requete
+ *
+ * @param arg Pointeur vers la RequeteLive
+ */
+void Tache_requete(void *arg);
+
+/**
+ * @brief Trace la figure d'une requete analysée (sélection faite) et
+ * l'envoie au client ou l'écrit dans le dossier des figures
+ *
+ * @param requete Pointeur vers un objet de type RequeteLive
+ */
+void Rendu_requete(RequeteLive *requete);
+
+/**
+ * @brief Ajoute une latence à l'histogramme
+ *
+ * @param stats Pointeur vers un objet de type StatsLatence
+ * @param debut Date de début de la requete (CLOCK_MONOTONIC)
+ */
+void Ajout_latence(StatsLatence *stats, const struct timespec *debut);
+
+/**
+ * @brief Renvoie le percentile p des latences (borne haute de la case)
+ *
+ * @param stats Pointeur vers un objet de type StatsLatence (verrouillé)
+ * @param p Percentile entre 0 et 1
+ * @return double Latence en ms
+ */
+double Percentile_latence(StatsLatence *stats, double p);
+
+/**
+ * @brief Ecrit le résumé des latences (nombre, p50, p99, max) dans texte
+ *
+ * @param stats Pointeur vers un objet de type StatsLatence
+ * @param texte Tampon du résumé
+ * @param taille Taille du tampon
+ */
+void Resume_latences(StatsLatence *stats, char *texte, size_t taille);
+
+/**
+ * @brief Handler de SIGINT et SIGTERM : demande l'arrêt du serveur
+ *
+ * @param numero Signal reçu
+ */
+void Arret_serveur(int numero);
+
+
+/* =========================================================================== */
+int main(int argc, char* argv[])
+{
+    // Recuperation du filepath de la db sqlite
+    char *bdd_filename = argv[1];
+
+    // Test de presence d'un argument
+    if (bdd_filename == NULL)
+    {
+        printf("Erreur : argument non spécifié. Le programme attend le nom d'un \
+                        fichier en entrée. \n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Options : --socket <chemin> : socket du serveur
+    //           --groupe <nom> : groupe de la socket (utilisateur du CGI)
+    //           --truecolor : png en RGB 24 bits au lieu de png à palette
+    const char *chemin_socket = SOCKET_LIVE_DEFAUT;
+    const char *groupe_socket = NULL;
+    char palette_png = 'y';
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--socket") == 0 && i+1 < argc)
+            chemin_socket = argv[++i];
+        else if (strcmp(argv[i], "--groupe") == 0 && i+1 < argc)
+            groupe_socket = argv[++i];
+        else if (strcmp(argv[i], "--truecolor") == 0)
+            palette_png = 'n';
+        else {
+            printf("Erreur : option %s inconnue. Options : --socket <chemin>, "\
+                        "--groupe <nom>, --truecolor.\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Parametres generaux
+    #if defined QEMU
+        char *dir_figures= "/var/www/html/figures/"; /**< Path folder save fig*/
+    #else
+        char *dir_figures= "./figures/"; /**< Path folder save fig*/
+    #endif
+
+    char fichier_couche[strlen(bdd_filename)+13];
+    sprintf(fichier_couche, "%s.couche_live", bdd_filename);
+
+    ServeurLive serveur = {.dir_figures = dir_figures, .fichier_couche = fichier_couche,\
+                           .palette_png = palette_png, .nb_en_cours = 0};
+    pthread_mutex_init(&serveur.mutex, NULL);
+    pthread_cond_init(&serveur.cond_place, NULL);
+    pthread_mutex_init(&serveur.mutex_fichiers, NULL);
+    Init_cache_couches(&serveur.couches);
+    memset(&serveur.latences, 0, sizeof(serveur.latences));
+    pthread_mutex_init(&serveur.latences.mutex, NULL);
+
+    // ========================================================================
+    // Etat gardé entre les requetes : connexion, données, polices
+    // ========================================================================
+
+    // Connexion a la db sqlite (utilisée par le seul thread principal)
+    sqlite3 *db_belib;
+    Sqlite_open_check(bdd_filename, &db_belib);
+
+    char* table = "Stations_live";
+
+    // Données de la table, remplacées quand la bdd est modifiée
+    serveur.donnees = Charger_donnees_live(db_belib, table);
+    pthread_rwlock_init(&serveur.verrou_donnees, NULL);
+
+    Init_cache_polices();
+
+    // Figure de chauffe : couche statique en mémoire (et sur disque), 
+    // polices chargées, la premiere requete ne paie pas ces initialisations
+    SelectionLive selection_chauffe;
+    Selection_stations_live(&serveur.donnees->data, NULL, 0., 0., 0., &selection_chauffe);
+    if (selection_chauffe.nb_stations > 0) {
+        FigureLive fig_live;
+        size_t taille;
+        Init_figure_live(&fig_live, &selection_chauffe, palette_png, 0, 0);
+        Trace_figure_live(&fig_live, fichier_couche, &serveur.couches);
+        free(Figure_en_memoire(&(fig_live.fig), &taille));
+        Destroy_figure(&(fig_live.fig));
+    }
+    Free_selection_live(&selection_chauffe);
+
+    // ========================================================================
+    // Socket et pool de rendu
+    // ========================================================================
+
+    int serveur_fd = Ouvrir_socket_live(chemin_socket, groupe_socket);
+
+    // Client parti avant la réponse : erreur d'envoi au lieu de SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    // SIGINT et SIGTERM bloqués dans les workers (masque hérité), reçus par
+    // le thread principal : ils interrompent accept
+    sigset_t signaux_arret;
+    sigemptyset(&signaux_arret);
+    sigaddset(&signaux_arret, SIGINT);
+    sigaddset(&signaux_arret, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signaux_arret, NULL);
+
+    // Une figure par worker : l'encodeur png n'est pas découpé en blocs. Au
+    // moins 2 workers : un client lent à envoyer sa requete n'arrête pas les
+    // rendus, même sur un seul coeur
+    PoolTaches pool;
+    int nb_threads = Max_int(Nb_threads_pool(POOL_NB_THREADS_MAX), 2);
+    Init_pool_taches(&pool, nb_threads);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = Arret_serveur;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    pthread_sigmask(SIG_UNBLOCK, &signaux_arret, NULL);
+
+    printf("> Serveur live pret sur %s (%d threads, %d stations).\n",\
+                chemin_socket, nb_threads, serveur.donnees->data.nb_stations);
+    fflush(stdout);
+
+    while (!arret_serveur) {
+        int client = accept(serveur_fd, NULL, NULL);
+        if (client < 0) {
+            if (errno != EINTR)
+                printf("Info : accept impossible (%s).\n", strerror(errno));
+            continue;
+        }
+
+        RequeteLive *requete = malloc(sizeof(RequeteLive));
+        if (requete == NULL) {
+            printf("Erreur : Pas assez de memoire.\n");
+            exit(EXIT_FAILURE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &requete->debut);
+        requete->client = client;
+        requete->serveur = &serveur;
+
+        // Bdd modifiée depuis le chargement : nouvel instantané chargé hors
+        // verrou, puis échangé. Les taches en cours gardent leur sélection.
+        // L'epoch max ne suffit pas : le CGI vide et remplit la table à la
+        // minute près, deux adresses dans la même minute ont le même epoch.
+        if (Get_version_bdd(db_belib, table) != serveur.donnees->version) {
+            DonneesLive *nouvelles = Charger_donnees_live(db_belib, table);
+
+            pthread_rwlock_wrlock(&serveur.verrou_donnees);
+            DonneesLive *anciennes = serveur.donnees;
+            serveur.donnees = nouvelles;
+            pthread_rwlock_unlock(&serveur.verrou_donnees);
+
+            Free_donnees_live(anciennes);
+        }
+        Reset_stmts();
+
+        // Au plus POOL_NB_TACHES_MAX requetes confiées au pool
+        pthread_mutex_lock(&serveur.mutex);
+        while (serveur.nb_en_cours == POOL_NB_TACHES_MAX)
+            pthread_cond_wait(&serveur.cond_place, &serveur.mutex);
+        serveur.nb_en_cours++;
+        pthread_mutex_unlock(&serveur.mutex);
+
+        Ajout_tache(&pool, Tache_requete, requete);
+    }
+
+    // ========================================================================
+    // Arrêt : requetes en cours terminées, latences affichées
+    // ========================================================================
+
+    close(serveur_fd);
+    unlink(chemin_socket);
+    Free_pool_taches(&pool);
+
+    char resume[128];
+    Resume_latences(&serveur.latences, resume, sizeof(resume));
+    printf("> Serveur live arrete : %s\n", resume);
+
+    // Clean alloc
+    Free_donnees_live(serveur.donnees);
+    pthread_rwlock_destroy(&serveur.verrou_donnees);
+    Sqlite_close(db_belib);
+    Free_cache_polices();
+    Free_cache_couches(&serveur.couches);
+    pthread_mutex_destroy(&serveur.mutex);
+    pthread_cond_destroy(&serveur.cond_place);
+    pthread_mutex_destroy(&serveur.mutex_fichiers);
+    pthread_mutex_destroy(&serveur.latences.mutex);
+
+    return 0;
+}
+
+
+/* --------------------------------------------------------------------------- */
+// Définition des fonctions
+/* --------------------------------------------------------------------------- */
+
+/* --------------------------------------------------------------------------- */
+DonneesLive *Charger_donnees_live(sqlite3 *db_belib, char *table)
+{
+    DonneesLive *donnees = malloc(sizeof(DonneesLive));
+    if (donnees == NULL) {
+        printf("Erreur : Pas assez de memoire.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Version lue avant les données : une écriture pendant le chargement
+    // sera vue à la requete suivante
+    donnees->version = Get_version_bdd(db_belib, table);
+    Get_stations_data(db_belib, table, NB_STATUTS_LIVE, NULL, &donnees->data);
+
+    donnees->positions = malloc(Max_int(donnees->data.nb_stations, 1)*sizeof(*donnees->positions));
+    if (donnees->positions == NULL) {
+        printf("Erreur : Pas assez de memoire.\n");
+        exit(EXIT_FAILURE);
+    }
+    Get_positions(db_belib, table, &donnees->data, donnees->positions);
+
+    return donnees;
+}
+
+/* --------------------------------------------------------------------------- */
+void Free_donnees_live(DonneesLive *donnees)
+{
+    Free_stations_data(&donnees->data);
+    free(donnees->positions);
+    free(donnees);
+}
+
+/* --------------------------------------------------------------------------- */
+int Ouvrir_socket_live(const char *chemin, const char *groupe)
+{
+    struct sockaddr_un adresse;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sun_family = AF_UNIX;
+
+    if (strlen(chemin) >= sizeof(adresse.sun_path)) {
+        printf("Erreur : chemin de socket trop long (%s).\n", chemin);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(adresse.sun_path, chemin);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        printf("Erreur : creation de la socket impossible (%s).\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    unlink(chemin);
+    if (bind(fd, (struct sockaddr *)&adresse, sizeof(adresse)) != 0 \
+            || listen(fd, 64) != 0) {
+        printf("Erreur : ecoute sur %s impossible (%s).\n", chemin, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    // Le CGI tourne sous l'utilisateur du serveur web : il se connecte via
+    // le groupe de la socket, les autres utilisateurs n'y ont pas accès
+    if (groupe != NULL) {
+        struct group *gr = getgrnam(groupe);
+        if (gr == NULL) {
+            printf("Erreur : groupe %s inconnu.\n", groupe);
+            exit(EXIT_FAILURE);
+        }
+        if (chown(chemin, -1, gr->gr_gid) != 0) {
+            printf("Erreur : socket %s non attribuable au groupe %s (%s).\n",\
+                        chemin, groupe, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    chmod(chemin, 0660);
+
+    return fd;
+}
+
+/* --------------------------------------------------------------------------- */
+int Lire_requete(int client, char *ligne, size_t taille)
+{
+    size_t n = 0;
+
+    while (n < taille - 1) {
+        ssize_t lu = read(client, ligne + n, taille - 1 - n);
+        if (lu <= 0) return -1;
+
+        char *fin = memchr(ligne + n, '\n', lu);
+        n += lu;
+        if (fin != NULL) {
+            *fin = '\0';
+            if (fin > ligne && fin[-1] == '\r') fin[-1] = '\0';
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/* --------------------------------------------------------------------------- */
+const char *Analyse_requete(char *ligne, RequeteLive *requete)
+{
+    requete->lat = 0.;
+    requete->lon = 0.;
+    requete->rayon = 0.;
+    requete->svg = 0;
+    requete->fichier[0] = '\0';
+
+    int position = 0;   // 1 bit par coordonnée reçue
+    char *reste = NULL;
+
+    for (char *champ = strtok_r(ligne, " \t", &reste); champ != NULL;\
+            champ = strtok_r(NULL, " \t", &reste)) {
+        char *valeur = strchr(champ, '=');
+        if (valeur == NULL) return "champ sans valeur";
+        *valeur++ = '\0';
+
+        char *fin;
+        if (strcmp(champ, "lat") == 0 || strcmp(champ, "lon") == 0 \
+                || strcmp(champ, "rayon") == 0) {
+            double x = strtod(valeur, &fin);
+            if (fin == valeur || *fin != '\0') return "nombre invalide";
+
+            if (strcmp(champ, "lat") == 0) {
+                requete->lat = x;
+                position |= 1;
+            }
+            else if (strcmp(champ, "lon") == 0) {
+                requete->lon = x;
+                position |= 2;
+            }
+            else
+                requete->rayon = x;
+        }
+        else if (strcmp(champ, "format") == 0) {
+            if (strcmp(valeur, "png") == 0) requete->svg = 0;
+            else if (strcmp(valeur, "svg") == 0) requete->svg = 1;
+            else return "format inconnu (png, svg)";
+        }
+        else if (strcmp(champ, "fichier") == 0) {
+            // Nom vérifié une fois le format connu
+            if (strlen(valeur) >= FICHIER_LONGUEUR_MAX)
+                return "nom de fichier invalide";
+            strcpy(requete->fichier, valeur);
+        }
+        else
+            return "champ inconnu";
+    }
+
+    if (requete->rayon > 0. && position != 3)
+        return "rayon sans lat et lon";
+
+    if (requete->fichier[0] != '\0' && !Nom_figure_live(requete->fichier, requete->svg))
+        return "nom de fichier invalide (fig.._live.png ou .svg selon le format)";
+
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------- */
+int Nom_figure_live(const char *nom, int svg)
+{
+    const char *extension = svg ? ".svg" : ".png";
+    size_t len = strlen(nom);
+    size_t len_prefixe = strlen(FICHIER_LIVE_PREFIXE);
+    size_t len_suffixe = strlen(FICHIER_LIVE_SUFFIXE);
+    size_t len_fin = len_suffixe + strlen(extension);
+
+    if (len <= len_prefixe + len_fin \
+            || strncmp(nom, FICHIER_LIVE_PREFIXE, len_prefixe) != 0 \
+            || strncmp(nom + len - len_fin, FICHIER_LIVE_SUFFIXE, len_suffixe) != 0 \
+            || strcmp(nom + len - strlen(extension), extension) != 0)
+        return 0;
+
+    // Milieu du nom : ni point, ni séparateur de chemin
+    size_t len_milieu = len - len_prefixe - len_fin;
+    return strspn(nom + len_prefixe, "abcdefghijklmnopqrstuvwxyz0123456789_") >= len_milieu;
+}
+
+/* --------------------------------------------------------------------------- */
+int Envoyer(int client, const void *octets, size_t n)
+{
+    const char *p = octets;
+
+    while (n > 0) {
+        ssize_t envoye = send(client, p, n, MSG_NOSIGNAL);
+        if (envoye < 0 && errno == EINTR) continue;
+        if (envoye <= 0) return -1;
+        p += envoye;
+        n -= envoye;
+    }
+
+    return 0;
+}
+
+/* --------------------------------------------------------------------------- */
+int Repondre(int client, const char *format, ...)
+{
+    char reponse[256];
+    va_list args;
+
+    va_start(args, format);
+    int n = vsnprintf(reponse, sizeof(reponse), format, args);
+    va_end(args);
+
+    if (n < 0) return -1;
+    if ((size_t)n >= sizeof(reponse)) n = sizeof(reponse) - 1;
+
+    return Envoyer(client, reponse, n);
+}
+
+/* --------------------------------------------------------------------------- */
+void Tache_requete(void *arg)
+{
+    RequeteLive *requete = arg;
+    ServeurLive *serveur = requete->serveur;
+    int client = requete->client;
+
+    // Un client muet ou lent n'occupe pas un worker plus de 2 s
+    struct timeval delai = {2, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &delai, sizeof(delai));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &delai, sizeof(delai));
+
+    char ligne[REQUETE_LONGUEUR_MAX];
+    const char *erreur = NULL;
+    int stats = 0;
+
+    if (Lire_requete(client, ligne, sizeof(ligne)) != 0)
+        erreur = "requete illisible";
+    else if (strcmp(ligne, "stats") == 0)
+        stats = 1;
+    else
+        erreur = Analyse_requete(ligne, requete);
+
+    if (stats) {
+        char resume[128];
+        Resume_latences(&serveur->latences, resume, sizeof(resume));
+        Repondre(client, "OK %s\n", resume);
+    }
+    else {
+        if (erreur == NULL) {
+            // Stations copiées depuis l'instantané courant
+            pthread_rwlock_rdlock(&serveur->verrou_donnees);
+            Selection_stations_live(&serveur->donnees->data, serveur->donnees->positions,\
+                                    requete->lat, requete->lon, requete->rayon,\
+                                    &(requete->selection));
+            pthread_rwlock_unlock(&serveur->verrou_donnees);
+
+            if (requete->selection.nb_stations == 0) {
+                Free_selection_live(&(requete->selection));
+                erreur = "pas de stations dans le rayon";
+            }
+        }
+
+        if (erreur != NULL)
+            Repondre(client, "ERR %s\n", erreur);
+        else {
+            Rendu_requete(requete);
+            Free_selection_live(&(requete->selection));
+        }
+        Ajout_latence(&serveur->latences, &requete->debut);
+    }
+
+    close(client);
+    free(requete);
+
+    pthread_mutex_lock(&serveur->mutex);
+    serveur->nb_en_cours--;
+    pthread_cond_signal(&serveur->cond_place);
+    pthread_mutex_unlock(&serveur->mutex);
+}
+
+/* --------------------------------------------------------------------------- */
+void Rendu_requete(RequeteLive *requete)
+{
+    ServeurLive *serveur = requete->serveur;
+
+    FigureLive fig_live;
+    Figure *fig = &(fig_live.fig);
+    Init_figure_live(&fig_live, &(requete->selection), serveur->palette_png,\
+                        requete->svg, 0);
+
+    if (requete->fichier[0] != '\0') {
+        // Figure dans le dossier des figures, redessinée si son empreinte a
+        // changé. Figure et empreinte écrites ensemble : une requete sur le
+        // même fichier ne peut pas intercaler les siennes.
+        int ok = 1;
+        if (!Png_a_jour(serveur->dir_figures, requete->fichier, fig_live.hash)) {
+            Trace_figure_live(&fig_live, serveur->fichier_couche, &serveur->couches);
+
+            pthread_mutex_lock(&serveur->mutex_fichiers);
+            ok = Save_figure(fig, serveur->dir_figures, requete->fichier) == 0;
+            if (ok)
+                Sauver_etag_figure(serveur->dir_figures, requete->fichier, fig_live.hash);
+            pthread_mutex_unlock(&serveur->mutex_fichiers);
+        }
+
+        if (ok)
+            Repondre(requete->client, "OK %s\n", requete->fichier);
+        else
+            Repondre(requete->client, "ERR ecriture de %s impossible\n", requete->fichier);
+    }
+    else {
+        // Octets de la figure renvoyés au client
+        Trace_figure_live(&fig_live, serveur->fichier_couche, &serveur->couches);
+
+        size_t taille;
+        char *tampon = Figure_en_memoire(fig, &taille);
+        if (tampon == NULL)
+            Repondre(requete->client, "ERR encodage de la figure impossible\n");
+        else if (Repondre(requete->client, "OK %zu\n", taille) == 0)
+            Envoyer(requete->client, tampon, taille);
+        free(tampon);
+    }
+
+    Destroy_figure(fig);
+}
+
+/* --------------------------------------------------------------------------- */
+void Ajout_latence(StatsLatence *stats, const struct timespec *debut)
+{
+    struct timespec fin;
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+
+    double ms = (fin.tv_sec - debut->tv_sec)*1e3 + (fin.tv_nsec - debut->tv_nsec)*1e-6;
+    int c = (int)(ms / LATENCE_PAS_MS);
+    if (c >= LATENCE_NB_CASES) c = LATENCE_NB_CASES - 1;
+
+    pthread_mutex_lock(&stats->mutex);
+    stats->cases[c]++;
+    stats->nb++;
+    if (ms > stats->max_ms) stats->max_ms = ms;
+    pthread_mutex_unlock(&stats->mutex);
+}
+
+/* --------------------------------------------------------------------------- */
+double Percentile_latence(StatsLatence *stats, double p)
+{
+    // Rang de la requete du percentile (1 à nb)
+    long rang = (long)ceil(p * stats->nb);
+    if (rang < 1) rang = 1;
+
+    long cumul = 0;
+    for (int c = 0; c < LATENCE_NB_CASES; c++) {
+        cumul += stats->cases[c];
+        if (cumul >= rang)
+            return fmin((c + 1) * LATENCE_PAS_MS, stats->max_ms);
+    }
+
+    return stats->max_ms;
+}
+
+/* --------------------------------------------------------------------------- */
+void Resume_latences(StatsLatence *stats, char *texte, size_t taille)
+{
+    pthread_mutex_lock(&stats->mutex);
+    if (stats->nb == 0)
+        snprintf(texte, taille, "requetes=0");
+    else
+        snprintf(texte, taille, "requetes=%ld p50=%.1fms p99=%.1fms max=%.1fms",\
+                    stats->nb, Percentile_latence(stats, 0.50),\
+                    Percentile_latence(stats, 0.99), stats->max_ms);
+    pthread_mutex_unlock(&stats->mutex);
+}
+
+/* --------------------------------------------------------------------------- */
+void Arret_serveur(int numero)
+{
+    (void)numero;
+    arret_serveur = 1;
+}
@@ -16,155 +16,106 @@
 #include "libs/consts.h"
 #include "libs/traitement.h"
 #include "libs/getter.h"
+#include "libs/etat.h"
 #include "libs/plotter.h"
+#include "libs/couche.h"
+#include "libs/svg.h"
+#include "libs/pool.h"
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Données d'entrée et paramètres communs des figures, partagés en 
+ * lecture seule par les taches de tracé (une tache par figure)
+ * 
+ */
+typedef struct DonneesFigures_s {
+    int nb_stations;            /**< Nombre de stations fav */
+    int nb_rows;                /**< Nombre de recoltes par station */
+    int nb_statuts;             /**< Nombre de statuts */
+    Date *tableau_date_recolte; /**< Dates des recoltes */
+    StatusCube *cube_statuts;   /**< Cube des statuts (station x recolte) */
+    char **adresse_label;       /**< Labels des stations */
+    int nb_rows_hours;          /**< Nombre d'heures pour la moyenne horaire */
+    int *tableau_avg_hours;     /**< Vecteur des heures */
+    float *tableau_avg_dispo_station; /**< Moyenne horaire [nb_stations][nb_rows_hours] */
+    char *subtitle;             /**< Sous titre "du ... au ..." de la fenetre (fig1) */
+    char *subtitle_avg;         /**< Sous titre "du ... au ..." de l'agregat horaire (fig3) */
+    const char *bdd_filename;   /**< Bdd (les couches statiques sont à côté) */
+    const char *dir_figures;    /**< Path folder save fig */
+    int figsize[2];             /**< Dimension figure */
+    int padX[2];                /**< pad zone de dessin gauche et droite */
+    int padY[2];                /**< pad zone de dessin haut et bas */
+    int margin[2];              /**< margin gauche droite zone de dessin */
+    char *github;               /**< Lien github (annotation) */
+    char *sign;                 /**< Copyright (annotation) */
+    char palette_png;           /**< 'y' : png à palette, 'n' : truecolor (--truecolor) */
+    int svg;                    /**< 1 : figures en svg au lieu de png (--svg) */
+} DonneesFigures;
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Tache de tracé de la figure 1 : evolution temporelle disponibilite 
+ * belib fav
+ * 
+ * @param arg Pointeur vers les DonneesFigures
+ */
+void Tache_fig1(void *arg);
+
+/**
+ * @brief Tache de tracé de la figure 2 : barplot des statuts des bornes par 
+ * station pour la derniere recolte
+ * 
+ * @param arg Pointeur vers les DonneesFigures
+ */
+void Tache_fig2(void *arg);
+
+/**
+ * @brief Tache de tracé de la figure 3 : variation de la moyenne horaire de 
+ * dispo
+ * 
+ * @param arg Pointeur vers les DonneesFigures
+ */
+void Tache_fig3(void *arg);
 
 /* =========================================================================== */
-int main(int argc, char* argv[]) 
+void Tache_fig1(void *arg)
 {
-    // ========================================================================
-    // Récupération des données de la db sqlite
-    // ========================================================================
-
-    // Recuperation du filepath de la db sqlite
-    char *bdd_filename = argv[1];
-
-    // Test de presence d'un argument
-    if (bdd_filename == NULL)
-    {
-        printf("Erreur : argument non spécifié. Le programme attend le nom d'un \
-                        fichier en entrée. \n");
-        exit(EXIT_FAILURE);
-    }
-    
-    // Instanciation db sqlite
-    sqlite3 *db_belib;
-
-    // Connexion a la db sqlite
-    Sqlite_open_check(bdd_filename, &db_belib);
-    
-    // Choix de la table de travail
-    char* table = "Stations_fav";
-
-    // Recuperation du nombre de stations en favoris
-    int nb_stations_fav = Get_nb_stations(db_belib, table);
-
-    // Recuperation du nombre de lignes par station
-    int nb_rows_par_station = Get_nb_rows_par_station(db_belib, table);
-    // printf(" > Nb rows : %d \n", nb_rows_par_station);
-
-    // Recuperation des adresses des stations en favoris
-    char *tableau_adresses_fav[nb_stations_fav];
-    Get_adresses(db_belib, table, tableau_adresses_fav, nb_stations_fav);
-
-    // On retire "Paris" des adresses pour les labels fig
-    char *adresse_label[nb_stations_fav];
-    for (int i = 0; i < nb_stations_fav; i++) {
-        char label_tmp[100];
-        int len_adresse = strlen(tableau_adresses_fav[i]);
-        slice_str(tableau_adresses_fav[i], label_tmp, 0, len_adresse-6);
-        // Stockage des labels
-        adresse_label[i] = strdup(label_tmp);
-    }
-
-    // Recuperation des date de recolte de chaque station (same for all)
-    Date tableau_date_recolte_fav[nb_rows_par_station];
-    Get_date_recolte(db_belib, table, tableau_date_recolte_fav, nb_rows_par_station);
-
-    // Datetick datetick;
-    // Init_Datetick(&datetick, &tableau_date_recolte_fav[1], &tableau_date_recolte_fav[0]);
-    // Print_debug_date(&tableau_date_recolte_fav[1], 'n');
-    // Print_debug_datetick(&datetick);
-
-    // Recuperation des statuts par station fav
-    int nb_statuts = 4; /**< disponible occupe en_maintenance inconnu*/
-    int tableau_statuts_fav[nb_stations_fav][nb_rows_par_station][nb_statuts];
-    
-    // Remplissage du tableau avec la bdd belib_data
-    Get_statuts_station(db_belib, table,\
-                                tableau_adresses_fav, nb_stations_fav,\
-                                 nb_rows_par_station, nb_statuts,
-                                 tableau_statuts_fav);
-
-    // Verif que ca colle avec la db
-    /*Print_tableau_fav(nb_stations_fav, nb_rows_par_station, nb_statuts,\
-             tableau_statuts_fav, tableau_date_recolte_fav, tableau_adresses_fav);*/
-    
-    // Mean avg per hour
-    int nb_rows_hours = Get_nb_avg_hours(db_belib);
-    // printf("Nb d'heures pour calc moyenne : %d\n", nb_rows_hours);
-
-    // Recuperation vecteur des heures
-    int tableau_avg_hours[nb_rows_hours];
-    Get_avg_hours(db_belib, nb_rows_hours, tableau_avg_hours);
-
-    // for (int i=0; i < nb_rows_hours; i++)
-    //     printf("avg hour %d : %d\n",i,tableau_avg_hours[i]);
-
-    // Recuperation moyenne horaire dispo stations
-    float tableau_avg_dispo_station[nb_stations_fav][nb_rows_hours];
-    Get_avg_dispo_station(db_belib, \
-                        tableau_adresses_fav, \
-                        nb_stations_fav, nb_rows_hours, \
-                        tableau_avg_dispo_station);
-
-    // for (int station=0; station < nb_stations_fav; station++)
-    //     for (int h=0; h < nb_rows_hours; h++)
-    //         printf("Avg dispo Station %d à %02d:00 : %.1f \n",station, h, tableau_avg_dispo_station[station][h]);
-
-    // for (int h=0; h < nb_rows_hours; h++)
-    //     printf("Avg dispo Station %d à %02d:00 : %.1f \n",6, h, tableau_avg_dispo_station[5][h]);
-
-    // Fermeture db
-    sqlite3_close(db_belib);
-
-    // ========================================================================
-    // Parametres generaux des figures
-    // ========================================================================
-
-    // Parametres generaux
-    #if defined QEMU
-        char *dir_figures= "/var/www/html/figures/"; /**< Path folder save fig*/
-    #else
-        char *dir_figures= "./figures/"; /**< Path folder save fig*/
-    #endif
-    
-    // char *dir_figures= "./figures/"; /**< Path folder save fig*/
-    int figsize[2] = {800, 700};     /**< Dimension figure */
-    int padX[2] = {90,0};            /**< pad zone de dessin gauche et droite*/
-    int padY[2] = {120,160};          /**< pad zone de dessin haut et bas*/
-    int margin[2] = {10,10};         /**< margin gauche droite zone de dessin*/
+    DonneesFigures *donnees = arg;
+    int nb_stations_fav = donnees->nb_stations;
+    int nb_rows_par_station = donnees->nb_rows;
+    Date *tableau_date_recolte_fav = donnees->tableau_date_recolte;
+    StatusCube *cube_statuts = donnees->cube_statuts;
+    char **adresse_label = donnees->adresse_label;
+    const char *dir_figures = donnees->dir_figures;
 
     int w_lines = 4;                 /**< epaisseur des traits*/
     int ms = 6;                      /**< marker size */
 
-    // ========================================================================
-    // Creation de la figure 1 : evolution temporelle disponibilite belib fav
-    // ========================================================================
-
     // Creation de la figure ------------------------------------------------------------
     Figure fig1;
     char wAxes = 'n';
-    Init_figure(&fig1, figsize, padX, padY, margin, wAxes);
+    Init_figure(&fig1, donnees->figsize, donnees->padX, donnees->padY,\
+                donnees->margin, wAxes);
+    Change_palette_png(&fig1, donnees->palette_png);
+    if (donnees->svg)
+        Change_backend_svg(&fig1);
 
-    // Recup vecteur temps
-    int vect_time[nb_rows_par_station];
+    // Historique long : courbes réduites à 2 points par pixel (LTTB) avant tracé
+    Change_sous_echantillonnage(&fig1, 2);
+
+    // Recup vecteur temps (dans l'arène de la figure, libéré avec elle)
+    int *vect_time = Alloc_arene(&fig1.arene, nb_rows_par_station*sizeof(int));
     Get_time_vect(nb_rows_par_station, vect_time, tableau_date_recolte_fav);
     // print_arr1D(nb_rows_par_station, vect_time, 'n');
 
-    // Recup vecteurs Y dans les linedata de la figure 
-    int vect_nb_dispo[nb_stations_fav][nb_rows_par_station]; /**< vecteur nb _disponible 
-    par station*/
+    // Vecteurs Y des linedata : colonnes du cube (uint16) lues sans copie,
+    // élargies en int au tracé
     char style_trait;
     LineData lines[nb_stations_fav]; /**< vecteur de linedata pour chaque station*/
     LineStyle linestyles[nb_stations_fav];  /**< vecteur de linestyle pour chaque station*/
     
     for (int st = 0; st < nb_stations_fav; st ++)
     {
-        Get_statut_station(nb_stations_fav, nb_rows_par_station, nb_statuts,\
-                    vect_nb_dispo[st], \
-                    tableau_statuts_fav,
-                    st, disponible);
-
         style_trait = '-';
         // if (st % 2 != 0) {
         //     style_trait = ':';
@@ -172,110 +123,146 @@ int main(int argc, char* argv[])
         Init_linestyle(&(linestyles[st]), style_trait, color_lines[st], w_lines,'o', ms);
         Init_linedata(&(lines[st]), nb_rows_par_station, \
                     vect_time, \
-                    vect_nb_dispo[st], adresse_label[st], &(linestyles[st]));
+                    Cube_col(cube_statuts, disponible, st), adresse_label[st],\
+                    &(linestyles[st]));
         Add_line_to_fig(&fig1, &(lines[st]));
     }
     
-    /* Make ylabel  ----------  A mettre apres update fig */
+    // Couche statique (fond, ylabel, titre, legende, annotations) : relue
+    // depuis le cache si rien n'a changé, dessinée et sauvegardée sinon
     int decalx_Y = 20, decaly_Y = 0;    
     char *ylabel = "Bornes disponibles";
     // char *ylabel = "Bornes occupées";
     Change_fontsize(&fig1, label_f, 16);
-    Make_ylabel(&fig1, ylabel, decalx_Y, decaly_Y);
-
-    // /* Make xlabel */
-    // char *xlabel = "Date";
-    // int decalx_X = -5, decaly_X = 15;
-    // Make_xlabel(&fig1, xlabel, decalx_X, decaly_X);
 
-    /* Make title */
     char *title = "\u00c9volution du nombre de bornes Belib disponibles (stations favorites)";
     int decalx_title = -30, decaly_title = 15;
-    int *bbox_title;     /**< bbox : so, se, ne, no */
-    bbox_title = Make_title(&fig1, title, decalx_title, decaly_title);
+    int bbox_title[COUCHE_NB_META];     /**< bbox : so, se, ne, no */
 
-    /* Make subtitle */
-    Date date_debut;
-    Date date_fin;
-    Init_Date(&date_debut, tableau_date_recolte_fav[0].datestr);
-    Init_Date(&date_fin, tableau_date_recolte_fav[nb_rows_par_station-1].datestr);
+    int decalx_leg = 0, decaly_leg = 0, ecart = 8;
 
-        // Construction du sous titre "du .... au ... "
-    char subtitle[25] = "";  
-    Const_str_dudate1_audate2(&date_debut, &date_fin, subtitle);
-    
-    int decalx_subtitle = 0, decaly_subtitle = 0;
-    Make_subtitle(&fig1, subtitle, bbox_title, decalx_subtitle, decaly_subtitle);
+    char *github = donnees->github;
+    int decalx_github = 0, decaly_github = 0;
+
+    char *sign = donnees->sign;
+    int decalx_sign = fig1.img->sx- strlen(sign)*7, decaly_sign = 0;
 
-    /* Make X ticks and grid line*/
-    Make_xticks_xgrid_time(&fig1, tableau_date_recolte_fav[0]);
+    char *textes_fig1[] = {ylabel, title, github, sign};
+    uint64_t cle_fig1 = Cle_couche_statique(&fig1, 4, textes_fig1);
+    char fichier_couche[strlen(donnees->bdd_filename)+10];
+    sprintf(fichier_couche, "%s.couche1", donnees->bdd_filename);
+
+    // Sous titre "du .... au ... "
+    char *subtitle = donnees->subtitle;
+    int decalx_subtitle = 0, decaly_subtitle = 0;
 
-    /* Make Y ticks and grid line*/
     char wTicks = 'n';
     char *path_f_med = fonts_fig[1];
-    Change_font(&fig1, ticklabel_f, path_f_med);
-    Change_fontsize(&fig1, ticklabel_f, 14);    
-    Make_yticks_ygrid(&fig1, wTicks);
 
-    /* Make legend */
-    int decalx_leg = 0, decaly_leg = 0, ecart = 8;
-    Make_legend(&fig1, decalx_leg, decaly_leg, ecart);
+    // Empreinte des entrées : si la figure existante a la même, rien à redessiner
+    const char *filename_fig1= donnees->svg ? "fig1_disponible.svg" : "fig1_disponible.png";
+    char *textes_dyn_fig1[] = {subtitle, tableau_date_recolte_fav[0].datestr};
+    uint64_t hash_fig1 = Hash_figure(&fig1, cle_fig1, 2, textes_dyn_fig1);
 
-    /* Make github link */
-    char *github = "https://github.com/bauj/AJC_projet_belib";
-    int decalx_github = 0, decaly_github = 0;
-    Make_annotation(&fig1, github, decalx_github, decaly_github);
+    if (!Png_a_jour(dir_figures, filename_fig1, hash_fig1)) {
+        if (!Charger_couche_statique(&fig1, fichier_couche, cle_fig1, bbox_title)) {
+            /* Make ylabel  ----------  A mettre apres update fig */
+            Make_ylabel(&fig1, ylabel, decalx_Y, decaly_Y);
 
-    /* Make copyright */
-    char *sign = "\u00a9 2023 by Juba Hamma";
-    int decalx_sign = fig1.img->sx- strlen(sign)*7, decaly_sign = 0;
-    Make_annotation(&fig1, sign, decalx_sign, decaly_sign);
+            // /* Make xlabel */
+            // char *xlabel = "Date";
+            // int decalx_X = -5, decaly_X = 15;
+            // Make_xlabel(&fig1, xlabel, decalx_X, decaly_X);
+
+            /* Make title */
+            memcpy(bbox_title, Make_title(&fig1, title, decalx_title, decaly_title),\
+                    sizeof(bbox_title));
+
+            /* Make legend */
+            Make_legend(&fig1, decalx_leg, decaly_leg, ecart);
 
+            /* Make github link */
+            Make_annotation(&fig1, github, decalx_github, decaly_github);
 
-    /* Plot lines */
-    for (int st = 0; st < nb_stations_fav; st++)
-        PlotLine(&fig1, &(lines[st]));
+            /* Make copyright */
+            Make_annotation(&fig1, sign, decalx_sign, decaly_sign);
 
+            Sauver_couche_statique(&fig1, fichier_couche, cle_fig1, bbox_title);
+        }
 
-     /* Sauvegarde du fichier png */
-    const char *filename_fig1= "fig1_disponible.png";
-    Save_to_png(&fig1, dir_figures, filename_fig1);
+        /* Make subtitle */
+        Make_subtitle(&fig1, subtitle, bbox_title, decalx_subtitle, decaly_subtitle);
+
+        /* Make X ticks and grid line*/
+        Make_xticks_xgrid_time(&fig1, tableau_date_recolte_fav[0]);
+
+        /* Make Y ticks and grid line*/
+        Change_font(&fig1, ticklabel_f, path_f_med);
+        Change_fontsize(&fig1, ticklabel_f, 14);    
+        Make_yticks_ygrid(&fig1, wTicks);
+
+        /* Plot lines */
+        for (int st = 0; st < nb_stations_fav; st++)
+            PlotLine(&fig1, &(lines[st]));
+
+
+         /* Sauvegarde de la figure (png ou svg), empreinte si elle est écrite */
+        if (Save_figure(&fig1, dir_figures, filename_fig1) == 0)
+            Sauver_etag_figure(dir_figures, filename_fig1, hash_fig1);
+    }
 
 
     /* printf("Résolution de l'img : %d x %d dpi\n", gdImageResolutionX(fig1.img),\
                              gdImageResolutionY(fig1.img) );                           
     */
 
-    /* Destroy the image in memory. */
-    gdImageDestroy(fig1.img);
+    /* Destruction de la figure (image + arène) */
+    Destroy_figure(&fig1);
+}
 
-    // ========================================================================
-    // Creation de la figure 2 : barplot des statuts des bornes par station
-    // pour la derniere recolte
-    // ========================================================================
+/* =========================================================================== */
+void Tache_fig2(void *arg)
+{
+    DonneesFigures *donnees = arg;
+    int nb_stations_fav = donnees->nb_stations;
+    int nb_rows_par_station = donnees->nb_rows;
+    int nb_statuts = donnees->nb_statuts;
+    Date *tableau_date_recolte_fav = donnees->tableau_date_recolte;
+    StatusCube *cube_statuts = donnees->cube_statuts;
+    char **adresse_label = donnees->adresse_label;
+    const char *dir_figures = donnees->dir_figures;
 
     // Creation de la figure ------------------------------------------------------------
     Figure fig2;
-    padY[0] = 90;
-    padY[1] = 230;
-    wAxes = 'n';
-    Init_figure(&fig2, figsize, padX, padY, margin, wAxes);
+    int padY[2] = {90, 230};
+    char wAxes = 'n';
+    Init_figure(&fig2, donnees->figsize, donnees->padX, padY, donnees->margin, wAxes);
+    Change_palette_png(&fig2, donnees->palette_png);
+    if (donnees->svg)
+        Change_backend_svg(&fig2);
     
     int nb_tot_bornes;
     // Definition d'un vecteur de bardata pour chaque station
     BarData barplots[nb_stations_fav]; 
+
+    // Statuts de la derniere recolte pour chaque station (lus par les bardata)
+    uint16_t (*statuts_derniere_recolte)[nb_statuts] = \
+                Alloc_arene(&fig2.arene, nb_stations_fav*sizeof(*statuts_derniere_recolte));
         
     // Initialisation de chaque bardata
     for (int st_barplot = 0; st_barplot < nb_stations_fav; st_barplot++) {
         nb_tot_bornes=0;
 
+        Cube_get_statuts(cube_statuts, st_barplot, nb_rows_par_station-1,\
+                            statuts_derniere_recolte[st_barplot]);
+
         for (int statut = disponible; statut <= inconnu; statut ++)
-            nb_tot_bornes += tableau_statuts_fav[st_barplot][nb_rows_par_station-1][statut];
+            nb_tot_bornes += statuts_derniere_recolte[st_barplot][statut];
             
         // printf("%s \n", new_adresse_label[st_barplot]);
 
         Init_bardata(&(barplots[st_barplot]), nb_statuts, labels_ctg, nb_tot_bornes,\
-             tableau_statuts_fav[st_barplot][nb_rows_par_station-1],\
+             statuts_derniere_recolte[st_barplot],\
               color_ctg, adresse_label[st_barplot]);
 
         // Update des data de l'objet figure (gestion des max, posX des barplot)
@@ -290,44 +277,28 @@ int main(int argc, char* argv[])
     // ylabel = "Bornes Belib";
     // Make_ylabel(&fig2, ylabel, decalx_Y, decaly_Y);
 
-    // Ajout des yticks et des ygrid (avant plot pour eviter de plotter par dessus)
-    wTicks = 'n';
-    Change_font(&fig2, ticklabel_f, path_f_med);
-    Change_fontsize(&fig2, ticklabel_f, 14);
-    Make_yticks_ygrid(&fig2, wTicks);
-
-    // Ajout des xticks
-    float angle_labels = 20.;
-    Change_fontsize(&fig2, ticklabel_f, 13);
-    Make_xticks_barplot(&fig2, angle_labels);
-
-    /* Make legend */
+    // Couche statique (fond, legende, annotations, titre)
+    char *path_f_med = fonts_fig[1];
     Change_font(&fig2, leg_f, path_f_med);
     Change_fontsize(&fig2, leg_f, 13);
-    decalx_leg = 0, decaly_leg = 0, ecart = 2;
-    Make_legend_barplot(&fig2, decalx_leg, decaly_leg, ecart);
+    int decalx_leg = 0, decaly_leg = 0, ecart = 2;
 
-    /* Make github link */
-    decalx_github = 0, decaly_github = 0;
-    Make_annotation(&fig2, github, decalx_github, decaly_github);
+    char *github = donnees->github;
+    int decalx_github = 0, decaly_github = 0;
 
-    /* Make copyright */
-    Make_annotation(&fig2, sign, decalx_sign, decaly_sign);
+    char *sign = donnees->sign;
+    int decalx_sign = fig2.img->sx- strlen(sign)*7, decaly_sign = 0;
 
-    // Plot des barplots
-    char wlabels = 'y';
-    for (int st_barplot = 0; st_barplot < nb_stations_fav; st_barplot++) {
-        // Print_debug_bd(fig2.bardata[st_barplot], 'y');
-        PlotBarplot(&fig2, fig2.bardata[st_barplot], wlabels);
-    }
+    char *title = "Disponibilité des bornes Belib (stations favorites)";
+    int decalx_title = 0, decaly_title = 0;
+    int bbox_title[COUCHE_NB_META];
 
-    /* Make title */
-    title = "Disponibilité des bornes Belib (stations favorites)";
-    decalx_title = 0, decaly_title = 0;
-    bbox_title = Make_title(&fig2, title, decalx_title, decaly_title);
+    char *textes_fig2[] = {github, sign, title};
+    uint64_t cle_fig2 = Cle_couche_statique(&fig2, 3, textes_fig2);
+    char fichier_couche[strlen(donnees->bdd_filename)+10];
+    sprintf(fichier_couche, "%s.couche2", donnees->bdd_filename);
 
-    /* Make subtitle */
-        // Recuperation derniere date de recolte    
+    // Sous titre : derniere date de recolte
     Date last_date_recolte = tableau_date_recolte_fav[nb_rows_par_station-1];
     // Print_debug_date(&last_date_recolte, 'y');
 
@@ -345,43 +316,83 @@ int main(int argc, char* argv[])
                      hour_hack,\
                      last_date_recolte.tm.tm_min);
 
-    decalx_subtitle = 0, decaly_subtitle = 0;
-    Make_subtitle(&fig2, subtitle2, bbox_title, decalx_subtitle, decaly_subtitle);
-
-     /* Sauvegarde du fichier png */
-    const char *filename_fig2= "fig2_barplot.png";
-    Save_to_png(&fig2, dir_figures, filename_fig2);
-
-    // Destroying img 
-    gdImageDestroy(fig2.img);
+    // Empreinte des entrées : si la figure existante a la même, rien à redessiner
+    const char *filename_fig2= donnees->svg ? "fig2_barplot.svg" : "fig2_barplot.png";
+    char *textes_dyn_fig2[] = {subtitle2};
+    uint64_t hash_fig2 = Hash_figure(&fig2, cle_fig2, 1, textes_dyn_fig2);
+
+    if (!Png_a_jour(dir_figures, filename_fig2, hash_fig2)) {
+        if (!Charger_couche_statique(&fig2, fichier_couche, cle_fig2, bbox_title)) {
+            /* Make legend */
+            Make_legend_barplot(&fig2, decalx_leg, decaly_leg, ecart);
+
+            /* Make github link */
+            Make_annotation(&fig2, github, decalx_github, decaly_github);
+
+            /* Make copyright */
+            Make_annotation(&fig2, sign, decalx_sign, decaly_sign);
+
+            /* Make title */
+            memcpy(bbox_title, Make_title(&fig2, title, decalx_title, decaly_title),\
+                    sizeof(bbox_title));
+
+            Sauver_couche_statique(&fig2, fichier_couche, cle_fig2, bbox_title);
+        }
+
+        // Ajout des yticks et des ygrid (avant plot pour eviter de plotter par dessus)
+        char wTicks = 'n';
+        Change_font(&fig2, ticklabel_f, path_f_med);
+        Change_fontsize(&fig2, ticklabel_f, 14);
+        Make_yticks_ygrid(&fig2, wTicks);
+
+        // Ajout des xticks
+        float angle_labels = 20.;
+        Change_fontsize(&fig2, ticklabel_f, 13);
+        Make_xticks_barplot(&fig2, angle_labels);
+
+        // Plot des barplots
+        char wlabels = 'y';
+        for (int st_barplot = 0; st_barplot < nb_stations_fav; st_barplot++) {
+            // Print_debug_bd(fig2.bardata[st_barplot], 'y');
+            PlotBarplot(&fig2, fig2.bardata[st_barplot], wlabels);
+        }
+
+        /* Make subtitle */
+        int decalx_subtitle = 0, decaly_subtitle = 0;
+        Make_subtitle(&fig2, subtitle2, bbox_title, decalx_subtitle, decaly_subtitle);
+
+         /* Sauvegarde de la figure (png ou svg), empreinte si elle est écrite */
+        if (Save_figure(&fig2, dir_figures, filename_fig2) == 0)
+            Sauver_etag_figure(dir_figures, filename_fig2, hash_fig2);
+    }
 
+    // Destruction de la figure (image + arène)
+    Destroy_figure(&fig2);
+}
 
-    // ========================================================================
-    // Creation de la figure 3 : Variation de la moyenne horaire de dispo
-    // ========================================================================
+/* =========================================================================== */
+void Tache_fig3(void *arg)
+{
+    DonneesFigures *donnees = arg;
+    int nb_stations_fav = donnees->nb_stations;
+    char **adresse_label = donnees->adresse_label;
+    int nb_rows_hours = donnees->nb_rows_hours;
+    int *tableau_avg_hours = donnees->tableau_avg_hours;
+    float (*tableau_avg_dispo_station)[nb_rows_hours] = \
+                (float (*)[nb_rows_hours])donnees->tableau_avg_dispo_station;
+    const char *dir_figures = donnees->dir_figures;
+
+    int w_lines = 3;                 /**< epaisseur des traits*/
+    int ms = 8;                      /**< marker size */
 
     // Creation de la figure ------------------------------------------------------------
     Figure fig3;
-    padY[0] = 120;
-    padY[1] = 160;
-   
-    wAxes = 'n';
-    Init_figure(&fig3, figsize, padX, padY, margin, wAxes);
-
-    /* Make ylabel  ----------  A mettre apres update fig */
-    decalx_Y = 20, decaly_Y = 0;    
-    ylabel = "Moyenne horaire des bornes disponibles";
-    Change_fontsize(&fig3, label_f, 14);    
-    Make_ylabel(&fig3, ylabel, decalx_Y, decaly_Y);
-
-    /* Make title */
-    title = "\u00c9volution de la moyenne horaire des bornes Belib disponibles";
-    decalx_title = -30, decaly_title = 15;
-    bbox_title = Make_title(&fig3, title, decalx_title, decaly_title);
-
-    /* Make subtitle */
-        // Construction du sous titre "du .... au ... "
-    Make_subtitle(&fig3, subtitle, bbox_title, decalx_subtitle, decaly_subtitle);
+    char wAxes = 'n';
+    Init_figure(&fig3, donnees->figsize, donnees->padX, donnees->padY,\
+                donnees->margin, wAxes);
+    Change_palette_png(&fig3, donnees->palette_png);
+    if (donnees->svg)
+        Change_backend_svg(&fig3);
 
     // Data
     // Vecteur X = tableau_avg_hours
@@ -390,8 +401,7 @@ int main(int argc, char* argv[])
     LineStyle flinestyles[nb_stations_fav];  /**< vecteur de linestyle pour chaque station*/
     fLineData flines[nb_stations_fav];
 
-    w_lines = 3;
-    ms = 8;
+    char style_trait;
     for (int st = 0; st < nb_stations_fav; st ++)
     {
         style_trait = '-';
@@ -408,39 +418,275 @@ int main(int argc, char* argv[])
 
     // Print_debug_fig(&fig3);
 
-    /* Make Xticks and grid line*/
-    Make_xticks_xgrid_time_avgH(&fig3, nb_rows_hours,tableau_avg_hours);
+    // Couche statique (fond, ylabel, titre, legende, annotations)
+    int decalx_Y = 20, decaly_Y = 0;    
+    char *ylabel = "Moyenne horaire des bornes disponibles";
+    Change_fontsize(&fig3, label_f, 14);    
+
+    char *title = "\u00c9volution de la moyenne horaire des bornes Belib disponibles";
+    int decalx_title = -30, decaly_title = 15;
+    int bbox_title[COUCHE_NB_META];
+
+    int decalx_leg = 0, decaly_leg = 0, ecart = 8;
+
+    char *github = donnees->github;
+    int decalx_github = 0, decaly_github = 0;
+
+    char *sign = donnees->sign;
+    int decalx_sign = fig3.img->sx- strlen(sign)*7, decaly_sign = 0;
+
+    char *textes_fig3[] = {ylabel, title, github, sign};
+    uint64_t cle_fig3 = Cle_couche_statique(&fig3, 4, textes_fig3);
+    char fichier_couche[strlen(donnees->bdd_filename)+10];
+    sprintf(fichier_couche, "%s.couche3", donnees->bdd_filename);
+
+    // Sous titre "du .... au ... " : période de l'agrégat horaire, pas la
+    // fenetre de fig1 (les moyennes portent sur tout l'historique)
+    char *subtitle = donnees->subtitle_avg;
+    int decalx_subtitle = 0, decaly_subtitle = 0;
+
+    // Empreinte des entrées : si la figure existante a la même, rien à redessiner
+    const char *filename_fig3= donnees->svg ? "fig3_avg_hour_dispo.svg" : "fig3_avg_hour_dispo.png";
+    char *textes_dyn_fig3[] = {subtitle};
+    uint64_t hash_fig3 = Hash_figure(&fig3, cle_fig3, 1, textes_dyn_fig3);
+
+    if (!Png_a_jour(dir_figures, filename_fig3, hash_fig3)) {
+        if (!Charger_couche_statique(&fig3, fichier_couche, cle_fig3, bbox_title)) {
+            /* Make ylabel  ----------  A mettre apres update fig */
+            Make_ylabel(&fig3, ylabel, decalx_Y, decaly_Y);
+
+            /* Make title */
+            memcpy(bbox_title, Make_title(&fig3, title, decalx_title, decaly_title),\
+                    sizeof(bbox_title));
+
+            /* Make legend */
+            Make_legend(&fig3, decalx_leg, decaly_leg, ecart);
+
+            /* Make github link */
+            Make_annotation(&fig3, github, decalx_github, decaly_github);
+
+            /* Make copyright */
+            Make_annotation(&fig3, sign, decalx_sign, decaly_sign);
+
+            Sauver_couche_statique(&fig3, fichier_couche, cle_fig3, bbox_title);
+        }
+
+        /* Make subtitle */
+            // Construction du sous titre "du .... au ... "
+        Make_subtitle(&fig3, subtitle, bbox_title, decalx_subtitle, decaly_subtitle);
+
+        /* Make Xticks and grid line*/
+        Make_xticks_xgrid_time_avgH(&fig3, nb_rows_hours,tableau_avg_hours);
+
+        /* Make Y ticks and grid line*/
+        char wTicks = 'y'; 
+        Make_fyticks_ygrid(&fig3, wTicks);
+
+        /* Plot lines */
+        for (int st = 0; st < nb_stations_fav; st++)
+            PlotFLine(&fig3, &(flines[st]));
+
+         /* Sauvegarde de la figure (png ou svg), empreinte si elle est écrite */
+        if (Save_figure(&fig3, dir_figures, filename_fig3) == 0)
+            Sauver_etag_figure(dir_figures, filename_fig3, hash_fig3);
+    }
+
+    // Destruction de la figure (image + arène)
+    Destroy_figure(&fig3);
+}
+
+/* =========================================================================== */
+int main(int argc, char* argv[]) 
+{
+    // ========================================================================
+    // Récupération des données de la db sqlite
+    // ========================================================================
+
+    // Recuperation du filepath de la db sqlite
+    char *bdd_filename = argv[1];
+
+    // Test de presence d'un argument
+    if (bdd_filename == NULL)
+    {
+        printf("Erreur : argument non spécifié. Le programme attend le nom d'un \
+                        fichier en entrée. \n");
+        exit(EXIT_FAILURE);
+    }
+    
+    // Options :
+    //   --full-rebuild : on ignore le fichier d'etat et on relit toute la table
+    //   --fenetre <jours> : seuls les derniers jours sont tracés (0 : tout)
+    //   --resolution <minutes> : pas minimal entre deux recoltes tracées
+    //   --serie : figures tracées l'une après l'autre (debug), sans threads
+    //   --truecolor : png en RGB 24 bits au lieu de png à palette
+    //   --svg : figures en svg (vectoriel) au lieu de png
+    int full_rebuild = 0;
+    int serie = 0;
+    char palette_png = 'y';
+    int svg = 0;
+    Fenetre fenetre = {0, 0, -1};
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--full-rebuild") == 0)
+            full_rebuild = 1;
+        else if (strcmp(argv[i], "--fenetre") == 0 && i+1 < argc)
+            fenetre.nb_jours = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--resolution") == 0 && i+1 < argc)
+            fenetre.resolution = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--serie") == 0)
+            serie = 1;
+        else if (strcmp(argv[i], "--truecolor") == 0)
+            palette_png = 'n';
+        else if (strcmp(argv[i], "--svg") == 0)
+            svg = 1;
+        else {
+            printf("Erreur : option %s inconnue. Options : --full-rebuild, \
+--fenetre <jours>, --resolution <minutes>, --serie, --truecolor, --svg.\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Fichier d'etat : series deja chargees et watermark (derniere recolte lue)
+    char fichier_etat[strlen(bdd_filename)+6];
+    sprintf(fichier_etat, "%s.etat", bdd_filename);
+
+    // Instanciation db sqlite
+    sqlite3 *db_belib;
+
+    // Connexion a la db sqlite
+    Sqlite_open_check(bdd_filename, &db_belib);
+    
+    // Choix de la table de travail
+    char* table = "Stations_fav";
+
+    // Recuperation des statuts par station fav
+    int nb_statuts = 4; /**< disponible occupe en_maintenance inconnu*/
+
+    // Chargement des series depuis le fichier d'etat puis lecture des seules
+    // recoltes posterieures au watermark. Sans etat valide : chargement de la
+    // fenetre en une seule requete (adresses, dates de recolte, statuts).
+    // Deux lancements qui se chevauchent (cron) passent l'un après l'autre :
+    // le verrou est tenu jusqu'à la sauvegarde. Sans verrou, l'etat est ignoré.
+    StationsData data_fav;
+    int fd_verrou = Lock_etat(fichier_etat);
+
+    if (full_rebuild || fd_verrou < 0 || \
+            Load_etat(db_belib, table, nb_statuts, &fenetre, fichier_etat, &data_fav) != 0)
+        Get_stations_data(db_belib, table, nb_statuts, &fenetre, &data_fav);
+    else
+        Update_stations_data(db_belib, table, &data_fav);
+
+    if (fd_verrou >= 0)
+        Save_etat(db_belib, &data_fav, table, fichier_etat);
+    Unlock_etat(fd_verrou);
+
+    int nb_stations_fav = data_fav.nb_stations;
+    int nb_rows_par_station = data_fav.nb_rows_par_station;
+    // printf(" > Nb rows : %d \n", nb_rows_par_station);
+
+    Date *tableau_date_recolte_fav = data_fav.tableau_date_recolte;
+    StatusCube *cube_statuts = &(data_fav.statuts);
 
-    /* Make Y ticks and grid line*/
-    wTicks = 'y'; 
-    Make_fyticks_ygrid(&fig3, wTicks);
+    // Labels fig : adresses sans "Paris" (table Station)
+    char **adresse_label = data_fav.tableau_labels;
 
-    /* Plot lines */
-    for (int st = 0; st < nb_stations_fav; st++)
-        PlotFLine(&fig3, &(flines[st]));
+    // Verif que ca colle avec la db
+    /*Print_tableau_stations(cube_statuts, tableau_date_recolte_fav, data_fav.tableau_adresses);*/
+    
+    // Mean avg per hour
+    int nb_rows_hours = Get_nb_avg_hours(db_belib);
+    // printf("Nb d'heures pour calc moyenne : %d\n", nb_rows_hours);
 
-    /* Make legend */
-    decalx_leg = 0, decaly_leg = 0, ecart = 8;
-    Make_legend(&fig3, decalx_leg, decaly_leg, ecart);
+    // Recuperation vecteur des heures
+    int tableau_avg_hours[nb_rows_hours];
+    Get_avg_hours(db_belib, nb_rows_hours, tableau_avg_hours);
 
-    /* Make github link */
-    decalx_github = 0, decaly_github = 0;
-    Make_annotation(&fig3, github, decalx_github, decaly_github);
+    // for (int i=0; i < nb_rows_hours; i++)
+    //     printf("avg hour %d : %d\n",i,tableau_avg_hours[i]);
+
+    // Période couverte par l'agrégat horaire : tout Stations_fav, quelle que
+    // soit la fenetre (--fenetre)
+    Date date_debut_avg, date_fin_avg;
+    Init_Date_epoch(&date_debut_avg, Get_epoch_min(db_belib, table, -1));
+    Init_Date_epoch(&date_fin_avg, Get_epoch_max(db_belib, table));
+
+    // Recuperation moyenne horaire dispo stations
+    float tableau_avg_dispo_station[nb_stations_fav][nb_rows_hours];
+    Get_avg_dispo_station(db_belib, \
+                        data_fav.tableau_ids, \
+                        nb_stations_fav, nb_rows_hours, \
+                        tableau_avg_hours, tableau_avg_dispo_station);
+
+    // for (int station=0; station < nb_stations_fav; station++)
+    //     for (int h=0; h < nb_rows_hours; h++)
+    //         printf("Avg dispo Station %d à %02d:00 : %.1f \n",station, h, tableau_avg_dispo_station[station][h]);
+
+    // for (int h=0; h < nb_rows_hours; h++)
+    //     printf("Avg dispo Station %d à %02d:00 : %.1f \n",6, h, tableau_avg_dispo_station[5][h]);
+
+    // Fermeture db
+    Sqlite_close(db_belib);
+
+    // ========================================================================
+    // Parametres generaux des figures
+    // ========================================================================
+
+    // Sous titre "du .... au ... " (fig1 : fenetre, fig3 : agrégat horaire)
+    char subtitle[25] = "";  
+    Const_str_dudate1_audate2(&tableau_date_recolte_fav[0],\
+                        &tableau_date_recolte_fav[nb_rows_par_station-1], subtitle);
+    char subtitle_avg[25] = "";
+    Const_str_dudate1_audate2(&date_debut_avg, &date_fin_avg, subtitle_avg);
+
+    DonneesFigures donnees = {
+        .nb_stations = nb_stations_fav,
+        .nb_rows = nb_rows_par_station,
+        .nb_statuts = nb_statuts,
+        .tableau_date_recolte = tableau_date_recolte_fav,
+        .cube_statuts = cube_statuts,
+        .adresse_label = adresse_label,
+        .nb_rows_hours = nb_rows_hours,
+        .tableau_avg_hours = tableau_avg_hours,
+        .tableau_avg_dispo_station = &(tableau_avg_dispo_station[0][0]),
+        .subtitle = subtitle,
+        .subtitle_avg = subtitle_avg,
+        .bdd_filename = bdd_filename,
+    #if defined QEMU
+        .dir_figures = "/var/www/html/figures/", /**< Path folder save fig*/
+    #else
+        .dir_figures = "./figures/", /**< Path folder save fig*/
+    #endif
+        .figsize = {800, 700},     /**< Dimension figure */
+        .padX = {90,0},            /**< pad zone de dessin gauche et droite*/
+        .padY = {120,160},         /**< pad zone de dessin haut et bas*/
+        .margin = {10,10},         /**< margin gauche droite zone de dessin*/
+        .github = "https://github.com/bauj/AJC_projet_belib",
+        .sign = "\u00a9 2023 by Juba Hamma",
+        .palette_png = palette_png,
+        .svg = svg,
+    };
+
+    // Cache des polices partagé par les 3 figures (avant les threads)
+    Init_cache_polices();
+
+    // ========================================================================
+    // Creation des figures : une tache par figure, exécutées en parallèle
+    // sur un pool de threads (ou l'une après l'autre avec --serie)
+    // ========================================================================
 
-    /* Make copyright */
-    Make_annotation(&fig3, sign, decalx_sign, decaly_sign);
+    PoolTaches pool;
+    Init_pool_taches(&pool, serie ? 0 : Nb_threads_pool(3));
 
-     /* Sauvegarde du fichier png */
-    const char *filename_fig3= "fig3_avg_hour_dispo.png";
-    Save_to_png(&fig3, dir_figures, filename_fig3);
+    Ajout_tache(&pool, Tache_fig1, &donnees);
+    Ajout_tache(&pool, Tache_fig2, &donnees);
+    Ajout_tache(&pool, Tache_fig3, &donnees);
 
-    // Destroying img 
-    gdImageDestroy(fig3.img);
+    Free_pool_taches(&pool);
 
 
     // Clean alloc
-    free_tab_char1(tableau_adresses_fav, nb_stations_fav);
-    free_tab_char1(adresse_label, nb_stations_fav);
+    Free_stations_data(&data_fav);
+    Free_cache_polices();
 
     return 0;
-}
\ No newline at end of file
+}
@@ -10,6 +10,10 @@ ddj=`date "+%d/%m/%Y %H:%M"`
 export PATH_BELIB_DB='/var/db_belib/belib_data.db'
 export PATH_BELIB_BIN='/usr/bin/plot_belib'
 
+# Mise a jour du schema de la bdd si necessaire :
+echo "> Migration de la db ..."
+${PATH_BELIB_BIN}/migrate_db_belib.sh ${PATH_BELIB_DB}
+
 # Recuperation des donnees stations favoris open data paris :
 echo "> Date update : ${ddj}"
 echo "> Recuperation des data et stockage dans db ..."
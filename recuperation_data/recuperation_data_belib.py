@@ -12,15 +12,20 @@
 #
 # + Table Bornes : Contient l'ensemble des données des bornes, mise à jour 
 # quotidiennement. En tête :
-# | ID | last_updated | id_pdc | statut_pdc | adresse_station | lon | lat |
+# | ID | last_updated | id_pdc | statut_pdc | station_id |
 #
 # + Table Stations_fav : Contient les données des stations en 
 # favoris, mise à jour 3x par jour. En tête :
-# | ID | date_recolte | adresse_station | lon | lat | disponible | occupe | ...
+# | ID | date_recolte | station_id | disponible | occupe | ...
 # 
 # + Table Stations_live : Contient les données des stations les plus proches de 
 # la position entrée par un utilisateur. En tête :
-#  | ID | date_recolte | adresse_station | lon | lat | disponible | occupe | ...
+#  | ID | date_recolte | station_id | disponible | occupe | ...
+#
+# + Table Station : Table de dimension des stations, complétée à la volée lors 
+# de l'ajout de nouvelles données (label et arrondissement calculés par la bdd).
+# En tête :
+# | ID | adresse_station | label | lon | lat | arrondissement |
 #
 # Author : Juba Hamma. 2023.
 # ===========================================================================
@@ -107,38 +112,26 @@ def iterator_data_bornes(n, raw_data_all_bornes):
             raw_data_all_bornes[i]["last_updated"],\
             raw_data_all_bornes[i]["id_pdc"], \
             raw_data_all_bornes[i]["statut_pdc"], \
-            raw_data_all_bornes[i]["adresse_station"],\
-            raw_data_all_bornes[i]['coordonneesxy']['lon'],\
-            raw_data_all_bornes[i]['coordonneesxy']['lat']
-
+            raw_data_all_bornes[i]["adresse_station"]
 
 # -----------------------------------------------------------------------------
-def iterator_data_stations(n, list_stations_pref):
-    """Iterateur permettant de renvoyer le contenu de list_stations_pref pour l'ensemble
-    des bornes 
+def iterator_stations_bornes(n, raw_data_all_bornes):
+    """Iterateur renvoyant l'adresse et la position de la station de chaque borne, 
+    pour compléter la table Station
 
     Args:
-        n (int): Nombre de stations
-        list_stations_pref (list): Liste de Dictionnaires contenant les données relatives aux stations (fav ou live)
+        n (int): Nombre de bornes
+        raw_data_all_bornes (list): Liste de Dictionnaires contenant les données brutes récupérées pour l'ensemble des bornes
 
     Yields:
-        value : Valeur contenue dans la colonne du dictionnaire spécifiée, renvoyée à la volée (générateur)
+        value : Adresse, longitude et latitude de la station de la borne (générateur)
     """
     for i in range(n):
         yield \
-            list_stations_pref[i]["date_recolte"],\
-            list_stations_pref[i]["adresse_station"], \
-            list_stations_pref[i]["lat"], \
-            list_stations_pref[i]["lon"], \
-            list_stations_pref[i]["disponible"], \
-            list_stations_pref[i]["occupe"],\
-            list_stations_pref[i]['inconnu'],\
-            list_stations_pref[i]['en_maintenance'],\
-            list_stations_pref[i]['supprime'],\
-            list_stations_pref[i]['reserve'],\
-            list_stations_pref[i]['en_cours_mes'],\
-            list_stations_pref[i]['mes_planifiee'],\
-            list_stations_pref[i]['non_implemente']
+            raw_data_all_bornes[i]["adresse_station"],\
+            raw_data_all_bornes[i]['coordonneesxy']['lon'],\
+            raw_data_all_bornes[i]['coordonneesxy']['lat']
+
 
 # -----------------------------------------------------------------------------              
 def create_connection(path_db):
@@ -159,6 +152,20 @@ def create_connection(path_db):
 
     return conn
 
+# -----------------------------------------------------------------------------
+def upsert_stations(cur, iter_stations):
+    """Ajoute à la table Station les stations qui n'y sont pas encore. Le label
+    et l'arrondissement sont calculés par trigger dans la bdd. Le test d'existence
+    évite de consommer un ID (AUTOINCREMENT) pour chaque station déjà connue.
+
+    Args:
+        cur (sqlite3.Cursor): Curseur sur la bdd SQLite3
+        iter_stations (iterable): Tuples (adresse_station, lon, lat)
+    """
+    cur.executemany("INSERT INTO Station (adresse_station, lon, lat) "+\
+                        "SELECT ?1, ?2, ?3 WHERE NOT EXISTS "+\
+                        "(SELECT 1 FROM Station WHERE adresse_station = ?1);", iter_stations)
+
 # -----------------------------------------------------------------------------
 def update_all_bornes(path_db):
     """Mise à jour de la table Bornes de la bdd SQLite3
@@ -179,14 +186,17 @@ def update_all_bornes(path_db):
     raw_data_all_bornes = ujson.loads(resp.data) 
     nb_bornes = len(raw_data_all_bornes) 
     
-    wanted_keys = ["last_updated", "id_pdc", "statut_pdc", "adresse_station", "lon", "lat"]
+    wanted_keys = ["last_updated", "id_pdc", "statut_pdc", "station_id"]
     
     conn = create_connection(path_db)
 
     cur = conn.cursor()
+    upsert_stations(cur, iterator_stations_bornes(nb_bornes, raw_data_all_bornes))
+
     table = "Bornes"
     insert_query = f"INSERT INTO {table} ("+", ".join(wanted_keys)+") VALUES ("+\
-                                ", ".join(len(wanted_keys)*['?']) + ");"
+                                ", ".join((len(wanted_keys)-1)*['?']) + \
+                                ", (SELECT ID FROM Station WHERE adresse_station = ?));"
     
     cur.executemany(insert_query, iterator_data_bornes(nb_bornes, raw_data_all_bornes))
     
@@ -340,7 +350,7 @@ def transform_dict_station(list_records):
 
 
 # -----------------------------------------------------------------------------
-def update_bornes_around_pos(path_db, table, pos_lat, pos_lon, dist):
+def update_bornes_around_pos(path_db, table, pos_lat, pos_lon, dist, vider_table=False):
     """Update de la table de la db SQLite3 avec les données des stations autour d'une position GPS
 
     Args:
@@ -349,6 +359,9 @@ def update_bornes_around_pos(path_db, table, pos_lat, pos_lon, dist):
         pos_lat (float): Latitude de la position de recherche
         pos_lon (float): Longitude de la position de recherche
         dist (float): Rayon de recherche en km
+        vider_table (bool): Vide la table avant de la compléter, dans la meme
+            transaction : un lecteur (serveur live) ne voit jamais la table
+            vide ou à moitié remplie
     """
 
     http = urllib3.PoolManager()
@@ -383,15 +396,24 @@ def update_bornes_around_pos(path_db, table, pos_lat, pos_lon, dist):
     # for i in range(nb_stations):
     #     print(ujson.dumps(list_stations[i],indent=3))
 
-    wanted_keys = list(list_stations[0].keys())
+    # Adresse et position stockées une seule fois dans la table Station
+    wanted_keys = [key for key in list_stations[0].keys() \
+                        if key not in ("adresse_station", "lon", "lat")]
     
     conn = create_connection(path_db)
 
     cur = conn.cursor()
-    insert_query = f"INSERT INTO {table} ("+", ".join(wanted_keys)+") VALUES ("+\
-                                ", ".join(len(wanted_keys)*['?']) + ");"
+    if vider_table:
+        cur.execute(f"DELETE FROM {table}")
+
+    upsert_stations(cur, ((station["adresse_station"], station["lon"], station["lat"])\
+                            for station in list_stations))
+
+    insert_query = f"INSERT INTO {table} (station_id, "+", ".join(wanted_keys)+") "+\
+            "VALUES ((SELECT ID FROM Station WHERE adresse_station = :adresse_station), "+\
+                                ", ".join(":"+key for key in wanted_keys) + ");"
     
-    cur.executemany(insert_query, iterator_data_stations(nb_stations, list_stations))
+    cur.executemany(insert_query, list_stations)
     
     conn.commit()
 
@@ -562,23 +584,6 @@ def adresse_to_lon_lat(adr):
 
     return lon, lat
 
-# -----------------------------------------------------------------------------
-def clean_table(path_db, table):
-    """Fonction permettant de vider une table d'une db SQLite3
-
-    Args:
-        path_db (string): Chemin vers la bdd SQLite3
-        table (string): Nom de la table à traiter
-    """
-    conn = create_connection(path_db)
-
-    sql_req = f"DELETE FROM {table}"
-
-    with conn :
-        cur = conn.cursor()
-        cur.execute(sql_req)
-        conn.commit()
-
 # -----------------------------------------------------------------------------
 def update_bornes_around_adresse_live(path_db, adr, dist):
     """Mise a jour de la table "Stations_live" de la db SQLite3. On la vide avant de la compléter.
@@ -592,8 +597,7 @@ def update_bornes_around_adresse_live(path_db, adr, dist):
 
     table="Stations_live"
 
-    clean_table(path_db, table)
-    update_bornes_around_pos(path_db, table, lat_adr, lon_adr, dist)
+    update_bornes_around_pos(path_db, table, lat_adr, lon_adr, dist, vider_table=True)
     
     return
 
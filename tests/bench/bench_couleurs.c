@@ -0,0 +1,179 @@
+/* ----------------------------------------------------------------------------
+*  Microbenchmark de la résolution des couleurs des figures : une couleur
+*  allouée à chaque appel de tracé (GetCouleur, gdImageColorAllocate) face à
+*  la table des couleurs résolue une fois (Couleur_tc, Figure.couleurs).
+*
+*  Trois mesures sur une image truecolor de la taille des figures :
+*      - la résolution seule, pour chaque couleur d'un tracé,
+*      - des segments courts (courbes de fig1/fig3) avec chaque méthode,
+*      - des barres pleines (fig2) avec chaque méthode.
+*
+*  Compilation (depuis la racine du dépôt) :
+*      gcc -std=gnu11 -O2 -Iplotting_data/src tests/bench/bench_couleurs.c \
+*          -o bench_couleurs -lgd -lsqlite3 -lz -lpthread -lm
+*  Utilisation :
+*      ./bench_couleurs [nb_appels]
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <gd.h>
+#include "libs/plotter.h"
+
+/**
+ * @brief Nombre d'appels de tracé par défaut de chaque mesure
+ *
+ */
+#define NB_APPELS_DEFAUT 200000
+
+/**
+ * @brief Taille de l'image (celle des figures)
+ *
+ */
+#define LARGEUR_IMG 800
+#define HAUTEUR_IMG 700
+
+/**
+ * @brief Méthodes de résolution des couleurs mesurées
+ *
+ */
+enum Methode_e {ALLOCATION, TABLE};
+
+static const char *noms_methodes[] = {"GetCouleur", "table"};
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Horloge monotone en ms
+ *
+ * @return double Temps en ms
+ */
+double Maintenant_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Résout nb_appels couleurs des lignes de tracé, sans dessiner
+ *
+ * @param img Image truecolor
+ * @param methode Méthode de résolution
+ * @param nb_appels Nombre de résolutions
+ * @return double Temps en ms
+ */
+double Mesure_resolution(gdImagePtr img, enum Methode_e methode, long nb_appels)
+{
+    int table[NB_COULEURS_LIGNES];
+    for (int c = 0; c < NB_COULEURS_LIGNES; c++)
+        table[c] = Couleur_tc(color_lines[c]);
+
+    // Somme gardée pour que le compilateur ne supprime pas la boucle
+    volatile int somme = 0;
+    double debut = Maintenant_ms();
+    for (long i = 0; i < nb_appels; i++) {
+        int c = i % NB_COULEURS_LIGNES;
+        somme += methode == ALLOCATION ? GetCouleur(img, color_lines[c]) : table[c];
+    }
+    return Maintenant_ms() - debut;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Trace nb_appels segments courts, la couleur étant résolue à chaque
+ * segment selon la méthode
+ *
+ * @param img Image truecolor
+ * @param methode Méthode de résolution
+ * @param nb_appels Nombre de segments
+ * @return double Temps en ms
+ */
+double Mesure_segments(gdImagePtr img, enum Methode_e methode, long nb_appels)
+{
+    int table[NB_COULEURS_LIGNES];
+    for (int c = 0; c < NB_COULEURS_LIGNES; c++)
+        table[c] = Couleur_tc(color_lines[c]);
+
+    double debut = Maintenant_ms();
+    for (long i = 0; i < nb_appels; i++) {
+        int c = i % NB_COULEURS_LIGNES;
+        int x = (int)(i % (LARGEUR_IMG - 4));
+        int y = (int)((i * 7) % (HAUTEUR_IMG - 4));
+        int couleur = methode == ALLOCATION ? GetCouleur(img, color_lines[c]) : table[c];
+        gdImageLine(img, x, y, x + 3, y + 2, couleur);
+    }
+    return Maintenant_ms() - debut;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Trace nb_appels barres pleines de 4x40 pixels, la couleur étant
+ * résolue à chaque barre selon la méthode
+ *
+ * @param img Image truecolor
+ * @param methode Méthode de résolution
+ * @param nb_appels Nombre de barres
+ * @return double Temps en ms
+ */
+double Mesure_barres(gdImagePtr img, enum Methode_e methode, long nb_appels)
+{
+    int table[NB_COULEURS_LIGNES];
+    for (int c = 0; c < NB_COULEURS_LIGNES; c++)
+        table[c] = Couleur_tc(color_lines[c]);
+
+    double debut = Maintenant_ms();
+    for (long i = 0; i < nb_appels; i++) {
+        int c = i % NB_COULEURS_LIGNES;
+        int x = (int)(i % (LARGEUR_IMG - 5));
+        int y = (int)((i * 7) % (HAUTEUR_IMG - 41));
+        int couleur = methode == ALLOCATION ? GetCouleur(img, color_lines[c]) : table[c];
+        gdImageFilledRectangle(img, x, y, x + 4, y + 40, couleur);
+    }
+    return Maintenant_ms() - debut;
+}
+
+
+/* =========================================================================== */
+int main(int argc, char *argv[])
+{
+    long nb_appels = argc > 1 ? atol(argv[1]) : NB_APPELS_DEFAUT;
+
+    if (nb_appels < 1) {
+        printf("Erreur : usage : %s [nb_appels]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    gdImagePtr img = gdImageCreateTrueColor(LARGEUR_IMG, HAUTEUR_IMG);
+    if (img == NULL) {
+        printf("Erreur : echec de creation de l'image.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    double (*mesures[])(gdImagePtr, enum Methode_e, long) = {
+        Mesure_resolution, Mesure_segments, Mesure_barres
+    };
+    const char *noms_mesures[] = {"resolution seule", "segments", "barres"};
+
+    printf("%ld appels par mesure, image %dx%d\n", nb_appels, LARGEUR_IMG, HAUTEUR_IMG);
+    printf("  mesure            methode      temps (ms)  ns/appel\n");
+    for (int m = 0; m < 3; m++)
+        for (int meth = ALLOCATION; meth <= TABLE; meth++) {
+            // Meilleur de 5 passes
+            double t_min = 1e30;
+            for (int passe = 0; passe < 5; passe++) {
+                double t = mesures[m](img, meth, nb_appels);
+                if (t < t_min) t_min = t;
+            }
+            printf("  %-16s  %-10s  %10.2f  %8.1f\n", noms_mesures[m],\
+                        noms_methodes[meth], t_min, t_min * 1e6 / nb_appels);
+        }
+
+    gdImageDestroy(img);
+    return 0;
+}
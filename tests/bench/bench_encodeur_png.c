@@ -0,0 +1,225 @@
+/* ----------------------------------------------------------------------------
+*  Benchmark de l'encodeur PNG par blocs (encodeur_png.h) face à
+*  gdImagePngEx, sur des figures PNG existantes relues en truecolor.
+*
+*  Pour chaque niveau zlib (1, 5, 9) : temps et taille de gdImagePngEx, puis
+*  de Ecrire_png_blocs avec 1, 2 et 4 blocs. Pour chaque nombre de blocs, le
+*  "chemin critique" est le temps du bloc le plus long, les blocs étant
+*  encodés un par un dans le thread principal : c'est le temps d'encodage
+*  attendu avec un coeur par bloc (hors assemblage, quelques dizaines de µs),
+*  mesurable aussi sur une machine à un seul coeur.
+*
+*  Compilation (depuis la racine du dépôt) :
+*      gcc -std=gnu11 -O2 -Iplotting_data/src tests/bench/bench_encodeur_png.c \
+*          -o bench_encodeur_png -lgd -lz -lpthread
+*  Utilisation :
+*      ./bench_encodeur_png [-n iterations] figure.png [figure.png ...]
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <gd.h>
+#include "libs/encodeur_png.h"
+
+/**
+ * @brief Nombre d'itérations par défaut de chaque mesure
+ *
+ */
+#define NB_ITERATIONS_DEFAUT 20
+
+/**
+ * @brief Niveaux zlib et nombres de blocs mesurés
+ *
+ */
+static const int niveaux[] = {1, 5, 9};
+static const int nb_blocs_mesures[] = {1, 2, 4};
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Horloge monotone en ms
+ *
+ * @return double Temps en ms
+ */
+double Maintenant_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Encode l'image avec gdImagePngEx dans un tampon mémoire
+ *
+ * @param img Image truecolor
+ * @param niveau Niveau zlib
+ * @param taille Taille du png (sortie)
+ * @return double Temps d'encodage en ms
+ */
+double Mesure_gd(gdImagePtr img, int niveau, size_t *taille)
+{
+    char *octets = NULL;
+    FILE *f = open_memstream(&octets, taille);
+
+    double debut = Maintenant_ms();
+    gdImagePngEx(img, f, niveau);
+    fclose(f);
+    double duree = Maintenant_ms() - debut;
+
+    free(octets);
+    return duree;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Encode l'image avec Ecrire_png_blocs dans un tampon mémoire
+ *
+ * @param img Image truecolor
+ * @param niveau Niveau zlib
+ * @param nb_blocs Nombre de blocs
+ * @param taille Taille du png (sortie)
+ * @return double Temps d'encodage en ms
+ */
+double Mesure_blocs(gdImagePtr img, int niveau, int nb_blocs, size_t *taille)
+{
+    char *octets = NULL;
+    FILE *f = open_memstream(&octets, taille);
+
+    double debut = Maintenant_ms();
+    if (Ecrire_png_blocs(img, f, niveau, Z_DEFAULT_STRATEGY, nb_blocs) != 0)
+        printf("Info : echec de l'encodage par blocs.\n");
+    fclose(f);
+    double duree = Maintenant_ms() - debut;
+
+    free(octets);
+    return duree;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Encode les blocs de l'image un par un (découpage de
+ * Encoder_png_blocs) et renvoie le temps du plus long
+ *
+ * @param img Image truecolor
+ * @param niveau Niveau zlib
+ * @param nb_blocs Nombre de blocs
+ * @return double Temps du bloc le plus long en ms
+ */
+double Mesure_chemin_critique(gdImagePtr img, int niveau, int nb_blocs)
+{
+    double max_bloc = 0.;
+
+    for (int b = 0; b < nb_blocs; b++) {
+        BlocPng bloc;
+        memset(&bloc, 0, sizeof(bloc));
+        bloc.img = img;
+        bloc.ligne_debut = (int)((long)img->sy * b / nb_blocs);
+        bloc.ligne_fin = (int)((long)img->sy * (b+1) / nb_blocs);
+        bloc.niveau = niveau;
+        bloc.strategie = Z_DEFAULT_STRATEGY;
+        bloc.dernier = (b == nb_blocs - 1);
+
+        double debut = Maintenant_ms();
+        Tache_bloc_png(&bloc);
+        double duree = Maintenant_ms() - debut;
+
+        if (duree > max_bloc) max_bloc = duree;
+        free(bloc.sortie);
+    }
+
+    return max_bloc;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Mesure les deux encodeurs sur une image et affiche le tableau
+ *
+ * @param nom Nom de la figure
+ * @param img Image truecolor
+ * @param nb_iterations Nombre d'itérations (temps minimum gardé)
+ */
+void Bench_image(const char *nom, gdImagePtr img, int nb_iterations)
+{
+    printf("\n%s (%dx%d)\n", nom, img->sx, img->sy);
+    printf("  niveau  encodeur          temps (ms)  critique (ms)  taille (o)\n");
+
+    for (size_t n = 0; n < sizeof(niveaux)/sizeof(niveaux[0]); n++) {
+        int niveau = niveaux[n];
+        size_t taille = 0;
+
+        double t_gd = 1e30;
+        for (int it = 0; it < nb_iterations; it++) {
+            double t = Mesure_gd(img, niveau, &taille);
+            if (t < t_gd) t_gd = t;
+        }
+        printf("  %6d  gdImagePngEx      %10.2f  %13s  %10zu\n", niveau, t_gd, "-", taille);
+
+        for (size_t b = 0; b < sizeof(nb_blocs_mesures)/sizeof(nb_blocs_mesures[0]); b++) {
+            int nb_blocs = nb_blocs_mesures[b];
+            double t_blocs = 1e30, t_critique = 1e30;
+
+            for (int it = 0; it < nb_iterations; it++) {
+                double t = Mesure_blocs(img, niveau, nb_blocs, &taille);
+                if (t < t_blocs) t_blocs = t;
+                t = Mesure_chemin_critique(img, niveau, nb_blocs);
+                if (t < t_critique) t_critique = t;
+            }
+            printf("  %6d  blocs x%d          %10.2f  %13.2f  %10zu\n",\
+                        niveau, nb_blocs, t_blocs, t_critique, taille);
+        }
+    }
+}
+
+
+/* =========================================================================== */
+int main(int argc, char *argv[])
+{
+    int nb_iterations = NB_ITERATIONS_DEFAUT;
+    int premier = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        nb_iterations = atoi(argv[2]);
+        premier = 3;
+    }
+
+    if (premier >= argc || nb_iterations < 1) {
+        printf("Erreur : usage : %s [-n iterations] figure.png [figure.png ...]\n",\
+                    argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Coeurs en ligne : %ld, %d iterations par mesure (minimum garde)\n",\
+                sysconf(_SC_NPROCESSORS_ONLN), nb_iterations);
+
+    for (int i = premier; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (f == NULL) {
+            printf("Erreur : impossible d'ouvrir %s.\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+        gdImagePtr img = gdImageCreateFromPng(f);
+        fclose(f);
+
+        if (img == NULL) {
+            printf("Erreur : %s n'est pas un png lisible.\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        // Les figures sont tracées en truecolor : un png à palette est
+        // reconverti avant la mesure
+        if (!gdImageTrueColor(img))
+            gdImagePaletteToTrueColor(img);
+
+        Bench_image(argv[i], img, nb_iterations);
+        gdImageDestroy(img);
+    }
+
+    return 0;
+}
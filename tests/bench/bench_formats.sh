@@ -0,0 +1,62 @@
+#!/bin/sh
+
+# ===========================================================================
+# Benchmark des formats de sortie des figures favoris : png truecolor
+# (--truecolor), png a palette (defaut) et svg (--svg).
+# Pour chaque format : meilleur temps de generation sur N executions, taille
+# totale des figures et taille apres gzip -9 (transfert http compresse).
+# Avant chaque execution, les figures, leurs etags et les couches statiques
+# sont effaces : toutes les figures sont retracees et reecrites. Le fichier
+# d'etat est garde (chargement incremental, comme en production).
+#
+# Usage (depuis le dossier d'execution de l'exe, figures dans ./figures/) :
+#   bench_formats.sh <stations_fav.exe> <belib_data.db> [dossier_figures] [N]
+# Author : Juba Hamma, 2023.
+#
+# ===========================================================================
+
+if [ $# -lt 2 ]; then
+    echo "Erreur : usage : $0 <stations_fav.exe> <belib_data.db> [dossier_figures] [N]"
+    exit 1
+fi
+
+exe=$1
+db=$2
+dir_figures=${3:-./figures}
+nb_runs=${4:-10}
+
+# Temps en microsecondes (date GNU)
+maintenant_us() {
+    echo $(( $(date +%s%N) / 1000 ))
+}
+
+bench_format() {
+    nom=$1
+    shift
+    best=0
+    i=0
+    while [ $i -lt $nb_runs ]; do
+        rm -f "${dir_figures}"/*.png "${dir_figures}"/*.svg "${dir_figures}"/*.etag "${db}".couche*
+        debut=$(maintenant_us)
+        "$exe" "$db" "$@" > /dev/null || { echo "Erreur : echec de $exe $*"; exit 1; }
+        t=$(( $(maintenant_us) - debut ))
+        if [ $best -eq 0 ] || [ $t -lt $best ]; then best=$t; fi
+        i=$((i+1))
+    done
+
+    taille=0
+    taille_gz=0
+    for f in "${dir_figures}"/*.png "${dir_figures}"/*.svg; do
+        [ -f "$f" ] || continue
+        taille=$((taille + $(wc -c < "$f")))
+        taille_gz=$((taille_gz + $(gzip -9 -c "$f" | wc -c)))
+    done
+
+    printf "%-16s %10d %12d %12d\n" "$nom" $((best / 1000)) $taille $taille_gz
+}
+
+echo "> ${nb_runs} executions par format, meilleur temps garde"
+printf "%-16s %10s %12s %12s\n" "format" "temps (ms)" "taille (o)" "gzip -9 (o)"
+bench_format "png truecolor" --truecolor
+bench_format "png palette"
+bench_format "svg" --svg
@@ -0,0 +1,211 @@
+/* ----------------------------------------------------------------------------
+*  Benchmark du sous-échantillonnage LTTB des courbes (Change_sous_echantillonnage)
+*  sur des séries synthétiques de 10^3 à 10^6 points.
+*
+*  Pour chaque taille : figure de la taille de fig1 (800x700), NB_SERIES
+*  courbes ajoutées comme dans Tache_fig1 (X : temps régulier, Y : bornes
+*  disponibles, même profil journalier à toutes les tailles, échantillonné
+*  plus finement, avec un bruit de +-1 borne), puis temps de
+*  Transform_series_figure et de PlotLine, sans sous-échantillonnage et avec
+*  2 points par pixel (réglage de fig1). Sans LTTB le tracé croît avec le
+*  nombre de points ; avec, il reste plat (au plus 2 x largeur de la zone de
+*  dessin par courbe), seule la transformation reste linéaire.
+*
+*  Compilation (depuis la racine du dépôt) :
+*      gcc -std=gnu11 -O2 -Iplotting_data/src tests/bench/bench_lttb.c \
+*          -o bench_lttb -lgd -lsqlite3 -lz -lpthread -lm
+*  Utilisation :
+*      ./bench_lttb [-n iterations] [nb_points_max]
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <gd.h>
+#include "libs/plotter.h"
+
+/**
+ * @brief Nombre d'itérations par défaut de chaque mesure
+ *
+ */
+#define NB_ITERATIONS_DEFAUT 5
+
+/**
+ * @brief Taille maximale des séries par défaut (10^3 à 10^6)
+ *
+ */
+#define NB_POINTS_MAX_DEFAUT 1000000
+
+/**
+ * @brief Nombre de courbes de la figure (stations favorites)
+ *
+ */
+#define NB_SERIES 4
+
+/**
+ * @brief Nombre de cycles journaliers des séries synthétiques
+ *
+ */
+#define NB_JOURS 14
+
+/**
+ * @brief Points par pixel mesurés (0 : sans sous-échantillonnage, 2 : fig1)
+ *
+ */
+static const int pts_par_pixel_mesures[] = {0, 2};
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Horloge monotone en ms
+ *
+ * @return double Temps en ms
+ */
+double Maintenant_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Remplit une série synthétique de bornes disponibles (0 à 20) : 
+ * NB_JOURS cycles journaliers quel que soit le nombre de points, plus un 
+ * bruit de +-1 borne (graine fixe, séries reproductibles). La figure est la
+ * même à toutes les tailles, seule la densité des points change.
+ *
+ * @param nb_points Nombre de points
+ * @param y Vecteur des Y (sortie)
+ * @param graine Graine du générateur
+ */
+void Serie_synthetique(long nb_points, uint16_t y[], unsigned int graine)
+{
+    srand(graine);
+    for (long i = 0; i < nb_points; i++) {
+        double jour = sin(2. * M_PI * NB_JOURS * i / nb_points + graine);
+        int val = (int)(10. + 8. * jour) + rand() % 3 - 1;
+        y[i] = (uint16_t)Max_int(0, Min_int(val, 20));
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Mesure la transformation et le tracé des courbes d'une figure pour
+ * un réglage de sous-échantillonnage
+ *
+ * @param nb_points Nombre de points par série
+ * @param x Vecteur des X (commun aux séries)
+ * @param y Vecteurs des Y, un par série
+ * @param pts_par_pixel Points par pixel (0 : sans sous-échantillonnage)
+ * @param nb_iterations Nombre d'itérations (temps minimum gardé)
+ * @param t_transfo Temps de Transform_series_figure en ms (sortie)
+ * @param t_trace Temps des PlotLine en ms (sortie)
+ * @return size_t Nombre de points tracés par courbe
+ */
+size_t Mesure_courbes(long nb_points, int x[], uint16_t *y[], int pts_par_pixel,\
+                        int nb_iterations, double *t_transfo, double *t_trace)
+{
+    int figsize[2] = {800, 700};
+    int padX[2] = {90, 0};
+    int padY[2] = {120, 160};
+    int margin[2] = {10, 10};
+
+    Figure fig;
+    Init_figure(&fig, figsize, padX, padY, margin, 'n');
+    Change_sous_echantillonnage(&fig, pts_par_pixel);
+
+    LineData lines[NB_SERIES];
+    LineStyle linestyles[NB_SERIES];
+    for (int s = 0; s < NB_SERIES; s++) {
+        Init_linestyle(&(linestyles[s]), '-', color_lines[s], 4, 'o', 6);
+        Init_linedata(&(lines[s]), (int)nb_points, x, y[s], "serie", &(linestyles[s]));
+        Add_line_to_fig(&fig, &(lines[s]));
+    }
+
+    *t_transfo = *t_trace = 1e30;
+    for (int it = 0; it < nb_iterations; it++) {
+        // Remet les coordonnées pixels à recalculer (même réglage)
+        Change_sous_echantillonnage(&fig, pts_par_pixel);
+
+        double debut = Maintenant_ms();
+        Transform_series_figure(&fig);
+        double t = Maintenant_ms() - debut;
+        if (t < *t_transfo) *t_transfo = t;
+
+        debut = Maintenant_ms();
+        for (int s = 0; s < NB_SERIES; s++)
+            PlotLine(&fig, &(lines[s]));
+        t = Maintenant_ms() - debut;
+        if (t < *t_trace) *t_trace = t;
+    }
+
+    size_t len_dessin = lines[0].len_dessin;
+    Destroy_figure(&fig);
+    return len_dessin;
+}
+
+
+/* =========================================================================== */
+int main(int argc, char *argv[])
+{
+    int nb_iterations = NB_ITERATIONS_DEFAUT;
+    long nb_points_max = NB_POINTS_MAX_DEFAUT;
+    int premier = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        nb_iterations = atoi(argv[2]);
+        premier = 3;
+    }
+    if (premier < argc)
+        nb_points_max = atol(argv[premier]);
+
+    if (nb_iterations < 1 || nb_points_max < 1000) {
+        printf("Erreur : usage : %s [-n iterations] [nb_points_max >= 1000]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // Vecteurs de la plus grande taille, séries recalculées à chaque taille
+    int *x = malloc(nb_points_max * sizeof(int));
+    uint16_t *y[NB_SERIES];
+    if (x == NULL) {
+        printf("Erreur : echec d'allocation des series.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (long i = 0; i < nb_points_max; i++)
+        x[i] = (int)i;
+    for (int s = 0; s < NB_SERIES; s++) {
+        y[s] = malloc(nb_points_max * sizeof(uint16_t));
+        if (y[s] == NULL) {
+            printf("Erreur : echec d'allocation des series.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("%d courbes par figure, %d iterations par mesure (minimum garde)\n",\
+                NB_SERIES, nb_iterations);
+    printf("  points    pts/pixel  transfo (ms)  trace (ms)  total (ms)  pts traces\n");
+    for (long nb_points = 1000; nb_points <= nb_points_max; nb_points *= 10) {
+        for (int s = 0; s < NB_SERIES; s++)
+            Serie_synthetique(nb_points, y[s], s);
+
+        for (size_t m = 0; m < sizeof(pts_par_pixel_mesures)/sizeof(pts_par_pixel_mesures[0]); m++) {
+            double t_transfo, t_trace;
+            size_t len_dessin = Mesure_courbes(nb_points, x, y, pts_par_pixel_mesures[m],\
+                                        nb_iterations, &t_transfo, &t_trace);
+            printf("  %8ld  %9d  %12.2f  %10.2f  %10.2f  %10zu\n", nb_points,\
+                        pts_par_pixel_mesures[m], t_transfo, t_trace,\
+                        t_transfo + t_trace, len_dessin);
+        }
+    }
+
+    for (int s = 0; s < NB_SERIES; s++)
+        free(y[s]);
+    free(x);
+    return 0;
+}
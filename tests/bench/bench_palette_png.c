@@ -0,0 +1,237 @@
+/* ----------------------------------------------------------------------------
+*  Benchmark des PNG à palette (Ecrire_png_palette) face aux PNG truecolor
+*  de gd et à la réduction de palette de gd (gdImageTrueColorToPalette).
+*
+*  Les figures mesurées doivent être des PNG truecolor, par exemple produites
+*  par stations_fav.exe --truecolor : une figure déjà écrite à palette a
+*  perdu les couleurs que la palette a fusionnées.
+*
+*  Pour chaque figure : nombre de couleurs, temps de construction de la
+*  palette (Init_palette_png), puis temps, taille et nombre de pixels dont
+*  la couleur change après décodage, pour :
+*      - gdImagePngEx en truecolor (ancienne sortie par défaut),
+*      - gdImageTrueColorToPalette + gdImagePngEx (palette de gd),
+*      - Ecrire_png_blocs en RGB, 1 bloc,
+*      - Ecrire_png_palette, 1 bloc (sortie par défaut).
+*
+*  Compilation (depuis la racine du dépôt) :
+*      gcc -std=gnu11 -O2 -Iplotting_data/src tests/bench/bench_palette_png.c \
+*          -o bench_palette_png -lgd -lz -lpthread
+*  Utilisation :
+*      ./bench_palette_png [-n iterations] [-z niveau] figure.png [...]
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <gd.h>
+#include "libs/encodeur_png.h"
+
+/**
+ * @brief Nombre d'itérations par défaut de chaque mesure
+ *
+ */
+#define NB_ITERATIONS_DEFAUT 20
+
+/**
+ * @brief Niveau zlib par défaut (celui des figures)
+ *
+ */
+#define NIVEAU_DEFAUT 5
+
+/**
+ * @brief Encodeurs mesurés
+ *
+ */
+enum Encodeur_e {GD_TRUECOLOR, GD_PALETTE, BLOCS_RGB, BLOCS_PALETTE, NB_ENCODEURS};
+
+static const char *noms_encodeurs[NB_ENCODEURS] = {
+    "gd truecolor", "gd palette", "blocs RGB", "blocs palette"
+};
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Horloge monotone en ms
+ *
+ * @return double Temps en ms
+ */
+double Maintenant_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Décode un png et compte les pixels dont la couleur diffère de
+ * l'image d'origine
+ *
+ * @param img Image truecolor d'origine
+ * @param octets Png encodé
+ * @param taille Taille du png
+ * @return long Nombre de pixels modifiés, -1 si le png est illisible
+ */
+long Pixels_modifies(gdImagePtr img, char *octets, size_t taille)
+{
+    gdImagePtr decode = gdImageCreateFromPngPtr((int)taille, octets);
+    if (decode == NULL) return -1;
+
+    long nb = 0;
+    for (int y = 0; y < img->sy; y++)
+        for (int x = 0; x < img->sx; x++) {
+            int c = gdImageGetTrueColorPixel(decode, x, y);
+            if ((c & 0xFFFFFF) != (img->tpixels[y][x] & 0xFFFFFF)) nb++;
+        }
+
+    gdImageDestroy(decode);
+    return nb;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Encode l'image dans un tampon mémoire avec l'encodeur donné
+ *
+ * @param img Image truecolor (non modifiée)
+ * @param encodeur Encodeur à utiliser
+ * @param niveau Niveau zlib
+ * @param taille Taille du png (sortie)
+ * @param modifies Pixels modifiés par l'encodage (sortie, NULL si inutile)
+ * @return double Temps d'encodage en ms (réduction de palette comprise)
+ */
+double Mesure_encodeur(gdImagePtr img, enum Encodeur_e encodeur, int niveau,\
+                        size_t *taille, long *modifies)
+{
+    char *octets = NULL;
+    FILE *f = open_memstream(&octets, taille);
+    gdImagePtr copie = NULL;
+
+    // La réduction de gd modifie l'image : elle travaille sur une copie
+    // faite hors mesure
+    if (encodeur == GD_PALETTE) {
+        copie = gdImageCreateTrueColor(img->sx, img->sy);
+        gdImageCopy(copie, img, 0, 0, 0, 0, img->sx, img->sy);
+    }
+
+    double debut = Maintenant_ms();
+    switch (encodeur) {
+        case GD_TRUECOLOR:
+            gdImagePngEx(img, f, niveau);
+            break;
+        case GD_PALETTE:
+            gdImageTrueColorToPalette(copie, 0, 256);
+            gdImagePngEx(copie, f, niveau);
+            break;
+        case BLOCS_RGB:
+            Ecrire_png_blocs(img, f, niveau, Z_DEFAULT_STRATEGY, 1);
+            break;
+        default:
+            Ecrire_png_palette(img, f, NULL, 0, niveau, Z_DEFAULT_STRATEGY, 1);
+            break;
+    }
+    fclose(f);
+    double duree = Maintenant_ms() - debut;
+
+    if (modifies != NULL) *modifies = Pixels_modifies(img, octets, *taille);
+    if (copie != NULL) gdImageDestroy(copie);
+    free(octets);
+    return duree;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Mesure les encodeurs sur une image et affiche le tableau
+ *
+ * @param nom Nom de la figure
+ * @param img Image truecolor
+ * @param niveau Niveau zlib
+ * @param nb_iterations Nombre d'itérations (temps minimum gardé)
+ */
+void Bench_image(const char *nom, gdImagePtr img, int niveau, int nb_iterations)
+{
+    PalettePng pal;
+    double t_palette = 1e30;
+
+    for (int it = 0; it < nb_iterations; it++) {
+        double debut = Maintenant_ms();
+        if (Init_palette_png(&pal, img, NULL, 0) != 0) {
+            printf("Erreur : echec de construction de la palette.\n");
+            exit(EXIT_FAILURE);
+        }
+        double t = Maintenant_ms() - debut;
+        if (t < t_palette) t_palette = t;
+        if (it < nb_iterations - 1) Free_palette_png(&pal);
+    }
+
+    printf("\n%s (%dx%d, niveau %d)\n", nom, img->sx, img->sy, niveau);
+    printf("  %zu couleurs, palette %s, construction %.2f ms\n",\
+                pal.nb_cles, pal.exacte ? "exacte" : "reduite", t_palette);
+    Free_palette_png(&pal);
+
+    printf("  encodeur          temps (ms)  taille (o)  pixels modifies\n");
+    for (int e = 0; e < NB_ENCODEURS; e++) {
+        size_t taille = 0;
+        long modifies = 0;
+        double t_min = 1e30;
+        for (int it = 0; it < nb_iterations; it++) {
+            double t = Mesure_encodeur(img, e, niveau, &taille, it == 0 ? &modifies : NULL);
+            if (t < t_min) t_min = t;
+        }
+        printf("  %-16s  %10.2f  %10zu  %15ld\n", noms_encodeurs[e], t_min, taille, modifies);
+    }
+}
+
+
+/* =========================================================================== */
+int main(int argc, char *argv[])
+{
+    int nb_iterations = NB_ITERATIONS_DEFAUT;
+    int niveau = NIVEAU_DEFAUT;
+    int premier = 1;
+
+    while (premier + 1 < argc && argv[premier][0] == '-') {
+        if (strcmp(argv[premier], "-n") == 0)
+            nb_iterations = atoi(argv[premier+1]);
+        else if (strcmp(argv[premier], "-z") == 0)
+            niveau = atoi(argv[premier+1]);
+        else
+            break;
+        premier += 2;
+    }
+
+    if (premier >= argc || nb_iterations < 1 || niveau < 0 || niveau > 9) {
+        printf("Erreur : usage : %s [-n iterations] [-z niveau] figure.png [...]\n",\
+                    argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = premier; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (f == NULL) {
+            printf("Erreur : impossible d'ouvrir %s.\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+        gdImagePtr img = gdImageCreateFromPng(f);
+        fclose(f);
+
+        if (img == NULL) {
+            printf("Erreur : %s n'est pas un png lisible.\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+        if (!gdImageTrueColor(img)) {
+            printf("Info : %s est un png a palette, les couleurs fusionnees sont perdues.\n",\
+                        argv[i]);
+            gdImagePaletteToTrueColor(img);
+        }
+
+        Bench_image(argv[i], img, niveau, nb_iterations);
+        gdImageDestroy(img);
+    }
+
+    return 0;
+}
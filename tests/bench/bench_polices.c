@@ -0,0 +1,346 @@
+/* ----------------------------------------------------------------------------
+*  Benchmark du cache des polices FreeType : trois stratégies de tracé des
+*  textes d'une figure favoris, sur une image truecolor 800x700 :
+*      - arret : gdFontCacheShutdown à la fin de chaque helper de texte
+*        (Make_legend, Make_yticks_ygrid...), ancien comportement : la
+*        police est rechargée par le helper suivant,
+*      - cache : cache gardé pour tout le process (Init_cache_polices et
+*        Free_cache_polices une seule fois, comportement actuel),
+*      - atlas : cache gardé, et les étiquettes courtes (ticks, valeurs)
+*        rasterisées une seule fois puis copiées (gdImageCopy). L'atlas est
+*        réécrit ici, il n'est plus dans plotter.h.
+*
+*  Pour chaque stratégie : temps de la 1ere figure (process neuf, cas de
+*  stations_fav.exe), temps moyen des suivantes (process résident, cas du
+*  serveur live), appels FreeType par figure et pixels différents de la
+*  stratégie cache (arrondis du mélange alpha).
+*  Les textes sont ceux d'une figure : ticks Y, dates et heures en X,
+*  valeurs de barplot, légende, titre et sous-titre.
+*
+*  Compilation (depuis la racine du dépôt, -DAJC : polices dans
+*  /usr/share/fonts/truetype, voir consts.h) :
+*      gcc -std=gnu11 -O2 -Iplotting_data/src tests/bench/bench_polices.c \
+*          -o bench_polices -lgd -lsqlite3 -lz -lpthread -lm
+*  Utilisation :
+*      ./bench_polices [-n figures] [police.ttf]
+*
+*  Author : Juba Hamma. 2023.
+* ----------------------------------------------------------------------------
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <gd.h>
+#include "libs/plotter.h"
+
+/**
+ * @brief Nombre de figures tracées par défaut pour chaque stratégie
+ *
+ */
+#define NB_FIGURES_DEFAUT 50
+
+/**
+ * @brief Taille de l'image (celle des figures)
+ *
+ */
+#define LARGEUR_IMG 800
+#define HAUTEUR_IMG 700
+
+/**
+ * @brief Atlas : longueur max d'une étiquette et nombre max d'étiquettes
+ *
+ */
+#define ATLAS_LONGUEUR_MAX 16
+#define ATLAS_NB_MAX 256
+
+/**
+ * @brief Stratégies mesurées
+ *
+ */
+enum Strategie_e {ARRET, CACHE, ATLAS, NB_STRATEGIES};
+
+static const char *noms_strategies[NB_STRATEGIES] = {"arret", "cache", "atlas"};
+
+/**
+ * @brief Etiquette pré-rasterisée de l'atlas (couverture dans le canal alpha)
+ *
+ */
+typedef struct EtiquetteBench_s {
+    int size;            /**< Taille de la police */
+    char texte[ATLAS_LONGUEUR_MAX]; /**< Texte de l'étiquette */
+    gdImagePtr img;      /**< Image de l'étiquette, NULL si pas d'encre */
+    int decal[2];        /**< Coin haut gauche de l'image / plume (baseline) */
+} EtiquetteBench;
+
+static EtiquetteBench atlas[ATLAS_NB_MAX];
+static int nb_etiquettes = 0;
+
+/**
+ * @brief Appels à gdImageStringFT de la figure en cours
+ *
+ */
+static long nb_appels_ft = 0;
+
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Horloge monotone en ms
+ *
+ * @return double Temps en ms
+ */
+double Maintenant_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Trace un texte par FreeType (compte les appels)
+ *
+ * @param img Image truecolor
+ * @param police Chemin vers la police
+ * @param size Taille de la police
+ * @param x Position X de la plume
+ * @param y Position Y de la baseline
+ * @param texte Texte
+ */
+void Texte_ft(gdImagePtr img, char *police, int size, int x, int y, char *texte)
+{
+    nb_appels_ft++;
+    char *err = gdImageStringFT(img, NULL, 0xFFFFFF, police, size, 0., x, y, texte);
+    if (err != NULL) {
+        printf("Erreur : %s (%s).\n", err, police);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Renvoie l'étiquette de l'atlas d'un texte, rasterisée au premier
+ * appel (même découpage que l'ancien Get_etiquette_atlas)
+ *
+ * @param police Chemin vers la police
+ * @param size Taille de la police
+ * @param texte Texte (moins de ATLAS_LONGUEUR_MAX caractères)
+ * @return EtiquetteBench* Etiquette, NULL si l'atlas est plein
+ */
+EtiquetteBench *Get_etiquette(char *police, int size, char *texte)
+{
+    for (int e = 0; e < nb_etiquettes; e++)
+        if (atlas[e].size == size && strcmp(atlas[e].texte, texte) == 0)
+            return &(atlas[e]);
+
+    if (nb_etiquettes == ATLAS_NB_MAX) return NULL;
+
+    int w = ((int)strlen(texte) + 2) * 2 * size;
+    int h = 4 * size;
+    int plume[2] = {size, 3 * size};
+    int brect[8] = {0};
+
+    gdImagePtr img = gdImageCreateTrueColor(w, h);
+    gdImageAlphaBlending(img, 0);
+    gdImageFilledRectangle(img, 0, 0, w-1, h-1, gdAlphaMax << 24);
+    gdImageAlphaBlending(img, 1);
+    nb_appels_ft++;
+    gdImageStringFT(img, brect, 0xFFFFFF, police, size, 0., plume[0], plume[1], texte);
+
+    int gauche = Min_int(brect[0], brect[6]) - 2, droite = Max_int(brect[2], brect[4]) + 2;
+    int haut = Min_int(brect[5], brect[7]) - 2, bas = Max_int(brect[1], brect[3]) + 2;
+    if (gauche < 0 || haut < 0 || droite >= w || bas >= h) {
+        gdImageDestroy(img);
+        return NULL;
+    }
+
+    EtiquetteBench *etq = &(atlas[nb_etiquettes++]);
+    etq->size = size;
+    strcpy(etq->texte, texte);
+    etq->decal[0] = gauche - plume[0];
+    etq->decal[1] = haut - plume[1];
+    etq->img = NULL;
+    if (brect[2] > brect[0]) {
+        etq->img = gdImageCreateTrueColor(droite - gauche + 1, bas - haut + 1);
+        gdImageAlphaBlending(etq->img, 0);
+        gdImageCopy(etq->img, img, 0, 0, gauche, haut, droite - gauche + 1, bas - haut + 1);
+        gdImageAlphaBlending(etq->img, 1);
+    }
+    gdImageDestroy(img);
+
+    return etq;
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Trace une étiquette selon la stratégie (atlas : copie si courte)
+ *
+ * @param img Image truecolor
+ * @param strategie Stratégie mesurée
+ * @param police Chemin vers la police
+ * @param size Taille de la police
+ * @param x Position X de la plume
+ * @param y Position Y de la baseline
+ * @param texte Texte
+ */
+void Tracer_etiquette(gdImagePtr img, enum Strategie_e strategie, char *police, int size,\
+                        int x, int y, char *texte)
+{
+    EtiquetteBench *etq = NULL;
+    if (strategie == ATLAS && strlen(texte) < ATLAS_LONGUEUR_MAX)
+        etq = Get_etiquette(police, size, texte);
+
+    if (etq == NULL) {
+        Texte_ft(img, police, size, x, y, texte);
+        return;
+    }
+    if (etq->img != NULL)
+        gdImageCopy(img, etq->img, x + etq->decal[0], y + etq->decal[1],\
+                        0, 0, etq->img->sx, etq->img->sy);
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Fin d'un helper de texte : ancien comportement, cache des polices
+ * vidé (la police est rechargée par le prochain gdImageStringFT)
+ *
+ * @param strategie Stratégie mesurée
+ */
+void Fin_helper(enum Strategie_e strategie)
+{
+    if (strategie == ARRET)
+        gdFontCacheShutdown();
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Trace les textes d'une figure favoris, un bloc par helper
+ *
+ * @param img Image truecolor (fond effacé)
+ * @param strategie Stratégie mesurée
+ * @param police Chemin vers la police
+ */
+void Textes_figure(gdImagePtr img, enum Strategie_e strategie, char *police)
+{
+    char texte[64];
+
+    gdImageFilledRectangle(img, 0, 0, LARGEUR_IMG-1, HAUTEUR_IMG-1, 0x252C38);
+
+    // Make_title, Make_subtitle
+    Texte_ft(img, police, 20, 90, 40, "Disponibilité des bornes favorites");
+    Fin_helper(strategie);
+    Texte_ft(img, police, 14, 90, 70, "du 14/02/2023 à 06h00 au 21/02/2023 à 23h00");
+    Fin_helper(strategie);
+
+    // Make_yticks_ygrid
+    for (int v = 0; v <= 20; v += 2) {
+        snprintf(texte, sizeof(texte), "%d", v);
+        Tracer_etiquette(img, strategie, police, 12, 60, 540 - v * 20, texte);
+    }
+    Fin_helper(strategie);
+
+    // Make_xticks_xgrid_time : dates et heures
+    for (int j = 0; j < 8; j++) {
+        snprintf(texte, sizeof(texte), "%02d/02", 14 + j);
+        Tracer_etiquette(img, strategie, police, 12, 100 + j * 85, 570, texte);
+        snprintf(texte, sizeof(texte), "%02dh", (6 + 3 * j) % 24);
+        Tracer_etiquette(img, strategie, police, 12, 110 + j * 85, 590, texte);
+    }
+    Fin_helper(strategie);
+
+    // PlotBarplot : valeurs des catégories
+    for (int c = 0; c < 16; c++) {
+        snprintf(texte, sizeof(texte), "%d", c % 7);
+        Tracer_etiquette(img, strategie, police, 12, 100 + c * 40, 300, texte);
+    }
+    Fin_helper(strategie);
+
+    // Make_legend : adresses (longues, jamais dans l'atlas)
+    for (int st = 0; st < 4; st++) {
+        snprintf(texte, sizeof(texte), "%d Rue Balard 75015 Paris", 100 + st);
+        Texte_ft(img, police, 14, 120, 620 + st * 20, texte);
+    }
+    Fin_helper(strategie);
+
+    // Make_annotation
+    Texte_ft(img, police, 10, 500, 690, "© 2023 by Juba Hamma");
+    Fin_helper(strategie);
+}
+
+/* --------------------------------------------------------------------------- */
+/**
+ * @brief Compte les pixels différents entre deux images de même taille
+ *
+ * @param a Image 1
+ * @param b Image 2
+ * @return long Nombre de pixels différents
+ */
+long Pixels_differents(gdImagePtr a, gdImagePtr b)
+{
+    long nb = 0;
+    for (int y = 0; y < a->sy; y++)
+        for (int x = 0; x < a->sx; x++)
+            if (a->tpixels[y][x] != b->tpixels[y][x]) nb++;
+    return nb;
+}
+
+
+/* =========================================================================== */
+int main(int argc, char *argv[])
+{
+    int nb_figures = NB_FIGURES_DEFAUT;
+    char *police = fonts_fig[0];
+    int premier = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        nb_figures = atoi(argv[2]);
+        premier = 3;
+    }
+    if (premier < argc)
+        police = argv[premier];
+
+    if (nb_figures < 2) {
+        printf("Erreur : usage : %s [-n figures] [police.ttf]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    gdImagePtr imgs[NB_STRATEGIES];
+    for (int s = 0; s < NB_STRATEGIES; s++)
+        imgs[s] = gdImageCreateTrueColor(LARGEUR_IMG, HAUTEUR_IMG);
+
+    printf("%d figures par strategie, police %s\n", nb_figures, police);
+    printf("  strategie  1ere figure (ms)  suivantes (ms/figure)  appels FreeType/figure  pixels differents\n");
+
+    // Cache mesuré en premier : image de référence des autres stratégies
+    enum Strategie_e ordre[NB_STRATEGIES] = {CACHE, ARRET, ATLAS};
+    for (int o = 0; o < NB_STRATEGIES; o++) {
+        enum Strategie_e s = ordre[o];
+
+        // Process neuf : police et atlas vides au début de chaque mesure
+        Init_cache_polices();
+        nb_appels_ft = 0;
+
+        double debut = Maintenant_ms();
+        Textes_figure(imgs[s], s, police);
+        double premiere = Maintenant_ms() - debut;
+
+        debut = Maintenant_ms();
+        for (int f = 1; f < nb_figures; f++)
+            Textes_figure(imgs[s], s, police);
+        double suivantes = (Maintenant_ms() - debut) / Max_int(nb_figures - 1, 1);
+
+        printf("  %-9s  %16.2f  %21.2f  %22.1f  %17ld\n", noms_strategies[s], premiere,\
+                    suivantes, (double)nb_appels_ft / nb_figures,\
+                    Pixels_differents(imgs[s], imgs[CACHE]));
+
+        for (int e = 0; e < nb_etiquettes; e++)
+            if (atlas[e].img != NULL) gdImageDestroy(atlas[e].img);
+        nb_etiquettes = 0;
+        Free_cache_polices();
+    }
+
+    for (int s = 0; s < NB_STRATEGIES; s++)
+        gdImageDestroy(imgs[s]);
+    return 0;
+}
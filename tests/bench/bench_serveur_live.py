@@ -0,0 +1,129 @@
+#!/usr/bin/python3
+
+# ===========================================================================
+# Test de charge du serveur de rendu live (main_serveur_live.c) face au
+# lancement d'un process par requete (plot_belib_live.exe + copie, ce que
+# faisait le CGI get_images_live).
+# Mesures (latence p50/p99 vue du client, en ms) :
+#   - spawn : plot_belib_live.exe puis cp, etag supprime (figure retracee),
+#   - serveur, octets renvoyes sur la socket, requetes en serie,
+#   - serveur, fichier= avec etag supprime (figure retracee et ecrite),
+#   - serveur, octets, N clients simultanes,
+# puis la ligne "stats" du serveur (latences vues par le serveur).
+# Le serveur doit tourner sur la meme bdd :
+#   ./serveur_live.exe belib_data.db --socket /tmp/belib_live.sock &
+# (serveur_live.exe : main_serveur_live.c compilé)
+# Usage :
+#   bench_serveur_live.py <plot_belib_live.exe> <belib_data.db> [options]
+# Author : Juba Hamma, 2023.
+# ===========================================================================
+
+import argparse
+import math
+import os
+import socket
+import subprocess
+import threading
+import time
+
+
+def requete(ligne, chemin_socket):
+    """Envoie une requete au serveur et renvoie toute sa reponse (octets)"""
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(chemin_socket)
+    s.sendall((ligne + "\n").encode())
+    reponse = b""
+    while True:
+        morceau = s.recv(65536)
+        if not morceau:
+            break
+        reponse += morceau
+    s.close()
+    return reponse
+
+
+def percentile(latences, p):
+    """Percentile p (0 a 1) par rang, comme le serveur"""
+    latences = sorted(latences)
+    rang = max(1, math.ceil(p * len(latences)))
+    return latences[rang - 1]
+
+
+def resume(nom, latences):
+    print(f"{nom:<42} n={len(latences):<5} p50={percentile(latences, .50):7.1f}ms "
+          f"p99={percentile(latences, .99):7.1f}ms")
+
+
+def chrono(fonction):
+    """Execute fonction et renvoie sa duree en ms"""
+    debut = time.perf_counter()
+    fonction()
+    return (time.perf_counter() - debut) * 1e3
+
+
+def supprimer_etag(dir_figures, fichier):
+    try:
+        os.remove(os.path.join(dir_figures, fichier + ".etag"))
+    except FileNotFoundError:
+        pass
+
+
+def verifier_ok(reponse):
+    if not reponse.startswith(b"OK"):
+        raise RuntimeError(f"Erreur : reponse du serveur {reponse[:80]!r}")
+
+
+parser = argparse.ArgumentParser(description="Test de charge du serveur live")
+parser.add_argument("exe_live", help="plot_belib_live.exe (un process par requete)")
+parser.add_argument("bdd", help="bdd sqlite (celle du serveur)")
+parser.add_argument("--socket", default="/tmp/belib_live.sock", help="socket du serveur")
+parser.add_argument("--figures", default="/var/www/html/figures",
+                    help="dossier des figures (celui des exe)")
+parser.add_argument("-n", type=int, default=200, help="requetes par mesure")
+parser.add_argument("-c", type=int, default=8, help="clients simultanes")
+args = parser.parse_args()
+
+figure = "fig2_barplot_live.png"
+
+# Un process par requete (la moitie des requetes : bien plus lent)
+latences = []
+for i in range(max(1, args.n // 2)):
+    supprimer_etag(args.figures, figure)
+    latences.append(chrono(lambda: (
+        subprocess.run([args.exe_live, args.bdd], stdout=subprocess.DEVNULL, check=True),
+        subprocess.run(["cp", os.path.join(args.figures, figure), os.devnull], check=True))))
+resume("spawn plot_belib_live.exe + cp", latences)
+
+# Serveur : octets de la figure sur la socket
+latences = []
+for i in range(args.n):
+    latences.append(chrono(lambda: verifier_ok(requete("", args.socket))))
+resume("serveur, octets, en serie", latences)
+
+# Serveur : figure ecrite, toujours retracee
+latences = []
+for i in range(args.n):
+    supprimer_etag(args.figures, figure)
+    latences.append(chrono(lambda: verifier_ok(requete("fichier=" + figure, args.socket))))
+resume("serveur, fichier retrace, en serie", latences)
+
+# Serveur : clients simultanes
+latences = []
+verrou = threading.Lock()
+
+
+def client():
+    for i in range(max(1, args.n // args.c)):
+        duree = chrono(lambda: verifier_ok(requete("", args.socket)))
+        with verrou:
+            latences.append(duree)
+
+
+clients = [threading.Thread(target=client) for _ in range(args.c)]
+for c in clients:
+    c.start()
+for c in clients:
+    c.join()
+resume(f"serveur, octets, {args.c} clients simultanes", latences)
+
+print("stats serveur :", requete("stats", args.socket).decode().strip())